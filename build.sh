@@ -1 +1 @@
-cd src && g++ main.cpp lexer.cpp parser.cpp semantic.cpp codegen.cpp module.cpp -o ../azc && cd .. 
\ No newline at end of file
+cd src && g++ -c lexer.cpp types.cpp parser.cpp semantic.cpp constfold.cpp ctfe.cpp specialize.cpp codesink.cpp codegen.cpp ir.cpp irbuilder.cpp iropt.cpp iremit.cpp asmemit.cpp bytecode.cpp vm.cpp module.cpp callgraph.cpp process.cpp build.cpp trace.cpp cache.cpp json.cpp lsp.cpp azin.cpp && ar rcs ../libazin.a lexer.o types.o parser.o semantic.o constfold.o ctfe.o specialize.o codesink.o codegen.o ir.o irbuilder.o iropt.o iremit.o asmemit.o bytecode.o vm.o module.o callgraph.o process.o build.o trace.o cache.o json.o lsp.o azin.o && g++ main.cpp ../libazin.a -o ../azc && rm -f *.o && cd ..
\ No newline at end of file
@@ -1 +1 @@
-cd src && g++ test_syntax.cpp lexer.cpp parser.cpp semantic.cpp codegen.cpp module.cpp -o ../azctest && cd .. 
\ No newline at end of file
+cd src && g++ test_syntax.cpp lexer.cpp types.cpp parser.cpp semantic.cpp constfold.cpp ctfe.cpp specialize.cpp codesink.cpp codegen.cpp ir.cpp irbuilder.cpp iropt.cpp iremit.cpp asmemit.cpp bytecode.cpp vm.cpp module.cpp callgraph.cpp process.cpp build.cpp trace.cpp cache.cpp json.cpp lsp.cpp azin.cpp -o ../azctest && cd .. 
\ No newline at end of file
@@ -0,0 +1,1125 @@
+#include "asmemit.hpp"
+#include "cinteger.hpp"
+#include "ctfe.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace azin
+{
+
+// ===== Registers =====
+
+// Allocatable: the callee-saved ones first, then r10 and r11, which a
+// call clobbers but no argument uses. rax, rcx and rdx are scratch for
+// single instructions; the argument registers are never allocated, so
+// arguments can be loaded in any order.
+static const char* const REGISTERS[] = { "%rbx", "%r12", "%r13", "%r14", "%r15", "%r10", "%r11" };
+static const int REGISTER_COUNT = 7;
+static const int CALLEE_SAVED_COUNT = 5;
+
+static const char* const ARGUMENT_REGISTERS[] = { "%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9" };
+
+// How a value of some type sits in a 64-bit register
+struct Width
+{
+    int bits = 64;          // 8, 16, 32 or 64
+    bool isSigned = false;
+    bool isBool = false;
+};
+
+static Width widthOf(const TypeInfo& info)
+{
+    Width w;
+
+    if (info.isPointer || info.isArray)
+        return w;
+
+    w.bits = info.bits;
+    w.isSigned = info.isSigned;
+    w.isBool = info.base == BaseKind::Bool;
+    return w;
+}
+
+static int64_t immediate(Wide value)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(value));
+}
+
+static bool fitsImmediate(int64_t value)
+{
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// A .string directive for bytes
+static std::string stringDirective(const std::string& bytes)
+{
+    static const char* const DIGITS = "01234567";
+
+    std::string text = "    .string \"";
+
+    for (char c : bytes)
+    {
+        unsigned char u = static_cast<unsigned char>(c);
+
+        if (u >= 0x20 && u < 0x7f && c != '"' && c != '\\')
+        {
+            text += c;
+            continue;
+        }
+
+        text += '\\';
+        text += DIGITS[(u >> 6) & 7];
+        text += DIGITS[(u >> 3) & 7];
+        text += DIGITS[u & 7];
+    }
+
+    return text + "\"\n";
+}
+
+
+// ===== Functions =====
+
+namespace
+{
+
+// Where a value lives between the instructions that use it
+struct Location
+{
+    int reg = -1;       // index into REGISTERS, or -1 for the stack
+    int offset = 0;     // from %rbp, when on the stack
+};
+
+struct Interval
+{
+    ValueId value;
+    size_t start;
+    size_t end;
+    bool crossesCall;
+};
+
+// Labels and strings shared by every function of one module
+struct ModuleState
+{
+    std::unordered_set<std::string> defined;
+    std::unordered_map<std::string, std::string> strings;   // source text -> label
+    std::string rodata;
+    int functions = 0;
+    int labels = 0;
+};
+
+class FunctionEmitter
+{
+public:
+    FunctionEmitter(const IRFunction& fn, TypeTable& types, ModuleState& module, CodeSink& out)
+        : fn(fn), types(types), module(module), out(out), id(module.functions++) {}
+
+    void emit()
+    {
+        order = fn.reversePostorder();
+
+        number();
+        allocate();
+        layoutFrame();
+
+        out << "    .globl " << fn.name << "\n"
+            << "    .type " << fn.name << ", @function\n"
+            << fn.name << ":\n"
+            << "    pushq %rbp\n"
+            << "    movq %rsp, %rbp\n";
+
+        if (frameSize > 0)
+            out << "    subq $" << frameSize << ", %rsp\n";
+
+        for (size_t i = 0; i < saved.size(); i++)
+            out << "    movq " << REGISTERS[saved[i]] << ", " << -8 * static_cast<int64_t>(i + 1) << "(%rbp)\n";
+
+        moveParameters();
+
+        for (size_t i = 0; i < order.size(); i++)
+            emitBlock(order[i], i + 1 < order.size() ? order[i + 1] : NO_BLOCK);
+
+        out << returnLabel() << ":\n";
+
+        for (size_t i = 0; i < saved.size(); i++)
+            out << "    movq " << -8 * static_cast<int64_t>(i + 1) << "(%rbp), " << REGISTERS[saved[i]] << "\n";
+
+        out << "    leave\n"
+            << "    ret\n"
+            << "    .size " << fn.name << ", .-" << fn.name << "\n\n";
+    }
+
+private:
+    const IRFunction& fn;
+    TypeTable& types;
+    ModuleState& module;
+    CodeSink& out;
+    int id;
+
+    std::vector<BlockId> order;
+    std::vector<size_t> blockStart;     // position of the first instruction
+    std::vector<size_t> blockEnd;       // position of the terminator
+    std::vector<size_t> calls;          // positions of calls, ascending
+
+    std::vector<Location> locations;
+    std::vector<bool> allocated;
+    std::vector<int> nextSlot;          // phi -> slot its incoming value is copied to
+    std::vector<int> allocaSlot;        // alloca -> start of its storage
+    std::vector<int> saved;             // callee-saved registers in use
+    int64_t frameSize = 0;
+
+    // The value %rax is known to hold, so it is not loaded again
+    ValueId inRax = NO_VALUE;
+
+    // Condition of a compare left in the flags for the branch after it
+    const char* pendingCondition = nullptr;
+
+
+    // ===== Liveness =====
+
+    // Values with a location of their own; constants and addresses are
+    // rematerialized at each use instead
+    bool needsLocation(ValueId v) const
+    {
+        IROp op = fn.values[v].op;
+        return op != IROp::Const && op != IROp::String && op != IROp::Undef && op != IROp::Alloca;
+    }
+
+    bool definesValue(const IRInst& inst) const
+    {
+        return inst.type != INVALID_TYPE && !isTerminator(inst.op) && inst.op != IROp::Store;
+    }
+
+    // Numbers the instructions in layout order and builds one interval
+    // per value, from its definition to its last use, stretched over
+    // every block it is live through
+    void number()
+    {
+        blockStart.assign(fn.blocks.size(), 0);
+        blockEnd.assign(fn.blocks.size(), 0);
+
+        size_t position = 1;   // 0 is the prologue, where parameters arrive
+
+        for (BlockId b : order)
+        {
+            blockStart[b] = position;
+
+            for (ValueId v : fn.blocks[b].insts)
+            {
+                if (fn.values[v].op == IROp::Call)
+                    calls.push_back(position);
+                position++;
+            }
+
+            blockEnd[b] = position - 1;
+        }
+
+        size_t words = (fn.values.size() + 63) / 64;
+        std::vector<std::vector<uint64_t>> liveIn(fn.blocks.size(), std::vector<uint64_t>(words, 0));
+        std::vector<std::vector<uint64_t>> liveOut = liveIn;
+
+        auto set = [](std::vector<uint64_t>& bits, ValueId v) { bits[v / 64] |= uint64_t(1) << (v % 64); };
+        auto reset = [](std::vector<uint64_t>& bits, ValueId v) { bits[v / 64] &= ~(uint64_t(1) << (v % 64)); };
+
+        // Backwards until nothing changes; reverse layout order converges fastest
+        bool changed = true;
+
+        while (changed)
+        {
+            changed = false;
+
+            for (size_t i = order.size(); i-- > 0;)
+            {
+                BlockId b = order[i];
+                std::vector<uint64_t> live(words, 0);
+
+                for (BlockId succ : fn.successors(b))
+                {
+                    for (size_t w = 0; w < words; w++)
+                        live[w] |= liveIn[succ][w];
+
+                    for (ValueId v : fn.blocks[succ].insts)
+                    {
+                        const IRInst& phi = fn.values[v];
+                        if (phi.op != IROp::Phi)
+                            break;
+
+                        reset(live, v);
+
+                        for (size_t k = 0; k < phi.operands.size(); k++)
+                        {
+                            if (phi.targets[k] == b && needsLocation(phi.operands[k]))
+                                set(live, phi.operands[k]);
+                        }
+                    }
+                }
+
+                liveOut[b] = live;
+
+                const auto& insts = fn.blocks[b].insts;
+
+                for (size_t k = insts.size(); k-- > 0;)
+                {
+                    const IRInst& inst = fn.values[insts[k]];
+
+                    reset(live, insts[k]);
+
+                    if (inst.op == IROp::Phi)
+                        continue;
+
+                    for (ValueId operand : inst.operands)
+                    {
+                        if (needsLocation(operand))
+                            set(live, operand);
+                    }
+                }
+
+                if (live != liveIn[b])
+                {
+                    liveIn[b] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+
+        std::vector<size_t> first(fn.values.size(), SIZE_MAX);
+        std::vector<size_t> last(fn.values.size(), 0);
+        uses.assign(fn.values.size(), 0);
+
+        auto cover = [&](ValueId v, size_t at)
+        {
+            first[v] = std::min(first[v], at);
+            last[v] = std::max(last[v], at);
+        };
+
+        for (BlockId b : order)
+        {
+            for (size_t w = 0; w < words; w++)
+            {
+                for (uint64_t bits = liveIn[b][w]; bits; bits &= bits - 1)
+                    cover(static_cast<ValueId>(w * 64 + __builtin_ctzll(bits)), blockStart[b]);
+
+                for (uint64_t bits = liveOut[b][w]; bits; bits &= bits - 1)
+                    cover(static_cast<ValueId>(w * 64 + __builtin_ctzll(bits)), blockEnd[b]);
+            }
+
+            size_t position = blockStart[b];
+
+            for (ValueId v : fn.blocks[b].insts)
+            {
+                const IRInst& inst = fn.values[v];
+
+                if (definesValue(inst) && needsLocation(v))
+                    cover(v, position);
+
+                // Phi inputs are read at the end of the predecessor, where
+                // liveOut already covers them
+                if (inst.op != IROp::Phi)
+                {
+                    for (ValueId operand : inst.operands)
+                    {
+                        if (needsLocation(operand))
+                        {
+                            cover(operand, position);
+                            uses[operand]++;
+                        }
+                    }
+                }
+                else
+                {
+                    for (ValueId operand : inst.operands)
+                        uses[operand]++;
+                }
+
+                position++;
+            }
+        }
+
+        for (ValueId v = 0; v < fn.values.size(); v++)
+        {
+            if (fn.values[v].op == IROp::Param && uses[v] > 0)
+                cover(v, 0);
+
+            if (first[v] == SIZE_MAX || uses[v] == 0)
+                continue;
+
+            auto call = std::upper_bound(calls.begin(), calls.end(), first[v]);
+            bool crosses = call != calls.end() && *call < last[v];
+
+            intervals.push_back({ v, first[v], last[v], crosses });
+        }
+    }
+
+    std::vector<uint32_t> uses;
+    std::vector<Interval> intervals;
+
+
+    // ===== Allocation =====
+
+    void allocate()
+    {
+        locations.assign(fn.values.size(), Location());
+        allocated.assign(fn.values.size(), false);
+
+        std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+            return a.start != b.start ? a.start < b.start : a.value < b.value;
+        });
+
+        std::vector<const Interval*> active;     // holding a register
+        bool free[REGISTER_COUNT];
+        bool touched[REGISTER_COUNT] = {};
+        std::fill(free, free + REGISTER_COUNT, true);
+
+        for (const Interval& current : intervals)
+        {
+            // An interval ending where this one starts is read by the
+            // instruction that defines this one, before it is written
+            for (size_t i = 0; i < active.size();)
+            {
+                if (active[i]->end <= current.start)
+                {
+                    free[locations[active[i]->value].reg] = true;
+                    active[i] = active.back();
+                    active.pop_back();
+                }
+                else
+                    i++;
+            }
+
+            int limit = current.crossesCall ? CALLEE_SAVED_COUNT : REGISTER_COUNT;
+            int reg = -1;
+
+            // Caller-saved first when allowed: they need no saving
+            for (int r = limit - 1; r >= 0; r--)
+            {
+                if (free[r])
+                {
+                    reg = r;
+                    break;
+                }
+            }
+
+            allocated[current.value] = true;
+
+            if (reg >= 0)
+            {
+                free[reg] = false;
+                touched[reg] = true;
+                locations[current.value].reg = reg;
+                active.push_back(&current);
+                continue;
+            }
+
+            // None free: spill whichever usable interval ends last
+            const Interval* victim = nullptr;
+
+            for (const Interval* other : active)
+            {
+                if (locations[other->value].reg < limit && (!victim || other->end > victim->end))
+                    victim = other;
+            }
+
+            if (victim && victim->end > current.end)
+            {
+                locations[current.value].reg = locations[victim->value].reg;
+                locations[victim->value].reg = -1;
+                std::replace(active.begin(), active.end(), victim, &current);
+            }
+        }
+
+        for (int r = 0; r < CALLEE_SAVED_COUNT; r++)
+        {
+            if (touched[r])
+                saved.push_back(r);
+        }
+    }
+
+    void layoutFrame()
+    {
+        int64_t offset = 8 * static_cast<int64_t>(saved.size());
+
+        auto slot = [&](int64_t size, int64_t align)
+        {
+            offset = (offset + size + align - 1) / align * align;
+            return static_cast<int>(-offset);
+        };
+
+        nextSlot.assign(fn.values.size(), 0);
+        allocaSlot.assign(fn.values.size(), 0);
+
+        for (BlockId b : order)
+        {
+            for (ValueId v : fn.blocks[b].insts)
+            {
+                const IRInst& inst = fn.values[v];
+
+                if (inst.op == IROp::Phi)
+                    nextSlot[v] = slot(8, 8);
+
+                if (inst.op == IROp::Alloca)
+                {
+                    int64_t bytes = elementSize(inst.type) * static_cast<int64_t>(inst.imm);
+                    allocaSlot[v] = slot(std::max<int64_t>(bytes, 1), 16);
+                }
+            }
+        }
+
+        for (ValueId v = 0; v < fn.values.size(); v++)
+        {
+            if (allocated[v] && locations[v].reg < 0)
+                locations[v].offset = slot(8, 8);
+        }
+
+        frameSize = (offset + 15) / 16 * 16;
+    }
+
+    int64_t elementSize(TypeId pointer) const
+    {
+        const TypeInfo& info = types.info(types.pointee(pointer));
+
+        if (info.isPointer)
+            return 8;
+
+        return std::max(info.bits / 8, 1);
+    }
+
+
+    // ===== Operands =====
+
+    std::string blockLabel(BlockId b) const
+    {
+        return ".L" + std::to_string(id) + "_" + std::to_string(b);
+    }
+
+    std::string returnLabel() const
+    {
+        return ".L" + std::to_string(id) + "_ret";
+    }
+
+    std::string newLabel()
+    {
+        return ".Lx" + std::to_string(module.labels++);
+    }
+
+    static std::string slotText(int offset)
+    {
+        return std::to_string(offset) + "(%rbp)";
+    }
+
+    std::string stringLabel(const std::string& text)
+    {
+        auto it = module.strings.find(text);
+        if (it != module.strings.end())
+            return it->second;
+
+        std::string bytes;
+        if (!decodeString(text, bytes))
+            throw std::runtime_error("Unsupported string literal in native codegen: \"" + text + "\"");
+
+        std::string label = ".Ls" + std::to_string(module.strings.size());
+        module.strings.emplace(text, label);
+        module.rodata += label + ":\n" + stringDirective(bytes);
+        return label;
+    }
+
+    // Where v can be read by one instruction: a register, a stack slot, or
+    // an immediate when `allowImmediate`; "" when it must be loaded first
+    std::string operand(ValueId v, bool allowImmediate)
+    {
+        const IRInst& inst = fn.values[v];
+
+        switch (inst.op)
+        {
+            case IROp::Const:
+            {
+                int64_t value = immediate(inst.imm);
+                return allowImmediate && fitsImmediate(value) ? "$" + std::to_string(value) : "";
+            }
+            case IROp::Undef:
+                return allowImmediate ? "$0" : "";
+            case IROp::String:
+            case IROp::Alloca:
+                return "";
+            default:
+                break;
+        }
+
+        const Location& loc = locations[v];
+        return loc.reg >= 0 ? REGISTERS[loc.reg] : slotText(loc.offset);
+    }
+
+    void load(ValueId v, const char* reg)
+    {
+        const IRInst& inst = fn.values[v];
+
+        bool toRax = std::string_view(reg) == "%rax";
+
+        if (toRax && v == inRax)
+            return;
+
+        if (toRax)
+            inRax = v;
+
+        switch (inst.op)
+        {
+            case IROp::Const:
+            {
+                int64_t value = immediate(inst.imm);
+
+                if (value == 0)
+                    out << "    xorl " << low32(reg) << ", " << low32(reg) << "\n";
+                else if (fitsImmediate(value))
+                    out << "    movq $" << value << ", " << reg << "\n";
+                else
+                    out << "    movabsq $" << value << ", " << reg << "\n";
+                return;
+            }
+            case IROp::Undef:
+                out << "    xorl " << low32(reg) << ", " << low32(reg) << "\n";
+                return;
+            case IROp::String:
+                out << "    leaq " << stringLabel(inst.text) << "(%rip), " << reg << "\n";
+                return;
+            case IROp::Alloca:
+                out << "    leaq " << slotText(allocaSlot[v]) << ", " << reg << "\n";
+                return;
+            default:
+                break;
+        }
+
+        std::string source = operand(v, false);
+
+        if (source != reg)
+            out << "    movq " << source << ", " << reg << "\n";
+    }
+
+    // rax into v's location
+    void store(ValueId v)
+    {
+        inRax = v;
+
+        if (!allocated[v])
+            return;
+
+        out << "    movq %rax, " << operand(v, false) << "\n";
+    }
+
+    // The operand of a two-operand instruction reading v, loading it into
+    // %rcx when it is not directly addressable. Call it before writing the
+    // instruction, whose line the load would otherwise split.
+    std::string source(ValueId v)
+    {
+        std::string text = operand(v, true);
+
+        if (!text.empty())
+            return text;
+
+        load(v, "%rcx");
+        return "%rcx";
+    }
+
+    static std::string low32(const char* reg)
+    {
+        static const std::unordered_map<std::string, std::string> names = {
+            { "%rax", "%eax" }, { "%rcx", "%ecx" }, { "%rdx", "%edx" }, { "%rdi", "%edi" },
+            { "%rsi", "%esi" }, { "%r8", "%r8d" }, { "%r9", "%r9d" },
+        };
+
+        return names.at(reg);
+    }
+
+    // Sign or zero extends %rax from the width of type
+    void normalize(TypeId type)
+    {
+        Width w = widthOf(types.info(type));
+
+        if (w.isBool)
+            out << "    movzbl %al, %eax\n";
+        else if (w.bits == 8)
+            out << (w.isSigned ? "    movsbq %al, %rax\n" : "    movzbl %al, %eax\n");
+        else if (w.bits == 16)
+            out << (w.isSigned ? "    movswq %ax, %rax\n" : "    movzwl %ax, %eax\n");
+        else if (w.bits == 32)
+            out << (w.isSigned ? "    movslq %eax, %rax\n" : "    movl %eax, %eax\n");
+    }
+
+
+    // ===== Instructions =====
+
+    void moveParameters()
+    {
+        for (ValueId v = 0; v < fn.values.size(); v++)
+        {
+            const IRInst& inst = fn.values[v];
+
+            if (inst.op != IROp::Param || !allocated[v])
+                continue;
+
+            size_t index = static_cast<size_t>(inst.imm);
+
+            if (index < 6)
+                out << "    movq " << ARGUMENT_REGISTERS[index] << ", %rax\n";
+            else
+                out << "    movq " << 16 + 8 * static_cast<int64_t>(index - 6) << "(%rbp), %rax\n";
+
+            // Only the low bits of narrow arguments are defined
+            normalize(inst.type);
+            store(v);
+        }
+    }
+
+    // Copies for the phis of `to` when control comes from `from`
+    void emitPhiCopies(BlockId from, BlockId to)
+    {
+        for (ValueId v : fn.blocks[to].insts)
+        {
+            const IRInst& phi = fn.values[v];
+            if (phi.op != IROp::Phi)
+                break;
+
+            for (size_t i = 0; i < phi.operands.size(); i++)
+            {
+                if (phi.targets[i] != from)
+                    continue;
+
+                // Registers and immediates go straight to the slot; x86 has
+                // no move from memory to memory
+                std::string text = operand(phi.operands[i], true);
+
+                if (text.empty() || (text[0] != '%' && text[0] != '$'))
+                {
+                    load(phi.operands[i], "%rax");
+                    text = "%rax";
+                }
+
+                out << "    movq " << text << ", " << slotText(nextSlot[v]) << "\n";
+            }
+        }
+    }
+
+    void emitGoto(BlockId from, BlockId to, BlockId next)
+    {
+        emitPhiCopies(from, to);
+
+        if (to != next)
+            out << "    jmp " << blockLabel(to) << "\n";
+    }
+
+    bool hasPhis(BlockId b) const
+    {
+        const auto& insts = fn.blocks[b].insts;
+        return !insts.empty() && fn.values[insts.front()].op == IROp::Phi;
+    }
+
+    bool isSignedOperand(ValueId v) const
+    {
+        Width w = widthOf(types.info(fn.values[v].type));
+        return w.isSigned && !w.isBool;
+    }
+
+    static const char* condition(IROp op, bool isSigned)
+    {
+        switch (op)
+        {
+            case IROp::Eq: return "e";
+            case IROp::Ne: return "ne";
+            case IROp::Lt: return isSigned ? "l" : "b";
+            case IROp::Le: return isSigned ? "le" : "be";
+            case IROp::Gt: return isSigned ? "g" : "a";
+            case IROp::Ge: return isSigned ? "ge" : "ae";
+            default:       return nullptr;
+        }
+    }
+
+    void emitLoad(const IRInst& inst)
+    {
+        load(inst.operands[0], "%rax");
+
+        Width w = widthOf(types.info(inst.type));
+
+        if (w.isBool)
+            out << "    movzbl (%rax), %eax\n";
+        else if (w.bits == 8)
+            out << (w.isSigned ? "    movsbq (%rax), %rax\n" : "    movzbl (%rax), %eax\n");
+        else if (w.bits == 16)
+            out << (w.isSigned ? "    movswq (%rax), %rax\n" : "    movzwl (%rax), %eax\n");
+        else if (w.bits == 32)
+            out << (w.isSigned ? "    movslq (%rax), %rax\n" : "    movl (%rax), %eax\n");
+        else
+            out << "    movq (%rax), %rax\n";
+    }
+
+    void emitStore(const IRInst& inst)
+    {
+        load(inst.operands[0], "%rax");
+        load(inst.operands[1], "%rcx");
+
+        Width w = widthOf(types.info(fn.values[inst.operands[1]].type));
+
+        if (w.bits == 8)
+            out << "    movb %cl, (%rax)\n";
+        else if (w.bits == 16)
+            out << "    movw %cx, (%rax)\n";
+        else if (w.bits == 32)
+            out << "    movl %ecx, (%rax)\n";
+        else
+            out << "    movq %rcx, (%rax)\n";
+    }
+
+    void emitCall(const IRInst& inst)
+    {
+        size_t count = inst.operands.size();
+        size_t onStack = count > 6 ? count - 6 : 0;
+
+        // %rsp stays 16-byte aligned at the call
+        if (onStack % 2 == 1)
+            out << "    subq $8, %rsp\n";
+
+        for (size_t i = count; i-- > 6;)
+        {
+            std::string text = operand(inst.operands[i], true);
+
+            if (text.empty())
+            {
+                load(inst.operands[i], "%rax");
+                text = "%rax";
+            }
+
+            out << "    pushq " << text << "\n";
+        }
+
+        for (size_t i = 0; i < count && i < 6; i++)
+            load(inst.operands[i], ARGUMENT_REGISTERS[i]);
+
+        // No vector registers in use, for variadic callees
+        out << "    xorl %eax, %eax\n";
+
+        if (module.defined.count(inst.text))
+            out << "    call " << inst.text << "\n";
+        else
+            out << "    call " << inst.text << "@PLT\n";
+
+        if (onStack > 0)
+            out << "    addq $" << static_cast<int64_t>(8 * (onStack + onStack % 2)) << ", %rsp\n";
+
+        if (inst.type != INVALID_TYPE)
+            normalize(inst.type);
+    }
+
+    static const char* negate(const char* condition)
+    {
+        static const char* const PAIRS[][2] = {
+            { "e", "ne" }, { "l", "ge" }, { "le", "g" }, { "b", "ae" }, { "be", "a" },
+        };
+
+        for (const auto& pair : PAIRS)
+        {
+            if (std::string_view(condition) == pair[0])
+                return pair[1];
+            if (std::string_view(condition) == pair[1])
+                return pair[0];
+        }
+
+        return nullptr;
+    }
+
+    // A compare whose only use is the branch right after it
+    bool feedsBranch(const std::vector<ValueId>& insts, size_t k) const
+    {
+        ValueId v = insts[k];
+
+        return uses[v] == 1 && k + 1 < insts.size() &&
+               fn.values[insts[k + 1]].op == IROp::Branch &&
+               fn.values[insts[k + 1]].operands[0] == v;
+    }
+
+    void emitBlock(BlockId b, BlockId next)
+    {
+        out << blockLabel(b) << ":\n";
+        inRax = NO_VALUE;
+
+        const auto& insts = fn.blocks[b].insts;
+
+        for (size_t k = 0; k < insts.size(); k++)
+        {
+            ValueId v = insts[k];
+            const IRInst& inst = fn.values[v];
+
+            switch (inst.op)
+            {
+                case IROp::Phi:
+                    if (allocated[v])
+                    {
+                        out << "    movq " << slotText(nextSlot[v]) << ", %rax\n";
+                        store(v);
+                    }
+                    break;
+
+                case IROp::Alloca:
+                    break;
+
+                case IROp::Load:
+                    emitLoad(inst);
+                    store(v);
+                    break;
+
+                case IROp::Store:
+                    emitStore(inst);
+                    break;
+
+                case IROp::Add:
+                case IROp::Sub:
+                case IROp::And:
+                {
+                    const char* op = inst.op == IROp::Add ? "addq" : inst.op == IROp::Sub ? "subq" : "andq";
+
+                    std::string right = source(inst.operands[1]);
+
+                    load(inst.operands[0], "%rax");
+                    out << "    " << op << " " << right << ", %rax\n";
+                    normalize(inst.type);
+                    store(v);
+                    break;
+                }
+
+                case IROp::Mul:
+                {
+                    load(inst.operands[0], "%rax");
+
+                    std::string text = operand(inst.operands[1], false);
+                    if (text.empty())
+                    {
+                        load(inst.operands[1], "%rcx");
+                        text = "%rcx";
+                    }
+
+                    out << "    imulq " << text << ", %rax\n";
+                    normalize(inst.type);
+                    store(v);
+                    break;
+                }
+
+                case IROp::Div:
+                case IROp::Rem:
+                    load(inst.operands[0], "%rax");
+                    load(inst.operands[1], "%rcx");
+
+                    if (isSignedOperand(v))
+                        out << "    cqto\n    idivq %rcx\n";
+                    else
+                        out << "    xorl %edx, %edx\n    divq %rcx\n";
+
+                    if (inst.op == IROp::Rem)
+                        out << "    movq %rdx, %rax\n";
+
+                    normalize(inst.type);
+                    store(v);
+                    break;
+
+                case IROp::Shl:
+                case IROp::Shr:
+                    load(inst.operands[0], "%rax");
+                    load(inst.operands[1], "%rcx");
+
+                    if (inst.op == IROp::Shl)
+                        out << "    shlq %cl, %rax\n";
+                    else
+                        out << (isSignedOperand(v) ? "    sarq %cl, %rax\n" : "    shrq %cl, %rax\n");
+
+                    normalize(inst.type);
+                    store(v);
+                    break;
+
+                case IROp::Neg:
+                    load(inst.operands[0], "%rax");
+                    out << "    negq %rax\n";
+                    normalize(inst.type);
+                    store(v);
+                    break;
+
+                case IROp::Eq:
+                case IROp::Ne:
+                case IROp::Lt:
+                case IROp::Le:
+                case IROp::Gt:
+                case IROp::Ge:
+                {
+                    std::string right = source(inst.operands[1]);
+
+                    const char* cc = condition(inst.op, isSignedOperand(inst.operands[0]));
+
+                    load(inst.operands[0], "%rax");
+                    out << "    cmpq " << right << ", %rax\n";
+
+                    if (feedsBranch(insts, k))
+                    {
+                        pendingCondition = cc;
+                        break;
+                    }
+
+                    out << "    set" << cc << " %al\n"
+                        << "    movzbl %al, %eax\n";
+                    store(v);
+                    break;
+                }
+
+                case IROp::Convert:
+                    load(inst.operands[0], "%rax");
+
+                    if (widthOf(types.info(inst.type)).isBool)
+                        out << "    testq %rax, %rax\n    setne %al\n    movzbl %al, %eax\n";
+                    else
+                        normalize(inst.type);
+
+                    store(v);
+                    break;
+
+                case IROp::PtrAdd:
+                {
+                    int64_t size = elementSize(inst.type);
+
+                    load(inst.operands[0], "%rax");
+                    load(inst.operands[1], "%rcx");
+
+                    if (size == 1 || size == 2 || size == 4 || size == 8)
+                        out << "    leaq (%rax,%rcx," << size << "), %rax\n";
+                    else
+                        out << "    imulq $" << size << ", %rcx, %rcx\n    addq %rcx, %rax\n";
+
+                    store(v);
+                    break;
+                }
+
+                case IROp::PtrDiff:
+                {
+                    int64_t size = elementSize(fn.values[inst.operands[0]].type);
+
+                    std::string right = source(inst.operands[1]);
+
+                    load(inst.operands[0], "%rax");
+                    out << "    subq " << right << ", %rax\n";
+
+                    if (size > 1)
+                        out << "    movq $" << size << ", %rcx\n    cqto\n    idivq %rcx\n";
+
+                    normalize(inst.type);
+                    store(v);
+                    break;
+                }
+
+                case IROp::CheckIndex:
+                {
+                    std::string ok = newLabel();
+                    int64_t size = immediate(inst.imm);
+
+                    load(inst.operands[0], "%rax");
+
+                    if (fitsImmediate(size))
+                        out << "    cmpq $" << size << ", %rax\n";
+                    else
+                        out << "    movabsq $" << size << ", %rcx\n    cmpq %rcx, %rax\n";
+
+                    out << "    jb " << ok << "\n"
+                        << "    ud2\n"
+                        << ok << ":\n";
+                    store(v);
+                    break;
+                }
+
+                case IROp::Call:
+                    emitCall(inst);
+                    if (inst.type != INVALID_TYPE)
+                        store(v);
+                    break;
+
+                case IROp::Jump:
+                    emitGoto(b, inst.targets[0], next);
+                    break;
+
+                case IROp::Branch:
+                {
+                    const char* cc = pendingCondition;
+                    pendingCondition = nullptr;
+
+                    if (!cc)
+                    {
+                        load(inst.operands[0], "%rax");
+                        out << "    testq %rax, %rax\n";
+                        cc = "ne";
+                    }
+
+                    if (hasPhis(inst.targets[0]))
+                    {
+                        std::string otherwise = newLabel();
+
+                        out << "    j" << negate(cc) << " " << otherwise << "\n";
+                        emitPhiCopies(b, inst.targets[0]);
+                        out << "    jmp " << blockLabel(inst.targets[0]) << "\n"
+                            << otherwise << ":\n";
+
+                        // Reached from the jump, not from the copies above
+                        inRax = NO_VALUE;
+                    }
+                    else
+                        out << "    j" << cc << " " << blockLabel(inst.targets[0]) << "\n";
+
+                    emitGoto(b, inst.targets[1], next);
+                    break;
+                }
+
+                case IROp::Return:
+                    if (!inst.operands.empty())
+                        load(inst.operands[0], "%rax");
+
+                    if (next != NO_BLOCK)
+                        out << "    jmp " << returnLabel() << "\n";
+                    break;
+
+                default:
+                    throw std::runtime_error(std::string("Unsupported IR instruction in native codegen: ")
+                                             + irOpName(inst.op));
+            }
+
+            // Stores, calls without a result and the like leave %rax
+            // holding something else
+            if (!definesValue(inst))
+                inRax = NO_VALUE;
+        }
+    }
+};
+
+}
+
+
+// ===== Entry Point =====
+
+void generateAsmFromIR(const IRModule& module, CodeSink& out)
+{
+    ModuleState state;
+
+    for (const auto& fn : module.functions)
+        state.defined.insert(fn.name);
+
+    out << "    .text\n\n";
+
+    for (const auto& fn : module.functions)
+        FunctionEmitter(fn, *module.types, state, out).emit();
+
+    if (!state.rodata.empty())
+        out << "    .section .rodata\n" << state.rodata << "\n";
+
+    out << "    .section .note.GNU-stack,\"\",@progbits\n";
+}
+
+std::string generateAsmFromIR(const IRModule& module)
+{
+    CodeSink out;
+    generateAsmFromIR(module, out);
+
+    return out.take();
+}
+
+}
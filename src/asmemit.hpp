@@ -0,0 +1,24 @@
+#pragma once
+
+#include "codesink.hpp"
+#include "ir.hpp"
+
+#include <string>
+
+namespace azin
+{
+
+// x86-64 assembly from optimized IR, for GNU as (AT&T syntax) and the
+// System V calling convention, as a drop-in for the C backends on
+// x86-64 Linux.
+//
+// Values live in registers picked by a linear scan over one live
+// interval per value, or in stack slots when registers run out. Every
+// value is held in 64 bits, sign or zero extended from the width of its
+// type, so arithmetic runs on full registers and is truncated back
+// afterwards, as C's integer promotion would. Calls to functions not in
+// the module go through the PLT.
+void generateAsmFromIR(const IRModule& module, CodeSink& out);
+std::string generateAsmFromIR(const IRModule& module);
+
+}
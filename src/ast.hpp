@@ -6,51 +6,29 @@
 #include <ostream>
 #include <variant>
 
+#include "types.hpp"
+
 namespace azin
 {
-    struct Type
-    {
-        std::string base;   // "int", "char", etc
-        int pointerDepth = 0;
-        bool isArray = false;
-
-        bool operator==(const Type& other) const
-        {
-            return base == other.base &&
-                pointerDepth == other.pointerDepth &&
-                isArray == other.isArray;
-        }
-
-        bool operator!=(const Type& other) const
-        {
-            return !(*this == other);
-        }
-    };
-
-    inline std::ostream& operator<<(std::ostream& os, const Type& t)
-    {
-        os << t.base;
-
-    for (int i = 0; i < t.pointerDepth; i++)
-        os << "*";
-
-        if (t.isArray)
-            os << "[]";
-
-        return os;
-    }
-
     struct Span 
     {
         std::string file;
-        int startLine;
-        int startCol;
-        int endLine;
-        int endCol;
+        int startLine = 0;      // 0 when the node was not parsed from source
+        int startCol = 0;
+        int endLine = 0;
+        int endCol = 0;
     };
     struct Expr
     {
         Span span;
+
+        // Filled in by SemanticAnalyzer
+        TypeId type = INVALID_TYPE;            // type of the value
+        TypeId convertedType = INVALID_TYPE;   // implicit conversion where it is used, if any
+
+        // Filled in by foldConstants
+        ValueRange range;
+
         virtual ~Expr() = default;
     };
 
@@ -105,7 +83,12 @@ namespace azin
         std::vector<Param> params;
         std::unique_ptr<BlockStmt> body;
         bool isExtern = false;
+        bool isExported = false;    // external linkage in the C; everything else is static
         Span span;
+
+        // Set by layoutFunctions from the call graph or a profile
+        bool isHot = false;
+        bool isCold = false;
     };
 
 
@@ -199,6 +182,8 @@ namespace azin
         std::string moduleName;    // empty if not qualified
         std::vector<std::unique_ptr<Expr>> arguments;
 
+        std::string resolvedCallee; // C name after overload resolution, set by SemanticAnalyzer
+
         CallExpr(std::string callee,
                 std::vector<std::unique_ptr<Expr>> args,
                 std::string moduleName = "")
@@ -231,6 +216,9 @@ namespace azin
         std::unique_ptr<Expr> base;
         std::unique_ptr<Expr> index;
 
+        int arraySize = -1;     // size of the fixed array indexed, set by SemanticAnalyzer
+        bool inBounds = false;  // proven by foldConstants, so --checked needs no check
+
         IndexExpr(std::unique_ptr<Expr> base,
                 std::unique_ptr<Expr> index)
             : base(std::move(base)),
@@ -248,6 +236,7 @@ namespace azin
     struct Program
     {
         std::vector<TopLevelDecl> decls;
+        TypeTable types;
     };
 
     struct WhileStmt : Stmt
@@ -0,0 +1,386 @@
+#include "azin.hpp"
+#include "asmemit.hpp"
+#include "build.hpp"
+#include "bytecode.hpp"
+#include "irbuilder.hpp"
+#include "iremit.hpp"
+#include "semantic.hpp"
+#include "vm.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace azin
+{
+
+Compiler::Compiler(FileProvider& files, CompileOptions options)
+    : files(files), options(options) {}
+
+Program Compiler::load(const std::string& entryPath)
+{
+    ModuleLoader loader(files, options.trace);
+    return loader.loadProgramWithModules(entryPath);
+}
+
+void Compiler::analyze(Program& program)
+{
+    // Unreachable functions are dropped before they are analyzed
+    deadStats = eliminateDeadFunctions(program);
+
+    SemanticAnalyzer analyzer(options.threads);
+    analyzer.analyze(program);
+
+    // Overloads are resolved now, so the ones never picked can go too
+    DeadFunctionStats unpicked = eliminateDeadFunctions(program);
+    deadStats.functionsRemoved += unpicked.functionsRemoved;
+    deadStats.bytesRemoved += unpicked.bytesRemoved;
+
+    trace(TraceCategory::Sema, [&](std::ostream& out)
+    {
+        out << "Removed " << deadStats.functionsRemoved << " functions ("
+            << deadStats.bytesRemoved << " bytes of C)";
+    });
+
+    if (options.rewriteAST)
+        rewrite(program);
+
+    trace(TraceCategory::Sema, [&](std::ostream& out)
+    {
+        out << "Folded " << foldStats.expressionsFolded << " expressions, propagated "
+            << foldStats.variablesPropagated << " variable uses";
+    });
+
+    trace(TraceCategory::Sema, [&](std::ostream& out)
+    {
+        out << "Evaluated " << ctfeStats.callsEvaluated << " calls at compile time ("
+            << ctfeStats.pureFunctions << " pure functions)";
+    });
+
+    trace(TraceCategory::Sema, [&](std::ostream& out)
+    {
+        out << "Specialized " << specializeStats.callsSpecialized << " output calls on literals, merged "
+            << specializeStats.writesMerged << " writes";
+    });
+
+    if (options.checked)
+    {
+        trace(TraceCategory::Sema, [&](std::ostream& out)
+        {
+            out << "Bounds checks: " << foldStats.accessesInBounds << " of "
+                << foldStats.arrayAccesses << " array accesses proven in bounds";
+        });
+    }
+
+    layoutStats = layoutFunctions(program, options.orderProfile);
+
+    trace(TraceCategory::Sema, [&](std::ostream& out)
+    {
+        out << "Hot functions: " << layoutStats.hotFunctions
+            << ", cold functions: " << layoutStats.coldFunctions;
+    });
+
+    // Lowered after layout, so the IR keeps the final function order
+    if (options.ir || options.native)
+        lowerIR(program);
+}
+
+void Compiler::rewrite(Program& program)
+{
+    foldStats = foldConstants(program);
+
+    // Output calls on literals become write(1, "...", strlen("...")), and
+    // evaluatePureCalls turns the length into a constant
+    specializeStats = specializeLiteralCalls(program);
+    ctfeStats = evaluatePureCalls(program);
+
+    // Evaluated calls leave new constants to fold and may have been the
+    // last uses of some functions
+    if (ctfeStats.callsEvaluated > 0)
+    {
+        FoldStats refold = foldConstants(program);
+        refold.expressionsFolded += foldStats.expressionsFolded;
+        refold.variablesPropagated += foldStats.variablesPropagated;
+        foldStats = refold;
+
+        DeadFunctionStats unused = eliminateDeadFunctions(program);
+        deadStats.functionsRemoved += unused.functionsRemoved;
+        deadStats.bytesRemoved += unused.bytesRemoved;
+    }
+
+    specializeStats.writesMerged = mergeLiteralWrites(program);
+}
+
+void Compiler::lowerIR(Program& program)
+{
+    irModule = lowerProgram(program, options.checked);
+    irStats = optimizeIR(irModule, options.dumpIR);
+
+    trace(TraceCategory::Codegen, [&](std::ostream& out)
+    {
+        out << "IR: simplified " << irStats.simplified << ", eliminated "
+            << irStats.eliminated << " common subexpressions, hoisted "
+            << irStats.hoisted << " loop invariants, removed "
+            << irStats.removed << " dead instructions";
+    });
+}
+
+CodegenOptions Compiler::codegenOptions() const
+{
+    CodegenOptions codegen;
+    codegen.boundsChecks = options.checked;
+    codegen.threads = options.threads;
+    codegen.lineDirectives = options.debugInfo;
+    return codegen;
+}
+
+CCompiler Compiler::cCompiler() const
+{
+    CCompiler cc;
+    cc.command = options.cc.command;
+
+    if (options.optimize > 0)
+        cc.flags.push_back("-O" + std::to_string(options.optimize));
+
+    if (options.lto)
+        cc.flags.push_back("-flto");
+
+    if (options.marchNative)
+        cc.flags.push_back("-march=native");
+
+    if (options.debugInfo)
+        cc.flags.push_back("-g");
+
+    // No C library: nothing may call into it behind the program's back,
+    // such as a stack protector or loops turned into memset and memcpy.
+    // Code and data share pages rather than each getting its own.
+    if (options.freestanding)
+    {
+        for (const char* flag : { "-ffreestanding", "-fno-stack-protector", "-fno-tree-loop-distribute-patterns",
+                                  "-nostdlib", "-static", "-Wl,-z,noseparate-code" })
+            cc.flags.push_back(flag);
+    }
+
+    if (!options.profileGenerate.empty())
+        cc.flags.push_back("-fprofile-generate=" + options.profileGenerate);
+
+    if (!options.profileUse.empty())
+    {
+        cc.flags.push_back("-fprofile-use=" + options.profileUse);
+        cc.flags.push_back("-fprofile-correction");
+    }
+
+    cc.flags.insert(cc.flags.end(), options.cc.flags.begin(), options.cc.flags.end());
+    return cc;
+}
+
+std::string Compiler::generateC(const Program& program) const
+{
+    if (options.ir)
+        return generateCFromIR(program, irModule, codegenOptions());
+
+    return CodegenC(program, codegenOptions()).generate();
+}
+
+static void writeFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Cannot write file: " + path);
+
+    file << contents;
+}
+
+std::string Compiler::build(const Program& program, const std::string& baseName)
+{
+    #ifdef _WIN32
+        std::string exeFileName = baseName + ".exe";
+    #else
+        std::string exeFileName = baseName;
+    #endif
+
+    if (options.native)
+    {
+        std::string assembly = generateAsmFromIR(irModule);
+
+        if (options.emitC)
+        {
+            writeFile(baseName + ".s", assembly);
+
+            trace(TraceCategory::Codegen, [&](std::ostream& out) { out << "Assembly written to " << baseName << ".s"; });
+        }
+
+        ccOutput = assembleExecutable(assembly, exeFileName, options.trace);
+        return exeFileName;
+    }
+
+    std::vector<CSourceFile> cFiles;
+
+    // Linked into the first file, so it is defined once
+    std::string runtime;
+
+    if (options.freestanding)
+    {
+#if !(defined(__x86_64__) && defined(__linux__))
+        throw std::runtime_error("--freestanding is only supported on x86-64 Linux");
+#endif
+        runtime = CodegenC(program, codegenOptions()).generateFreestandingRuntime();
+    }
+
+    if (options.codegenUnits <= 1 || options.ir)
+    {
+        std::string cFileName = baseName + ".c";
+        std::string cCode = generateC(program) + runtime;
+
+        if (options.emitC)
+        {
+            writeFile(cFileName, cCode);
+
+            trace(TraceCategory::Codegen, [&](std::ostream& out) { out << "C source written to " << cFileName; });
+        }
+
+        cFiles.push_back({ cFileName, std::move(cCode) });
+    }
+    else
+    {
+        std::string headerName = baseName + ".h";
+        CodegenUnits units = CodegenC(program, codegenOptions()).generateUnits(options.codegenUnits, headerName);
+
+        if (options.emitC)
+            writeFile(headerName, units.header);
+
+        // Units include the header by name; on the compiler's stdin there
+        // is no file next to them, so the header text takes its place.
+        // Line directives keep diagnostics pointing into the files
+        // --emit-c writes.
+        std::string include = "#include \"" + headerName + "\"\n";
+        std::string header = units.header;
+
+        if (header.compare(0, 13, "#pragma once\n") == 0)
+            header.replace(0, 13, lineDirective(2, headerName));
+
+        for (size_t i = 0; i < units.sources.size(); i++)
+        {
+            std::string unitName = baseName + "." + std::to_string(i) + ".c";
+            std::string& source = units.sources[i];
+
+            if (i == 0)
+                source += runtime;
+
+            if (options.emitC)
+            {
+                writeFile(unitName, source);
+
+                trace(TraceCategory::Codegen, [&](std::ostream& out)
+                {
+                    out << "C source written to " << unitName << " (" << source.size() << " bytes)";
+                });
+            }
+
+            if (source.compare(0, include.size(), include) == 0)
+                source.replace(0, include.size(), header + lineDirective(2, unitName));
+
+            cFiles.push_back({ unitName, std::move(source) });
+        }
+    }
+
+    trace(TraceCategory::Codegen, [&](std::ostream& out)
+    {
+        size_t bytes = 0;
+        for (const auto& file : cFiles)
+            bytes += file.code.size();
+
+        out << "Generated " << bytes << " bytes of C in " << cFiles.size() << (cFiles.size() == 1 ? " file" : " files");
+    });
+
+    // Profile files are named after the output paths, which cache keys
+    // leave out, and a profile's contents are not in the key either
+    bool profiled = !options.profileGenerate.empty() || !options.profileUse.empty();
+
+    if (!options.profileGenerate.empty())
+    {
+        // Counts from an older build would be merged into the new ones
+        std::error_code ec;
+        std::filesystem::remove_all(options.profileGenerate, ec);
+        std::filesystem::create_directories(options.profileGenerate, ec);
+    }
+
+    if (!options.profileUse.empty() && !std::filesystem::is_directory(options.profileUse))
+        throw std::runtime_error("No profile in " + options.profileUse
+                                 + "; build with --pgo-generate and run the program first");
+
+    // -march=native (or -mtune/-mcpu=native in --cflags) stands for the
+    // CPU of whichever machine builds, which the key cannot tell apart; a
+    // cache shared between machines would hand out code for another CPU
+    CCompiler compiler = cCompiler();
+    bool hostSpecific = std::any_of(compiler.flags.begin(), compiler.flags.end(), [](const std::string& flag)
+    {
+        const std::string suffix = "=native";
+        return flag.size() > suffix.size() && flag.compare(flag.size() - suffix.size(), suffix.size(), suffix) == 0;
+    });
+
+    ccOutput = buildExecutable(cFiles, exeFileName,
+                               static_cast<unsigned>(cFiles.size()),
+                               compiler, profiled || hostSpecific ? nullptr : options.cache, options.trace);
+
+    return exeFileName;
+}
+
+std::string Compiler::compileToC(const std::string& entryPath)
+{
+    CodeSink out;
+    compileToC(entryPath, out);
+
+    return out.take();
+}
+
+void Compiler::compileToC(const std::string& entryPath, CodeSink& out)
+{
+    Program program = load(entryPath);
+    analyze(program);
+
+    if (options.ir)
+        out << generateCFromIR(program, irModule, codegenOptions());
+    else
+        CodegenC(program, codegenOptions()).generate(out);
+
+    out.flush();
+}
+
+CodegenUnits Compiler::compileToUnits(const std::string& entryPath, const std::string& headerName)
+{
+    Program program = load(entryPath);
+    analyze(program);
+
+    return CodegenC(program, codegenOptions()).generateUnits(options.codegenUnits, headerName);
+}
+
+std::string Compiler::compileToExecutable(const std::string& entryPath, const std::string& baseName)
+{
+    Program program = load(entryPath);
+    analyze(program);
+
+    return build(program, baseName);
+}
+
+int64_t Compiler::run(const std::string& entryPath)
+{
+    Program program = load(entryPath);
+    analyze(program);
+
+    if (!options.ir && !options.native)
+        lowerIR(program);
+
+    BytecodeModule code = compileBytecode(irModule);
+
+    if (options.dumpIR)
+    {
+        *options.dumpIR << "\n; ===== Bytecode =====\n\n";
+        printBytecode(code, *options.dumpIR);
+    }
+
+    return runBytecode(code);
+}
+
+}
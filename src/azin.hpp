@@ -0,0 +1,130 @@
+#pragma once
+
+// libazin: the compiler pipeline as an embeddable library.
+//
+// Sources come from a FileProvider (disk or in-memory), and nothing is
+// written or printed unless asked for. A Compiler holds all state of one
+// compilation, so separate instances can run concurrently in one process.
+
+#include "ast.hpp"
+#include "build.hpp"
+#include "callgraph.hpp"
+#include "codegen.hpp"
+#include "constfold.hpp"
+#include "ctfe.hpp"
+#include "ir.hpp"
+#include "iropt.hpp"
+#include "module.hpp"
+#include "specialize.hpp"
+#include "trace.hpp"
+
+#include <ostream>
+#include <string>
+
+namespace azin
+{
+
+class BuildCache;
+
+struct CompileOptions
+{
+    int codegenUnits = 1;                       // >1 splits the C into parallel units
+    unsigned threads = 0;                       // semantic analysis and codegen workers; 0 = one per core
+    bool checked = false;                       // bounds checks on fixed arrays (--checked)
+    bool rewriteAST = true;                     // folding, compile-time calls, literal-call specialization;
+                                                // off only for reference builds in tests
+    bool ir = false;                            // generate C through the SSA IR (--ir), one unit
+    std::ostream* dumpIR = nullptr;             // receives the IR before and after each pass (--dump-ir)
+    bool native = false;                        // x86-64 assembly through as/ld instead of C (--native)
+    bool debugInfo = false;                     // #line to the .az sources, built with -g (-g)
+    bool freestanding = false;                  // own _start and syscall externs, no libc (--freestanding)
+    int optimize = 0;                           // the C compiler's -O level, 0 to 3 (-O<n>)
+    bool lto = false;                           // link-time optimization, inlining across units (--lto)
+    bool marchNative = false;                   // tune for the building machine (--march=native)
+    std::string profileGenerate;                // instrument; runs write their profile here (--pgo-generate)
+    std::string profileUse;                     // optimize with the profile in this directory (--pgo-use)
+    const CallProfile* orderProfile = nullptr;  // drives function layout when set
+    CCompiler cc;                               // compiler and flags the C is piped to
+    bool emitC = false;                         // also write the generated C to disk (--emit-c)
+    BuildCache* cache = nullptr;                // reuses gcc outputs across builds
+    const Tracer* trace = nullptr;              // progress messages by category; nullptr = silent
+};
+
+class Compiler
+{
+public:
+    explicit Compiler(FileProvider& files, CompileOptions options = {});
+
+    // ===== Stages =====
+    Program load(const std::string& entryPath);
+    void analyze(Program& program);   // dead function removal, semantic analysis, folding, layout,
+                                      // and with options.ir or options.native lowering and IR
+                                      // optimization
+
+    // Pipes the C to options.cc and builds baseName. With options.emitC
+    // the C is kept as baseName.c (or baseName.h + baseName.<i>.c for
+    // several units). With options.native the IR is assembled and linked
+    // directly, and emitC keeps the assembly as baseName.s instead.
+    // Returns the executable path.
+    std::string build(const Program& program, const std::string& baseName);
+
+    // ===== One-shot helpers =====
+    std::string compileToC(const std::string& entryPath);
+    void compileToC(const std::string& entryPath, CodeSink& out);   // e.g. CodeSink(fd) to stream to a file
+    CodegenUnits compileToUnits(const std::string& entryPath, const std::string& headerName);
+    std::string compileToExecutable(const std::string& entryPath, const std::string& baseName);
+
+    // Compiles to bytecode and runs main in the interpreter (vm.hpp), with
+    // no C compiler and nothing written to disk. Returns what main returns.
+    int64_t run(const std::string& entryPath);
+
+    const DeadFunctionStats& deadFunctions() const { return deadStats; }
+    const FoldStats& folding() const { return foldStats; }
+    const CtfeStats& compileTimeCalls() const { return ctfeStats; }
+    const SpecializeStats& literalCalls() const { return specializeStats; }
+    const LayoutStats& layout() const { return layoutStats; }
+    const IROptStats& irOptimization() const { return irStats; }
+
+    // What the C compiler (or assembler and linker) printed during the last build()
+    const std::string& compilerOutput() const { return ccOutput; }
+
+private:
+    FileProvider& files;
+    CompileOptions options;
+
+    CodegenOptions codegenOptions() const;
+
+    template <typename Fn>
+    void trace(TraceCategory category, Fn fn) const
+    {
+        if (options.trace)
+            (*options.trace)(category, fn);
+    }
+
+    // options.cc with the flags the options above ask for in front of
+    // the user's, so explicit --cflags still win
+    CCompiler cCompiler() const;
+
+    // C for the whole program in one file, from the IR with options.ir
+    std::string generateC(const Program& program) const;
+
+    // Folding, compile-time evaluation and literal-call specialization
+    void rewrite(Program& program);
+
+    // Lowers the analyzed program into irModule and optimizes it
+    void lowerIR(Program& program);
+
+    DeadFunctionStats deadStats;
+    FoldStats foldStats;
+    CtfeStats ctfeStats;
+    SpecializeStats specializeStats;
+    LayoutStats layoutStats;
+    IROptStats irStats;
+    std::string ccOutput;
+
+    // Lowered by the last analyze() when options.ir or options.native is set,
+    // and by run()
+    IRModule irModule;
+};
+
+}
@@ -0,0 +1,250 @@
+#include "build.hpp"
+#include "cache.hpp"
+#include "process.hpp"
+#include "threadpool.hpp"
+
+#include <filesystem>
+#include <ostream>
+#include <stdexcept>
+
+namespace azin
+{
+
+static void report(const Tracer* tracer, TraceLevel level, const std::string& line)
+{
+    if (tracer)
+        (*tracer)(TraceCategory::Build, level, [&](std::ostream& out) { out << line; });
+}
+
+static std::string objectFileName(const std::string& cFile)
+{
+    return std::filesystem::path(cFile).replace_extension(".o").string();
+}
+
+// The compiler's command line with `args` after the configured flags
+static std::vector<std::string> commandFor(const CCompiler& compiler, std::vector<std::string> args)
+{
+    std::vector<std::string> command{ compiler.command };
+    command.insert(command.end(), compiler.flags.begin(), compiler.flags.end());
+    command.insert(command.end(), args.begin(), args.end());
+    return command;
+}
+
+std::string lineDirective(int line, const std::string& path)
+{
+    std::string directive = "#line " + std::to_string(line) + " \"";
+
+    for (char c : path)
+    {
+        if (c == '"' || c == '\\')
+            directive += '\\';
+        directive += c;
+    }
+
+    return directive + "\"\n";
+}
+
+// The source as piped; diagnostics name its file instead of <stdin>
+static std::string namedInput(const CSourceFile& source)
+{
+    return lineDirective(1, source.path) + source.code;
+}
+
+struct Run
+{
+    std::vector<std::string> command;
+    std::string input;
+    std::string output;     // file the command produces
+    std::string key;        // cache key; empty without a cache
+
+    ProcessResult result;
+    bool hit = false;
+};
+
+// Deletes its files when the build returns or throws
+struct TemporaryFiles
+{
+    std::vector<std::string> paths;
+
+    ~TemporaryFiles()
+    {
+        std::error_code ec;
+        for (const auto& path : paths)
+            std::filesystem::remove(path, ec);
+    }
+};
+
+// Runs the command unless the cache already holds its output
+static void runCached(Run& run, BuildCache* cache)
+{
+    if (cache && cache->fetch(run.key, run.output))
+    {
+        run.hit = true;
+        return;
+    }
+
+    run.result = runProcess(run.command, run.input);
+
+    if (run.result.exitCode == 0 && cache)
+        cache->store(run.key, run.output);
+}
+
+// Logs the run and collects its diagnostics; throws if it failed
+static void finish(const Run& run, const std::string& what, std::string& diagnostics, const Tracer* tracer)
+{
+    if (run.hit)
+    {
+        report(tracer, TraceLevel::Info, "Cache hit: " + run.output + " (" + run.key.substr(0, 12) + ")");
+        return;
+    }
+
+    report(tracer, TraceLevel::Info, "Running: " + commandLine(run.command));
+
+    std::string output = run.result.output;
+    while (!output.empty() && (output.back() == '\n' || output.back() == '\r'))
+        output.pop_back();
+
+    if (!output.empty())
+        report(tracer, TraceLevel::Debug, output);
+
+    diagnostics += run.result.output;
+
+    if (run.result.exitCode != 0)
+    {
+        throw std::runtime_error(what + " failed (" + run.command[0] + " exited with status "
+                                 + std::to_string(run.result.exitCode) + ")"
+                                 + (output.empty() ? "" : ":\n" + output));
+    }
+}
+
+// The parts of a command the cache key depends on: everything but paths
+static std::string keyCommand(const CCompiler& compiler, const std::string& rest)
+{
+    return commandLine(commandFor(compiler, {})) + " " + rest;
+}
+
+std::string buildExecutable(const std::vector<CSourceFile>& sources,
+                            const std::string& exeFileName,
+                            unsigned jobs,
+                            const CCompiler& compiler,
+                            BuildCache* cache,
+                            const Tracer* tracer)
+{
+    std::string diagnostics;
+
+    if (sources.size() == 1)
+    {
+        Run run;
+        run.command = commandFor(compiler, { "-x", "c", "-", "-o", exeFileName });
+        run.input = namedInput(sources[0]);
+        run.output = exeFileName;
+
+        // The key covers the exact bytes piped, whose first #line names the
+        // source (debug info depends on it), but not the output path
+        run.key = cache ? cache->key(keyCommand(compiler, "-x c - -o <exe>"), run.input) : "";
+
+        runCached(run, cache);
+        finish(run, "C compilation", diagnostics, tracer);
+
+        return diagnostics;
+    }
+
+    // ===== Compile units in parallel =====
+    std::vector<Run> runs(sources.size());
+    TemporaryFiles objects;
+    std::string linkInputs;
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        objects.paths.push_back(objectFileName(sources[i].path));
+
+        Run& run = runs[i];
+        run.command = commandFor(compiler, { "-c", "-x", "c", "-", "-o", objects.paths.back() });
+        run.input = namedInput(sources[i]);
+        run.output = objects.paths.back();
+        run.key = cache ? cache->key(keyCommand(compiler, "-c -x c - -o <obj>"), run.input) : "";
+
+        linkInputs += run.key + "\n";
+    }
+
+    parallelFor(runs.size(), jobs, [&](size_t i)
+    {
+        runCached(runs[i], cache);
+    });
+
+    for (size_t i = 0; i < runs.size(); i++)
+        finish(runs[i], "C compilation of " + sources[i].path, diagnostics, tracer);
+
+    // ===== Link =====
+    // The objects only feed the link and are deleted after it
+    std::vector<std::string> linkArgs = objects.paths;
+    linkArgs.push_back("-o");
+    linkArgs.push_back(exeFileName);
+
+    Run link;
+    link.command = commandFor(compiler, linkArgs);
+    link.output = exeFileName;
+    link.key = cache ? cache->key(keyCommand(compiler, "<objs> -o <exe>"), linkInputs) : "";
+
+    runCached(link, cache);
+    finish(link, "Linking", diagnostics, tracer);
+
+    return diagnostics;
+}
+
+
+// ===== Native =====
+
+// Directory holding crt1.o, crti.o, crtn.o and the C library
+static std::string startFileDirectory()
+{
+    static const char* const CANDIDATES[] = {
+        "/usr/lib/x86_64-linux-gnu", "/usr/lib64", "/lib/x86_64-linux-gnu", "/lib64", "/usr/lib",
+    };
+
+    for (const char* dir : CANDIDATES)
+    {
+        std::error_code ec;
+        if (std::filesystem::exists(std::filesystem::path(dir) / "crt1.o", ec))
+            return dir;
+    }
+
+    throw std::runtime_error("Cannot find the C runtime start files (crt1.o) for linking natively");
+}
+
+std::string assembleExecutable(const std::string& assembly,
+                               const std::string& exeFileName,
+                               const Tracer* tracer)
+{
+    std::string diagnostics;
+    std::string object = exeFileName + ".o";
+    std::string dir = startFileDirectory();
+
+    Run assemble;
+    assemble.command = { "as", "--64", "-o", object };
+    assemble.input = assembly;
+    assemble.output = object;
+
+    runCached(assemble, nullptr);
+    finish(assemble, "Assembly", diagnostics, tracer);
+
+    Run link;
+    link.command = {
+        "ld", "-o", exeFileName,
+        "-dynamic-linker", "/lib64/ld-linux-x86-64.so.2",
+        dir + "/crt1.o", dir + "/crti.o", object,
+        "-L" + dir, "-lc", dir + "/crtn.o",
+    };
+    link.output = exeFileName;
+
+    runCached(link, nullptr);
+
+    std::error_code ec;
+    std::filesystem::remove(object, ec);
+
+    finish(link, "Linking", diagnostics, tracer);
+
+    return diagnostics;
+}
+
+}
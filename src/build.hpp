@@ -0,0 +1,59 @@
+#pragma once
+
+#include "trace.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace azin
+{
+
+class BuildCache;
+
+struct CSourceFile
+{
+    std::string path;   // names the object file and messages; need not exist
+    std::string code;   // complete C, piped to the compiler
+};
+
+// `#line <line> "<path>"` and a newline: diagnostics for the text after
+// it name that file and line
+std::string lineDirective(int line, const std::string& path);
+
+// The C compiler and the flags every run gets
+struct CCompiler
+{
+    std::string command = "gcc";
+    std::vector<std::string> flags;
+};
+
+// Compiles the generated C into an executable. Each source is streamed
+// to the compiler's stdin (`-x c -`), so nothing has to be on disk. A
+// single source is built in one run; several are compiled to objects
+// concurrently, at most `jobs` at a time, and then linked. The objects
+// are deleted once the link is done or the build has failed.
+//
+// With a cache, outputs whose inputs are unchanged are copied instead of
+// rebuilt. Commands and cache hits are traced (build), and what the tools
+// print as well at debug level.
+// Returns what the compiler printed (warnings); on failure throws
+// std::runtime_error with its exit status and diagnostics.
+std::string buildExecutable(const std::vector<CSourceFile>& sources,
+                            const std::string& exeFileName,
+                            unsigned jobs,
+                            const CCompiler& compiler = {},
+                            BuildCache* cache = nullptr,
+                            const Tracer* tracer = nullptr);
+
+// Builds an executable from x86-64 assembly without a C compiler: the
+// assembly is piped to `as`, and the object is linked against the C
+// library by `ld` with the C runtime start files, looked up in the usual
+// library directories. x86-64 Linux only. Returns what the tools printed;
+// throws std::runtime_error if a step fails or the start files are
+// missing.
+std::string assembleExecutable(const std::string& assembly,
+                               const std::string& exeFileName,
+                               const Tracer* tracer = nullptr);
+
+}
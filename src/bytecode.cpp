@@ -0,0 +1,616 @@
+#include "bytecode.hpp"
+#include "cinteger.hpp"
+#include "ctfe.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace azin
+{
+
+const char* opcodeName(Opcode op)
+{
+    static const char* const NAMES[] = {
+#define AZIN_OPCODE_NAME(name) #name,
+        AZIN_OPCODES(AZIN_OPCODE_NAME)
+#undef AZIN_OPCODE_NAME
+    };
+
+    return op < Opcode::Count ? NAMES[static_cast<int>(op)] : "?";
+}
+
+
+// ===== Types =====
+
+// How a value of some type sits in a 64-bit register
+struct Width
+{
+    int bits = 64;
+    bool isSigned = false;
+    bool isBool = false;
+};
+
+static Width widthOf(const TypeInfo& info)
+{
+    Width w;
+
+    if (info.isPointer || info.isArray)
+        return w;
+
+    w.bits = info.bits;
+    w.isSigned = info.isSigned;
+    w.isBool = info.base == BaseKind::Bool;
+    return w;
+}
+
+// The instruction that brings a 64-bit result back to the width of w,
+// or Move when it already is
+static Opcode extension(Width w)
+{
+    if (w.isBool)
+        return Opcode::Zext8;
+
+    switch (w.bits)
+    {
+        case 8:  return w.isSigned ? Opcode::Sext8 : Opcode::Zext8;
+        case 16: return w.isSigned ? Opcode::Sext16 : Opcode::Zext16;
+        case 32: return w.isSigned ? Opcode::Sext32 : Opcode::Zext32;
+        default: return Opcode::Move;
+    }
+}
+
+static bool isInt(Width w)
+{
+    return w.bits == 32 && w.isSigned && !w.isBool;
+}
+
+static Opcode comparison(IROp op, bool isSigned)
+{
+    switch (op)
+    {
+        case IROp::Eq: return Opcode::Eq;
+        case IROp::Ne: return Opcode::Ne;
+        case IROp::Lt: return isSigned ? Opcode::LtS : Opcode::LtU;
+        case IROp::Le: return isSigned ? Opcode::LeS : Opcode::LeU;
+        case IROp::Gt: return isSigned ? Opcode::GtS : Opcode::GtU;
+        default:       return isSigned ? Opcode::GeS : Opcode::GeU;
+    }
+}
+
+// The conditional jump taken when a comparison holds
+static_assert(static_cast<int>(Opcode::GeU) - static_cast<int>(Opcode::Eq) ==
+              static_cast<int>(Opcode::JumpGeU) - static_cast<int>(Opcode::JumpEq),
+              "comparisons and conditional jumps must be listed in the same order");
+
+static Opcode jumpOn(Opcode compare)
+{
+    return static_cast<Opcode>(static_cast<int>(Opcode::JumpEq)
+                               + static_cast<int>(compare) - static_cast<int>(Opcode::Eq));
+}
+
+static Opcode negate(Opcode jump)
+{
+    switch (jump)
+    {
+        case Opcode::JumpEq:  return Opcode::JumpNe;
+        case Opcode::JumpNe:  return Opcode::JumpEq;
+        case Opcode::JumpLtS: return Opcode::JumpGeS;
+        case Opcode::JumpGeS: return Opcode::JumpLtS;
+        case Opcode::JumpLeS: return Opcode::JumpGtS;
+        case Opcode::JumpGtS: return Opcode::JumpLeS;
+        case Opcode::JumpLtU: return Opcode::JumpGeU;
+        case Opcode::JumpGeU: return Opcode::JumpLtU;
+        case Opcode::JumpLeU: return Opcode::JumpGtU;
+        case Opcode::JumpGtU: return Opcode::JumpLeU;
+        case Opcode::JumpIf:  return Opcode::JumpIfNot;
+        default:              return Opcode::JumpIf;
+    }
+}
+
+
+// ===== Functions =====
+
+namespace
+{
+
+struct ModuleContext
+{
+    BytecodeModule& module;
+    TypeTable& types;
+    std::unordered_map<std::string, uint32_t> functions;
+    std::unordered_map<std::string, uint32_t> natives;
+    std::unordered_map<std::string, const char*> strings;   // source text -> decoded bytes
+};
+
+class FunctionCompiler
+{
+public:
+    FunctionCompiler(const IRFunction& fn, ModuleContext& ctx) : fn(fn), ctx(ctx) {}
+
+    BytecodeFunction compile()
+    {
+        out.name = fn.name;
+
+        assignRegisters();
+
+        std::vector<BlockId> order = fn.reversePostorder();
+        blockStart.assign(fn.blocks.size(), 0);
+
+        for (size_t i = 0; i < order.size(); i++)
+            compileBlock(order[i], i + 1 < order.size() ? order[i + 1] : NO_BLOCK);
+
+        for (const auto& [at, block] : fixups)
+            out.code[at].imm = static_cast<int64_t>(blockStart[block]);
+
+        return std::move(out);
+    }
+
+private:
+    const IRFunction& fn;
+    ModuleContext& ctx;
+    BytecodeFunction out;
+
+    std::vector<uint32_t> reg;              // value -> register
+    std::vector<uint32_t> uses;
+    std::vector<uint32_t> allocaOffset;     // alloca -> start of its memory in the frame
+    uint32_t scratch = 0;                   // breaks phi copy cycles; receives unused results
+    std::vector<size_t> blockStart;
+    std::vector<std::pair<size_t, BlockId>> fixups;   // jump -> block it targets
+
+    void assignRegisters()
+    {
+        reg.assign(fn.values.size(), UINT32_MAX);
+        uses.assign(fn.values.size(), 0);
+        allocaOffset.assign(fn.values.size(), 0);
+        out.params.assign(fn.paramTypes.size(), 0);
+
+        for (ValueId v = 0; v < fn.values.size(); v++)
+        {
+            const IRInst& inst = fn.values[v];
+
+            bool placed = inst.block != NO_BLOCK;
+
+            if (placed)
+            {
+                for (ValueId operand : inst.operands)
+                    uses[operand]++;
+            }
+
+            bool defines = inst.type != INVALID_TYPE && !isTerminator(inst.op) && inst.op != IROp::Store;
+
+            if (!(placed && defines) && !isUnplaced(inst.op))
+                continue;
+
+            reg[v] = static_cast<uint32_t>(out.initial.size());
+            out.initial.push_back(initialValue(inst));
+
+            if (inst.op == IROp::Param)
+                out.params[static_cast<size_t>(inst.imm)] = reg[v];
+
+            if (inst.op == IROp::Alloca)
+            {
+                int64_t bytes = elementSize(inst.type) * static_cast<int64_t>(inst.imm);
+                bytes = (std::max<int64_t>(bytes, 1) + 15) / 16 * 16;
+
+                allocaOffset[v] = out.frameBytes;
+                out.frameBytes += static_cast<uint32_t>(bytes);
+            }
+        }
+
+        scratch = static_cast<uint32_t>(out.initial.size());
+        out.initial.push_back(0);
+    }
+
+    int64_t initialValue(const IRInst& inst)
+    {
+        switch (inst.op)
+        {
+            case IROp::Const:
+                return static_cast<int64_t>(static_cast<uint64_t>(inst.imm));
+            case IROp::String:
+                return reinterpret_cast<int64_t>(stringData(inst.text));
+            default:
+                return 0;
+        }
+    }
+
+    const char* stringData(const std::string& text)
+    {
+        auto it = ctx.strings.find(text);
+        if (it != ctx.strings.end())
+            return it->second;
+
+        std::string bytes;
+        if (!decodeString(text, bytes))
+            throw std::runtime_error("Unsupported string literal in bytecode: \"" + text + "\"");
+
+        ctx.module.strings.push_back(std::move(bytes));
+        const char* data = ctx.module.strings.back().c_str();
+
+        ctx.strings.emplace(text, data);
+        return data;
+    }
+
+    int64_t elementSize(TypeId pointer) const
+    {
+        const TypeInfo& info = ctx.types.info(ctx.types.pointee(pointer));
+
+        if (info.isPointer)
+            return 8;
+
+        return std::max(info.bits / 8, 1);
+    }
+
+    Width widthOf(ValueId v) const
+    {
+        return azin::widthOf(ctx.types.info(fn.values[v].type));
+    }
+
+    void emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, int64_t imm = 0)
+    {
+        out.code.push_back({ op, a, b, c, imm });
+    }
+
+    void emitJump(Opcode op, BlockId target, uint32_t b = 0, uint32_t c = 0)
+    {
+        fixups.push_back({ out.code.size(), target });
+        emit(op, 0, b, c);
+    }
+
+    // a = ext(a) when the type of v is narrower than 64 bits
+    void extend(ValueId v)
+    {
+        Opcode ext = extension(widthOf(v));
+
+        if (ext != Opcode::Move)
+            emit(ext, reg[v], reg[v]);
+    }
+
+    // The phi copies on the edge from -> to, as moves that never overwrite
+    // a register a later move still reads
+    void emitPhiCopies(BlockId from, BlockId to)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> moves;   // (dst, src)
+
+        for (ValueId v : fn.blocks[to].insts)
+        {
+            const IRInst& phi = fn.values[v];
+            if (phi.op != IROp::Phi)
+                break;
+
+            for (size_t i = 0; i < phi.operands.size(); i++)
+            {
+                if (phi.targets[i] == from && reg[v] != reg[phi.operands[i]])
+                    moves.push_back({ reg[v], reg[phi.operands[i]] });
+            }
+        }
+
+        while (!moves.empty())
+        {
+            bool progress = false;
+
+            for (size_t i = 0; i < moves.size();)
+            {
+                uint32_t dst = moves[i].first;
+                bool read = std::any_of(moves.begin(), moves.end(),
+                                        [&](const auto& m) { return m.second == dst; });
+
+                if (read)
+                {
+                    i++;
+                    continue;
+                }
+
+                emit(Opcode::Move, dst, moves[i].second);
+                moves.erase(moves.begin() + static_cast<std::ptrdiff_t>(i));
+                progress = true;
+            }
+
+            if (progress || moves.empty())
+                continue;
+
+            // Only cycles are left: park one destination in scratch
+            uint32_t parked = moves.front().first;
+            emit(Opcode::Move, scratch, parked);
+
+            for (auto& m : moves)
+            {
+                if (m.second == parked)
+                    m.second = scratch;
+            }
+        }
+    }
+
+    bool hasPhis(BlockId b) const
+    {
+        const auto& insts = fn.blocks[b].insts;
+        return !insts.empty() && fn.values[insts.front()].op == IROp::Phi;
+    }
+
+    void emitGoto(BlockId from, BlockId to, BlockId next)
+    {
+        emitPhiCopies(from, to);
+
+        if (to != next)
+            emitJump(Opcode::Jump, to);
+    }
+
+    void compileBlock(BlockId b, BlockId next)
+    {
+        blockStart[b] = out.code.size();
+
+        const auto& insts = fn.blocks[b].insts;
+
+        // A comparison whose only use is the branch after it becomes the
+        // branch's condition instead of a value
+        Opcode pendingJump = Opcode::Count;
+        uint32_t left = 0;
+        uint32_t right = 0;
+
+        for (size_t k = 0; k < insts.size(); k++)
+        {
+            ValueId v = insts[k];
+            const IRInst& inst = fn.values[v];
+
+            uint32_t a = reg[v];
+            uint32_t b0 = inst.operands.size() > 0 ? reg[inst.operands[0]] : 0;
+            uint32_t b1 = inst.operands.size() > 1 ? reg[inst.operands[1]] : 0;
+
+            switch (inst.op)
+            {
+                case IROp::Phi:
+                    break;
+
+                case IROp::Alloca:
+                    emit(Opcode::Alloca, a, 0, 0, allocaOffset[v]);
+                    break;
+
+                case IROp::Load:
+                {
+                    Width w = widthOf(v);
+                    Opcode op = Opcode::Load64;
+
+                    if (w.isBool || w.bits == 8)
+                        op = w.isSigned ? Opcode::Load8S : Opcode::Load8U;
+                    else if (w.bits == 16)
+                        op = w.isSigned ? Opcode::Load16S : Opcode::Load16U;
+                    else if (w.bits == 32)
+                        op = w.isSigned ? Opcode::Load32S : Opcode::Load32U;
+
+                    emit(op, a, b0);
+                    break;
+                }
+
+                case IROp::Store:
+                {
+                    Width w = widthOf(inst.operands[1]);
+                    Opcode op = w.bits == 8 ? Opcode::Store8 : w.bits == 16 ? Opcode::Store16
+                              : w.bits == 32 ? Opcode::Store32 : Opcode::Store64;
+
+                    emit(op, b0, b1);
+                    break;
+                }
+
+                case IROp::Add:
+                case IROp::Sub:
+                case IROp::Mul:
+                {
+                    static const Opcode WIDE[] = { Opcode::Add, Opcode::Sub, Opcode::Mul };
+                    static const Opcode INT[] = { Opcode::Add32, Opcode::Sub32, Opcode::Mul32 };
+                    int index = inst.op == IROp::Add ? 0 : inst.op == IROp::Sub ? 1 : 2;
+
+                    if (isInt(widthOf(v)))
+                    {
+                        emit(INT[index], a, b0, b1);
+                        break;
+                    }
+
+                    emit(WIDE[index], a, b0, b1);
+                    extend(v);
+                    break;
+                }
+
+                case IROp::And:
+                    emit(Opcode::And, a, b0, b1);
+                    break;
+
+                case IROp::Shl:
+                    emit(Opcode::Shl, a, b0, b1);
+                    extend(v);
+                    break;
+
+                case IROp::Shr:
+                    emit(widthOf(v).isSigned ? Opcode::Sar : Opcode::Shr, a, b0, b1);
+                    extend(v);
+                    break;
+
+                case IROp::Neg:
+                    emit(Opcode::Neg, a, b0);
+                    extend(v);
+                    break;
+
+                case IROp::Div:
+                case IROp::Rem:
+                {
+                    bool isSigned = widthOf(v).isSigned;
+                    Opcode op = inst.op == IROp::Div ? (isSigned ? Opcode::DivS : Opcode::DivU)
+                                                     : (isSigned ? Opcode::RemS : Opcode::RemU);
+                    emit(op, a, b0, b1);
+                    extend(v);
+                    break;
+                }
+
+                case IROp::Eq:
+                case IROp::Ne:
+                case IROp::Lt:
+                case IROp::Le:
+                case IROp::Gt:
+                case IROp::Ge:
+                {
+                    Width w = widthOf(inst.operands[0]);
+                    Opcode op = comparison(inst.op, w.isSigned && !w.isBool);
+
+                    if (uses[v] == 1 && k + 1 < insts.size() &&
+                        fn.values[insts[k + 1]].op == IROp::Branch &&
+                        fn.values[insts[k + 1]].operands[0] == v)
+                    {
+                        pendingJump = jumpOn(op);
+                        left = b0;
+                        right = b1;
+                        break;
+                    }
+
+                    emit(op, a, b0, b1);
+                    break;
+                }
+
+                case IROp::Convert:
+                {
+                    Width w = widthOf(v);
+
+                    if (w.isBool)
+                        emit(Opcode::ToBool, a, b0);
+                    else
+                        emit(extension(w), a, b0);
+                    break;
+                }
+
+                case IROp::PtrAdd:
+                    emit(Opcode::PtrAdd, a, b0, b1, elementSize(inst.type));
+                    break;
+
+                case IROp::PtrDiff:
+                    emit(Opcode::PtrDiff, a, b0, b1, elementSize(fn.values[inst.operands[0]].type));
+                    extend(v);
+                    break;
+
+                case IROp::CheckIndex:
+                    emit(Opcode::CheckIndex, a, b0, 0, static_cast<int64_t>(inst.imm));
+                    break;
+
+                case IROp::Call:
+                {
+                    uint32_t first = static_cast<uint32_t>(out.args.size());
+
+                    for (ValueId operand : inst.operands)
+                        out.args.push_back(reg[operand]);
+
+                    uint32_t count = static_cast<uint32_t>(inst.operands.size());
+                    uint32_t result = inst.type != INVALID_TYPE ? a : scratch;
+
+                    auto callee = ctx.functions.find(inst.text);
+
+                    if (callee != ctx.functions.end())
+                    {
+                        emit(Opcode::Call, result, first, count, callee->second);
+                        break;
+                    }
+
+                    auto native = ctx.natives.try_emplace(inst.text, static_cast<uint32_t>(ctx.natives.size()));
+                    if (native.second)
+                        ctx.module.natives.push_back(inst.text);
+
+                    emit(Opcode::CallNative, result, first, count, native.first->second);
+
+                    // Only the low bits of a C result are defined
+                    if (inst.type != INVALID_TYPE)
+                        extend(v);
+                    break;
+                }
+
+                case IROp::Jump:
+                    emitGoto(b, inst.targets[0], next);
+                    break;
+
+                case IROp::Branch:
+                {
+                    Opcode jump = pendingJump;
+
+                    if (jump == Opcode::Count)
+                    {
+                        jump = Opcode::JumpIf;
+                        left = b0;
+                    }
+
+                    pendingJump = Opcode::Count;
+
+                    if (hasPhis(inst.targets[0]))
+                    {
+                        size_t skip = out.code.size();
+                        emit(negate(jump), 0, left, right);
+
+                        emitPhiCopies(b, inst.targets[0]);
+                        emitJump(Opcode::Jump, inst.targets[0]);
+
+                        out.code[skip].imm = static_cast<int64_t>(out.code.size());
+                    }
+                    else
+                        emitJump(jump, inst.targets[0], left, right);
+
+                    emitGoto(b, inst.targets[1], next);
+                    break;
+                }
+
+                case IROp::Return:
+                    if (inst.operands.empty())
+                        emit(Opcode::ReturnVoid);
+                    else
+                        emit(Opcode::Return, b0);
+                    break;
+
+                default:
+                    throw std::runtime_error(std::string("Unsupported IR instruction in bytecode: ")
+                                             + irOpName(inst.op));
+            }
+        }
+    }
+};
+
+}
+
+
+// ===== Entry Point =====
+
+BytecodeModule compileBytecode(const IRModule& module)
+{
+    BytecodeModule result;
+    ModuleContext ctx{ result, *module.types, {}, {}, {} };
+
+    for (size_t i = 0; i < module.functions.size(); i++)
+    {
+        ctx.functions[module.functions[i].name] = static_cast<uint32_t>(i);
+
+        if (module.functions[i].name == "main")
+            result.entry = static_cast<uint32_t>(i);
+    }
+
+    if (result.entry == UINT32_MAX)
+        throw std::runtime_error("No main function to run");
+
+    for (const auto& fn : module.functions)
+        result.functions.push_back(FunctionCompiler(fn, ctx).compile());
+
+    return result;
+}
+
+void printBytecode(const BytecodeModule& module, std::ostream& out)
+{
+    for (const auto& fn : module.functions)
+    {
+        out << "fn " << fn.name << " (" << fn.initial.size() << " registers, "
+            << fn.frameBytes << " bytes of frame)\n";
+
+        for (size_t i = 0; i < fn.code.size(); i++)
+        {
+            const Instruction& inst = fn.code[i];
+
+            out << "    " << i << ": " << opcodeName(inst.op) << " r" << inst.a << ", r" << inst.b
+                << ", r" << inst.c << ", " << inst.imm << "\n";
+        }
+
+        out << "\n";
+    }
+}
+
+}
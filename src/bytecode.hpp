@@ -0,0 +1,98 @@
+#pragma once
+
+// Register bytecode for the interpreter in vm.hpp.
+//
+// Every SSA value of a function gets a register of its own. Constants
+// and string literals are registers too, filled in from the function's
+// initial register file when a frame is entered, so every instruction
+// reads registers only. Values are held as 64-bit integers, sign or zero
+// extended from the width of their type; pointers are real addresses.
+
+#include "ir.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace azin
+{
+
+// a, b, c are registers unless noted; imm is a constant or a jump target
+#define AZIN_OPCODES(X)                                                         \
+    X(Move)         /* a = b */                                                 \
+    X(Alloca)       /* a = frame memory + imm */                                \
+    X(Add) X(Sub) X(Mul) X(And) X(Shl) X(Sar) X(Shr)   /* a = b op c, 64-bit */ \
+    X(Add32) X(Sub32) X(Mul32)                         /* ... as int */         \
+    X(Neg)          /* a = -b */                                                \
+    X(DivS) X(RemS) X(DivU) X(RemU)                                             \
+    X(Sext8) X(Zext8) X(Sext16) X(Zext16) X(Sext32) X(Zext32)  /* a = ext(b) */ \
+    X(ToBool)       /* a = b != 0 */                                            \
+    X(Eq) X(Ne) X(LtS) X(LeS) X(GtS) X(GeS) X(LtU) X(LeU) X(GtU) X(GeU)         \
+    X(Load8S) X(Load8U) X(Load16S) X(Load16U) X(Load32S) X(Load32U) X(Load64)   \
+    X(Store8) X(Store16) X(Store32) X(Store64)          /* *a = b */            \
+    X(PtrAdd)       /* a = b + c * imm */                                       \
+    X(PtrDiff)      /* a = (b - c) / imm */                                     \
+    X(CheckIndex)   /* a = b, trapping unless 0 <= b < imm */                   \
+    X(Call)         /* a = functions[imm](args[b .. b + c)) */                  \
+    X(CallNative)   /* a = natives[imm](args[b .. b + c)) */                    \
+    X(Jump)         /* to imm */                                                \
+    X(JumpIf) X(JumpIfNot)                              /* on b */              \
+    X(JumpEq) X(JumpNe) X(JumpLtS) X(JumpLeS) X(JumpGtS) X(JumpGeS)             \
+    X(JumpLtU) X(JumpLeU) X(JumpGtU) X(JumpGeU)         /* on b cmp c */        \
+    X(Return)       /* a */                                                     \
+    X(ReturnVoid)
+
+enum class Opcode : uint8_t
+{
+#define AZIN_OPCODE_ENUM(name) name,
+    AZIN_OPCODES(AZIN_OPCODE_ENUM)
+#undef AZIN_OPCODE_ENUM
+    Count
+};
+
+const char* opcodeName(Opcode op);
+
+struct Instruction
+{
+    Opcode op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+    int64_t imm = 0;
+};
+
+struct BytecodeFunction
+{
+    std::string name;
+    std::vector<Instruction> code;
+    std::vector<int64_t> initial;      // registers on entry: constants, string addresses, zeros
+    std::vector<uint32_t> params;      // register of each parameter
+    std::vector<uint32_t> args;        // argument registers of every call, sliced by b and c
+    uint32_t frameBytes = 0;           // memory for the function's allocas
+};
+
+// The code holds addresses into `strings`, so a module can be moved but
+// not copied
+struct BytecodeModule
+{
+    BytecodeModule() = default;
+    BytecodeModule(BytecodeModule&&) = default;
+    BytecodeModule& operator=(BytecodeModule&&) = default;
+    BytecodeModule(const BytecodeModule&) = delete;
+    BytecodeModule& operator=(const BytecodeModule&) = delete;
+
+    std::vector<BytecodeFunction> functions;
+    std::vector<std::string> natives;  // extern functions called, bound by the VM
+    std::deque<std::string> strings;   // decoded literals; their addresses are in the code
+    uint32_t entry = UINT32_MAX;       // index of main
+};
+
+// Compiles optimized IR; throws std::runtime_error for what the bytecode
+// cannot express
+BytecodeModule compileBytecode(const IRModule& module);
+
+void printBytecode(const BytecodeModule& module, std::ostream& out);
+
+}
@@ -0,0 +1,263 @@
+#include "cache.hpp"
+#include "process.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace azin
+{
+
+// ===== SHA-256 =====
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+std::string sha256Hex(const std::string& data)
+{
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    std::string msg = data;
+    uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+
+    msg += static_cast<char>(0x80);
+    while (msg.size() % 64 != 56)
+        msg += '\0';
+
+    for (int i = 7; i >= 0; i--)
+        msg += static_cast<char>((bitLength >> (i * 8)) & 0xff);
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; i++)
+        {
+            const unsigned char* p =
+                reinterpret_cast<const unsigned char*>(msg.data() + chunk + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+                   (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = k + s1 + ch + SHA256_K[i] + w[i];
+            uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+
+            k = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    static const char* hex = "0123456789abcdef";
+    std::string out;
+
+    for (uint32_t word : h)
+    {
+        for (int i = 28; i >= 0; i -= 4)
+            out += hex[(word >> i) & 0xf];
+    }
+
+    return out;
+}
+
+
+// ===== BuildCache =====
+
+BuildCache::BuildCache(const std::string& directory, uint64_t maxBytes, const std::string& compiler)
+    : dir(directory), maxBytes(maxBytes)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    if (ec)
+        throw std::runtime_error("Cannot create cache directory: " + dir);
+
+    // A compiler that cannot start fails the build with a clearer message
+    try
+    {
+        compilerVersion = runProcess({ compiler, "--version" }).output;
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+std::string BuildCache::defaultDirectory()
+{
+    if (const char* env = std::getenv("AZIN_CACHE_DIR"))
+        return env;
+
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"))
+        return (fs::path(xdg) / "azin").string();
+
+    #ifdef _WIN32
+        const char* home = std::getenv("LOCALAPPDATA");
+    #else
+        const char* home = std::getenv("HOME");
+    #endif
+
+    if (home)
+        return (fs::path(home) / ".cache" / "azin").string();
+
+    return ".azin-cache";
+}
+
+std::string BuildCache::key(const std::string& command, const std::string& content) const
+{
+    std::string material;
+
+    material += compilerVersion;
+    material += '\0';
+    material += command;
+    material += '\0';
+    material += content;
+
+    return sha256Hex(material);
+}
+
+std::string BuildCache::entryPath(const std::string& key) const
+{
+    return (fs::path(dir) / key.substr(0, 2) / key).string();
+}
+
+bool BuildCache::fetch(const std::string& key, const std::string& destination)
+{
+    std::string entry = entryPath(key);
+    std::error_code ec;
+
+    if (!fs::exists(entry, ec))
+    {
+        missCount++;
+        return false;
+    }
+
+    fs::copy_file(entry, destination, fs::copy_options::overwrite_existing, ec);
+    if (ec)
+    {
+        missCount++;
+        return false;
+    }
+
+    // Mark as recently used for eviction
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+
+    hitCount++;
+    return true;
+}
+
+void BuildCache::store(const std::string& key, const std::string& source)
+{
+    std::string entry = entryPath(key);
+    std::error_code ec;
+
+    fs::create_directories(fs::path(entry).parent_path(), ec);
+
+    // Copy then rename, so concurrent builds never see a partial entry
+    std::string temp = entry + ".tmp" + std::to_string(std::random_device{}());
+
+    fs::copy_file(source, temp, fs::copy_options::overwrite_existing, ec);
+    if (ec)
+        return;
+
+    fs::rename(temp, entry, ec);
+    if (ec)
+        fs::remove(temp, ec);
+}
+
+void BuildCache::evict()
+{
+    struct Entry
+    {
+        fs::path path;
+        uint64_t size;
+        fs::file_time_type used;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+
+    // Entries live in directories named by their key's first two hex
+    // digits. Anything else in the directory, such as the PGO profiles
+    // azc keeps there, is neither counted nor evicted
+    for (auto shard = fs::directory_iterator(dir, ec);
+         !ec && shard != fs::directory_iterator(); shard.increment(ec))
+    {
+        std::string name = shard->path().filename().string();
+
+        if (name.size() != 2 || name.find_first_not_of("0123456789abcdef") != std::string::npos ||
+            !shard->is_directory(ec))
+            continue;
+
+        std::error_code inner;
+
+        for (auto it = fs::directory_iterator(shard->path(), inner);
+             !inner && it != fs::directory_iterator(); it.increment(inner))
+        {
+            if (!it->is_regular_file(inner))
+                continue;
+
+            Entry entry{ it->path(), it->file_size(inner), it->last_write_time(inner) };
+            total += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    if (total <= maxBytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.used < b.used; });
+
+    for (const auto& entry : entries)
+    {
+        if (total <= maxBytes)
+            break;
+
+        if (fs::remove(entry.path, ec))
+            total -= entry.size;
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace azin
+{
+
+// Content-addressed store for C compiler outputs (objects and executables).
+// Entries are keyed by a SHA-256 over the compiler version, the compiler
+// command line and the exact C text, and evicted least recently used first
+// once the directory grows past maxBytes.
+class BuildCache
+{
+public:
+    // `compiler` is asked for its version, which every key includes
+    BuildCache(const std::string& directory, uint64_t maxBytes, const std::string& compiler = "gcc");
+
+    // $AZIN_CACHE_DIR, else $XDG_CACHE_HOME/azin, else ~/.cache/azin
+    static std::string defaultDirectory();
+
+    std::string key(const std::string& command, const std::string& content) const;
+
+    // Copies a cached entry to destination; false on a miss
+    bool fetch(const std::string& key, const std::string& destination);
+    void store(const std::string& key, const std::string& source);
+
+    // Drops least recently used entries until they fit maxBytes. Other
+    // files under the directory (PGO profiles) neither count nor go.
+    void evict();
+
+    const std::string& directory() const { return dir; }
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+
+private:
+    std::string dir;
+    uint64_t maxBytes;
+    std::string compilerVersion;
+
+    std::atomic<uint64_t> hitCount{ 0 };
+    std::atomic<uint64_t> missCount{ 0 };
+
+    std::string entryPath(const std::string& key) const;
+};
+
+std::string sha256Hex(const std::string& data);
+
+}
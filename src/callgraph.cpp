@@ -0,0 +1,505 @@
+#include "callgraph.hpp"
+#include "codegen.hpp"
+#include "semantic.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace azin
+{
+
+// ===== Call collection =====
+
+// Loops multiply the static weight of the calls they contain
+static const uint64_t LOOP_WEIGHT = 8;
+static const uint64_t MAX_WEIGHT = 1ull << 40;
+
+struct CallContext
+{
+    uint64_t weight = 1;
+    bool onErrorPath = false;
+};
+
+static void collectCallsInExpr(const Expr* expr, const CallContext& ctx,
+                               std::vector<CallSite>& out);
+
+static void collectCallsInBlock(const BlockStmt* block, const CallContext& ctx,
+                                std::vector<CallSite>& out);
+
+// A branch that ends in "return <nonzero literal>" is treated as an error exit
+static bool isErrorBranch(const BlockStmt* block)
+{
+    if (!block || block->statements.empty())
+        return false;
+
+    auto ret = dynamic_cast<const ReturnStmt*>(block->statements.back().get());
+    if (!ret || !ret->value)
+        return false;
+
+    const Expr* value = ret->value.get();
+
+    if (auto un = dynamic_cast<const UnaryExpr*>(value))
+    {
+        if (un->op == "-" && dynamic_cast<const LiteralExpr*>(un->operand.get()))
+            return true;
+    }
+
+    if (auto lit = dynamic_cast<const LiteralExpr*>(value))
+    {
+        // Folded literals may carry a sign and a C suffix ("-1", "2LL")
+        const std::string& v = lit->value;
+        size_t start = (!v.empty() && v[0] == '-') ? 1 : 0;
+        size_t end = start;
+
+        while (end < v.size() && std::isdigit(static_cast<unsigned char>(v[end])))
+            end++;
+
+        return end > start && v.find_first_not_of('0', start) < end;
+    }
+
+    return false;
+}
+
+static void collectCallsInBranch(const BlockStmt* block, const CallContext& ctx,
+                                 std::vector<CallSite>& out)
+{
+    CallContext inner = ctx;
+
+    if (isErrorBranch(block))
+        inner.onErrorPath = true;
+
+    collectCallsInBlock(block, inner, out);
+}
+
+static void collectCallsInStmt(const Stmt* stmt, const CallContext& ctx,
+                               std::vector<CallSite>& out)
+{
+    if (!stmt) return;
+
+    if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+    {
+        collectCallsInExpr(exprStmt->expression.get(), ctx, out);
+    }
+    else if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+    {
+        collectCallsInExpr(var->initializer.get(), ctx, out);
+    }
+    else if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+    {
+        collectCallsInExpr(ret->value.get(), ctx, out);
+    }
+    else if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        collectCallsInExpr(assign->target.get(), ctx, out);
+        collectCallsInExpr(assign->value.get(), ctx, out);
+    }
+    else if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        CallContext loop = ctx;
+        loop.weight = std::min(ctx.weight * LOOP_WEIGHT, MAX_WEIGHT);
+
+        collectCallsInExpr(wh->condition.get(), loop, out);
+        collectCallsInBlock(wh->body.get(), loop, out);
+    }
+    else if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        collectCallsInExpr(ifs->condition.get(), ctx, out);
+        collectCallsInBranch(ifs->thenBranch.get(), ctx, out);
+        collectCallsInBranch(ifs->elseBranch.get(), ctx, out);
+    }
+    else if (auto block = dynamic_cast<const BlockStmt*>(stmt))
+    {
+        collectCallsInBlock(block, ctx, out);
+    }
+}
+
+static void collectCallsInBlock(const BlockStmt* block, const CallContext& ctx,
+                                std::vector<CallSite>& out)
+{
+    if (!block) return;
+
+    for (const auto& stmt : block->statements)
+        collectCallsInStmt(stmt.get(), ctx, out);
+}
+
+static void collectCallsInExpr(const Expr* expr, const CallContext& ctx,
+                               std::vector<CallSite>& out)
+{
+    if (!expr) return;
+
+    if (auto call = dynamic_cast<const CallExpr*>(expr))
+    {
+        // Before analysis, an overloaded call may still reach any overload
+        if (call->resolvedCallee.empty())
+        {
+            for (const auto& name : SemanticAnalyzer::overloadsOf(CodegenC::calleeName(call)))
+                out.push_back(CallSite{ name, ctx.weight, ctx.onErrorPath });
+        }
+        else
+        {
+            out.push_back(CallSite{ call->resolvedCallee, ctx.weight, ctx.onErrorPath });
+        }
+
+        for (const auto& arg : call->arguments)
+            collectCallsInExpr(arg.get(), ctx, out);
+    }
+    else if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+    {
+        collectCallsInExpr(bin->left.get(), ctx, out);
+        collectCallsInExpr(bin->right.get(), ctx, out);
+    }
+    else if (auto un = dynamic_cast<const UnaryExpr*>(expr))
+    {
+        collectCallsInExpr(un->operand.get(), ctx, out);
+    }
+    else if (auto cast = dynamic_cast<const CastExpr*>(expr))
+    {
+        collectCallsInExpr(cast->expr.get(), ctx, out);
+    }
+    else if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
+    {
+        collectCallsInExpr(addr->target.get(), ctx, out);
+    }
+    else if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+    {
+        collectCallsInExpr(deref->target.get(), ctx, out);
+    }
+    else if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+    {
+        collectCallsInExpr(idx->base.get(), ctx, out);
+        collectCallsInExpr(idx->index.get(), ctx, out);
+    }
+}
+
+
+// ===== CallGraph =====
+
+std::vector<CallSite> collectCalls(const FunctionDecl& fn)
+{
+    std::vector<CallSite> sites;
+    collectCallsInBlock(fn.body.get(), CallContext{}, sites);
+
+    return sites;
+}
+
+CallGraph CallGraph::build(const Program& program)
+{
+    CallGraph graph;
+
+    for (const auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& fn = std::get<FunctionDecl>(decl);
+        graph.edges[fn.name] = collectCalls(fn);
+    }
+
+    return graph;
+}
+
+const std::vector<CallSite>& CallGraph::callSites(const std::string& name) const
+{
+    static const std::vector<CallSite> none;
+
+    auto it = edges.find(name);
+    if (it == edges.end())
+        return none;
+
+    return it->second;
+}
+
+std::unordered_set<std::string> CallGraph::reachableFrom(const std::string& root,
+                                                         bool skipErrorPaths) const
+{
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> worklist{ root };
+
+    while (!worklist.empty())
+    {
+        std::string name = std::move(worklist.back());
+        worklist.pop_back();
+
+        if (!seen.insert(name).second)
+            continue;
+
+        for (const auto& site : callSites(name))
+        {
+            if (skipErrorPaths && site.onErrorPath)
+                continue;
+
+            if (!seen.count(site.callee))
+                worklist.push_back(site.callee);
+        }
+    }
+
+    return seen;
+}
+
+
+// ===== Dead function elimination =====
+
+DeadFunctionStats eliminateDeadFunctions(Program& program)
+{
+    DeadFunctionStats stats;
+
+    bool hasMain = false;
+    for (const auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl) &&
+            std::get<FunctionDecl>(decl).name == "main")
+            hasMain = true;
+    }
+
+    if (!hasMain)
+        return stats;
+
+    CallGraph graph = CallGraph::build(program);
+    std::unordered_set<std::string> live = graph.reachableFrom("main");
+
+    for (const auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& fn = std::get<FunctionDecl>(decl);
+
+        if (fn.isExported && !live.count(fn.name))
+        {
+            for (auto& name : graph.reachableFrom(fn.name))
+                live.insert(std::move(name));
+        }
+    }
+
+    std::vector<TopLevelDecl> kept;
+    kept.reserve(program.decls.size());
+
+    CodegenC codegen(program);
+
+    for (auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl))
+        {
+            const auto& fn = std::get<FunctionDecl>(decl);
+
+            if (!live.count(fn.name))
+            {
+                stats.functionsRemoved++;
+                stats.bytesRemoved += codegen.generateFunction(fn).size();
+                continue;
+            }
+        }
+
+        kept.push_back(std::move(decl));
+    }
+
+    program.decls = std::move(kept);
+    return stats;
+}
+
+
+// ===== Function layout =====
+
+CallProfile loadCallProfile(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Cannot open profile: " + path);
+
+    CallProfile profile;
+    std::string line;
+    int lineNo = 0;
+
+    while (std::getline(file, line))
+    {
+        lineNo++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream in(line);
+        std::string name;
+        uint64_t count = 0;
+
+        if (!(in >> name >> count))
+            throw std::runtime_error(
+                "Malformed profile entry at " + path + ":" + std::to_string(lineNo));
+
+        profile[name] += count;
+    }
+
+    return profile;
+}
+
+LayoutStats layoutFunctions(Program& program, const CallProfile* profile)
+{
+    LayoutStats stats;
+
+    std::unordered_map<std::string, FunctionDecl*> defined;
+    std::vector<std::string> declOrder;
+
+    for (auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        auto& fn = std::get<FunctionDecl>(decl);
+        if (fn.isExtern)
+            continue;
+
+        defined[fn.name] = &fn;
+        declOrder.push_back(fn.name);
+    }
+
+    if (!defined.count("main"))
+        return stats;
+
+    CallGraph graph = CallGraph::build(program);
+
+    // ===== Classify hot / cold =====
+    std::unordered_set<std::string> cold;
+
+    if (profile)
+    {
+        uint64_t hottest = 0;
+        for (const auto& name : declOrder)
+        {
+            auto it = profile->find(name);
+            if (it != profile->end())
+                hottest = std::max(hottest, it->second);
+        }
+
+        for (const auto& name : declOrder)
+        {
+            auto it = profile->find(name);
+            uint64_t count = (it == profile->end()) ? 0 : it->second;
+
+            if (count == 0 && name != "main")
+                cold.insert(name);
+            else if (hottest > 0 && count * 16 >= hottest)
+                defined[name]->isHot = true;
+        }
+    }
+    else
+    {
+        std::unordered_set<std::string> normal = graph.reachableFrom("main", true);
+
+        for (const auto& name : declOrder)
+        {
+            if (!normal.count(name))
+                cold.insert(name);
+        }
+    }
+
+    for (const auto& name : cold)
+        defined[name]->isCold = true;
+
+    // ===== Order: DFS from main, heaviest callee first =====
+    std::vector<std::string> order;
+    std::unordered_set<std::string> placed;
+
+    auto edgeWeight = [&](const CallSite& site) -> uint64_t
+    {
+        if (profile)
+        {
+            auto it = profile->find(site.callee);
+            return (it == profile->end()) ? 0 : it->second;
+        }
+        return site.weight;
+    };
+
+    auto place = [&](const std::string& root, bool coldPass)
+    {
+        std::vector<std::string> stack{ root };
+
+        while (!stack.empty())
+        {
+            std::string name = std::move(stack.back());
+            stack.pop_back();
+
+            if (!defined.count(name) || placed.count(name))
+                continue;
+
+            if (cold.count(name) != (coldPass ? 1u : 0u))
+                continue;
+
+            placed.insert(name);
+            order.push_back(name);
+
+            // Sum weights per callee, keeping first-call order for ties
+            std::vector<std::pair<std::string, uint64_t>> callees;
+            std::unordered_map<std::string, size_t> slot;
+
+            for (const auto& site : graph.callSites(name))
+            {
+                auto it = slot.find(site.callee);
+                if (it == slot.end())
+                {
+                    slot[site.callee] = callees.size();
+                    callees.push_back({ site.callee, edgeWeight(site) });
+                }
+                else
+                {
+                    callees[it->second].second += edgeWeight(site);
+                }
+            }
+
+            std::stable_sort(callees.begin(), callees.end(),
+                [](const auto& a, const auto& b) { return a.second > b.second; });
+
+            // Push in reverse so the heaviest callee is placed next
+            for (auto it = callees.rbegin(); it != callees.rend(); ++it)
+                stack.push_back(it->first);
+        }
+    };
+
+    place("main", false);
+
+    for (const auto& name : declOrder)
+        place(name, false);
+
+    for (const auto& name : declOrder)
+        place(name, true);
+
+    for (const auto& name : order)
+    {
+        if (defined[name]->isHot) stats.hotFunctions++;
+        if (defined[name]->isCold) stats.coldFunctions++;
+    }
+
+    // ===== Rebuild decls: non-functions and externs first, then layout =====
+    std::unordered_map<std::string, size_t> rank;
+    for (size_t i = 0; i < order.size(); i++)
+        rank[order[i]] = i;
+
+    std::vector<TopLevelDecl> others;
+    std::vector<TopLevelDecl> functions(order.size());
+
+    for (auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl))
+        {
+            auto& fn = std::get<FunctionDecl>(decl);
+
+            if (!fn.isExtern)
+            {
+                functions[rank[fn.name]] = std::move(decl);
+                continue;
+            }
+        }
+
+        others.push_back(std::move(decl));
+    }
+
+    program.decls = std::move(others);
+    for (auto& fn : functions)
+        program.decls.push_back(std::move(fn));
+
+    return stats;
+}
+
+}
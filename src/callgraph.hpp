@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace azin
+{
+
+struct CallSite
+{
+    std::string callee;
+    uint64_t weight = 1;       // static estimate, scaled up inside loops
+    bool onErrorPath = false;  // inside a branch that returns an error code
+};
+
+// Calls in one function body. Before semantic analysis an overloaded
+// call lists every overload it may resolve to.
+std::vector<CallSite> collectCalls(const FunctionDecl& fn);
+
+// Call edges between the functions of a merged Program.
+// Nodes are keyed by the (mangled) name the C backend emits.
+class CallGraph
+{
+public:
+    static CallGraph build(const Program& program);
+
+    const std::vector<CallSite>& callSites(const std::string& name) const;
+    std::unordered_set<std::string> reachableFrom(const std::string& root,
+                                                  bool skipErrorPaths = false) const;
+
+private:
+    std::unordered_map<std::string, std::vector<CallSite>> edges;
+};
+
+struct DeadFunctionStats
+{
+    size_t functionsRemoved = 0;
+    size_t bytesRemoved = 0;   // bytes of C the removed functions would have produced
+};
+
+// Removes every FunctionDecl (including externs) that neither main nor
+// an exported function can reach, since only those can be called from
+// outside. Does nothing when there is no main so semantic analysis can
+// report it.
+DeadFunctionStats eliminateDeadFunctions(Program& program);
+
+
+// ===== Function layout =====
+
+// Execution counts per function, one "<name> <count>" pair per line.
+// Lines starting with '#' are ignored.
+using CallProfile = std::unordered_map<std::string, uint64_t>;
+
+CallProfile loadCallProfile(const std::string& path);
+
+struct LayoutStats
+{
+    size_t hotFunctions = 0;
+    size_t coldFunctions = 0;
+};
+
+// Reorders the functions of the program so callers sit next to their
+// hottest callees (DFS from main, heaviest edge first) and moves cold
+// functions to the end, marking FunctionDecl::isHot / isCold.
+// Without a profile, functions reachable from main only through error
+// paths are cold; with one, every function it never saw run is cold.
+LayoutStats layoutFunctions(Program& program, const CallProfile* profile = nullptr);
+
+}
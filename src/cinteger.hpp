@@ -0,0 +1,195 @@
+#pragma once
+
+// Integer semantics of the generated C, shared by the passes that
+// evaluate Azin code at compile time: the widths and signedness of each
+// type, integer promotion, the usual arithmetic conversions and how
+// literals are read and written.
+
+#include "types.hpp"
+
+#include <cctype>
+#include <string>
+
+namespace azin
+{
+
+// Holds every value of every C type we emit, uint64_t included
+using Wide = __int128;
+
+// The C type an expression is evaluated in
+struct CType
+{
+    int bits = 32;          // 1 for bool
+    bool isSigned = true;
+};
+
+inline const CType C_INT{ 32, true };
+inline const CType C_BOOL{ 1, false };
+
+inline Wide typeMin(CType t)
+{
+    return t.isSigned ? -(Wide(1) << (t.bits - 1)) : 0;
+}
+
+inline Wide typeMax(CType t)
+{
+    return t.isSigned ? (Wide(1) << (t.bits - 1)) - 1 : (Wide(1) << t.bits) - 1;
+}
+
+// Reduces a value modulo 2^bits into the range of t
+inline Wide wrap(Wide value, CType t)
+{
+    Wide modulus = Wide(1) << t.bits;
+    Wide r = value % modulus;
+
+    if (r < 0)
+        r += modulus;
+
+    if (t.isSigned && r > typeMax(t))
+        r -= modulus;
+
+    return r;
+}
+
+// Integer promotion: everything narrower than int computes as int
+inline CType promote(CType t)
+{
+    return t.bits < 32 ? C_INT : t;
+}
+
+// Usual arithmetic conversions, for the widths Azin has
+inline CType commonType(CType a, CType b)
+{
+    a = promote(a);
+    b = promote(b);
+
+    if (a.bits != b.bits)
+        return a.bits > b.bits ? a : b;
+
+    return CType{ a.bits, a.isSigned && b.isSigned };
+}
+
+
+// Evaluation type of a value of the given Azin type; false for pointers,
+// arrays and anything non-integer
+inline bool cTypeOf(const TypeInfo& info, CType& out)
+{
+    if (info.isPointer || info.isArray)
+        return false;
+
+    if (info.base == BaseKind::Bool)
+    {
+        out = C_BOOL;
+        return true;
+    }
+
+    if (!info.hasIntegerBase)
+        return false;
+
+    out = CType{ info.bits, info.isSigned };
+    return true;
+}
+
+
+// ===== Literals =====
+
+// Value and C type of a literal as the C compiler reads it
+inline bool parseLiteral(const std::string& text, Wide& value, CType& type)
+{
+    if (text == "true" || text == "false")
+    {
+        value = text == "true";
+        type = C_BOOL;
+        return true;
+    }
+
+    if (text.size() == 3 && text.front() == '\'' && text.back() == '\'')
+    {
+        value = static_cast<signed char>(text[1]);
+        type = C_INT;
+        return true;
+    }
+
+    size_t i = 0;
+    bool negative = false;
+
+    if (i < text.size() && text[i] == '-')
+    {
+        negative = true;
+        i++;
+    }
+
+    if (i >= text.size() || !std::isdigit(static_cast<unsigned char>(text[i])))
+        return false;
+
+    Wide magnitude = 0;
+
+    for (; i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])); i++)
+    {
+        magnitude = magnitude * 10 + (text[i] - '0');
+
+        if (magnitude > typeMax(CType{ 64, false }))
+            return false;
+    }
+
+    bool isUnsigned = false;
+    bool isLong = false;
+
+    for (; i < text.size(); i++)
+    {
+        char c = static_cast<char>(std::tolower(static_cast<unsigned char>(text[i])));
+
+        if (c == 'u')
+            isUnsigned = true;
+        else if (c == 'l')
+            isLong = true;
+        else
+            return false;
+    }
+
+    // A decimal literal has the first of int / 64-bit (or their unsigned
+    // counterparts) that holds it. One too large for any signed type is
+    // unsigned 64-bit, as gcc reads it
+    CType narrow{ 32, !isUnsigned };
+    CType wide{ 64, !isUnsigned };
+
+    type = (!isLong && magnitude <= typeMax(narrow)) ? narrow : wide;
+
+    if (magnitude > typeMax(type))
+        type = CType{ 64, false };
+
+    value = negative ? wrap(-magnitude, type) : magnitude;
+    return true;
+}
+
+inline std::string wideToString(Wide value)
+{
+    if (value < 0)
+        return std::to_string(static_cast<long long>(value));
+
+    return std::to_string(static_cast<unsigned long long>(value));
+}
+
+// C spelling of value with type t (after promotion), or "" when C has no
+// plain literal for it
+inline std::string literalText(Wide value, CType t, bool isBool)
+{
+    if (isBool)
+        return value ? "true" : "false";
+
+    t = promote(t);
+
+    if (t.isSigned && value == typeMin(t))
+        return "";
+
+    std::string text = wideToString(value);
+
+    if (t.bits == 64)
+        text += t.isSigned ? "LL" : "ULL";
+    else if (!t.isSigned)
+        text += "u";
+
+    return text;
+}
+
+}
@@ -1,5 +1,11 @@
 #include "codegen.hpp"
-#include <sstream>
+#include "build.hpp"
+#include "callgraph.hpp"
+#include "cinteger.hpp"
+#include "module.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <filesystem>
 #include <stdexcept>
 #include <stdbool.h>
 
@@ -8,104 +14,318 @@
 namespace azin
 {
 
-// Static State
+// Printing a body takes microseconds, so only large programs repay the threads
+static constexpr size_t PARALLEL_MIN_FUNCTIONS = 256;
 
-int CodegenC::indentLevel = 0;
+// Leaves up to this many statements, nested ones included, are declared
+// inline
+static constexpr size_t TINY_LEAF_STATEMENTS = 4;
 
+static size_t countStatements(const BlockStmt* block)
+{
+    size_t count = 0;
+
+    for (const auto& stmt : block->statements)
+    {
+        count++;
+
+        if (auto ifstmt = dynamic_cast<const IfStmt*>(stmt.get()))
+        {
+            count += countStatements(ifstmt->thenBranch.get());
+
+            if (ifstmt->elseBranch)
+                count += countStatements(ifstmt->elseBranch.get());
+        }
+        else if (auto wh = dynamic_cast<const WhileStmt*>(stmt.get()))
+        {
+            count += countStatements(wh->body.get());
+        }
+    }
+
+    return count;
+}
+
+static bool isTinyLeaf(const FunctionDecl& fn)
+{
+    return collectCalls(fn).empty() && countStatements(fn.body.get()) <= TINY_LEAF_STATEMENTS;
+}
+
+CodegenC::CodegenC(const Program& program, const CodegenOptions& options)
+    : program(program), types(program.types), options(options)
+{
+    if (!options.lineDirectives)
+        return;
+
+    for (const auto& decl : program.decls)
+    {
+        const auto* fn = std::get_if<FunctionDecl>(&decl);
+
+        if (fn && !fn->span.file.empty() && !sourcePaths.count(fn->span.file))
+        {
+            std::error_code ec;
+            std::filesystem::path path = std::filesystem::absolute(fn->span.file, ec);
+            sourcePaths[fn->span.file] = ec ? fn->span.file : path.lexically_normal().string();
+        }
+    }
+}
+
+std::string CodegenC::mapTypeToC(const Type& type)
+{
+    std::string base = baseKindCName(baseKindFromName(type.base));
+
+    for (int i = 0; i < type.pointerDepth; i++)
+        base += "*";
+
+    return base;
+}
+
+const std::string& CodegenC::mapTypeToC(TypeId type) const
+{
+    return types.info(type).cName;
+}
+
+
+
+
+// Entry Point
 
-// Indentation Helpers
+std::string CodegenC::generate() const
+{
+    CodeSink out;
+    generate(out);
+
+    return out.take();
+}
 
-std::string CodegenC::indent()
+void CodegenC::generate(CodeSink& out) const
 {
-    return std::string(indentLevel * 4, ' ');
+    emitPreamble(out, true);
+    out << "\n";
+
+    emitBodies(out, nullptr);
 }
 
-void CodegenC::increaseIndent()
+
+CodegenUnits CodegenC::generateUnits(int unitCount, const std::string& headerName) const
 {
-    indentLevel++;
+    CodegenUnits units;
+
+    CodeSink header;
+    header << "#pragma once\n\n";
+    emitPreamble(header, false);
+    units.header = header.take();
+
+    // All bodies go into one buffer; ends[i] is where body i stops
+    CodeSink bodies;
+    std::vector<size_t> ends;
+
+    emitBodies(bodies, &ends);
+
+    std::string text = bodies.take();
+    size_t totalSize = text.size();
+
+    if (unitCount < 1)
+        unitCount = 1;
+
+    if (static_cast<size_t>(unitCount) > ends.size())
+        unitCount = std::max<int>(1, static_cast<int>(ends.size()));
+
+    // Cut the layout order into contiguous runs of roughly equal size,
+    // so callers placed next to their callees stay in the same unit
+    std::vector<size_t> cuts(unitCount, totalSize);
+
+    size_t start = 0;
+    int unit = 0;
+
+    for (size_t end : ends)
+    {
+        size_t boundary = totalSize * (unit + 1) / unitCount;
+
+        if (start >= boundary && unit + 1 < unitCount)
+            cuts[unit++] = start;
+
+        start = end;
+    }
+
+    start = 0;
+
+    for (size_t cut : cuts)
+    {
+        units.sources.push_back("#include \"" + headerName + "\"\n\n");
+        units.sources.back().append(text, start, cut - start);
+        start = cut;
+    }
+
+    return units;
 }
 
-void CodegenC::decreaseIndent()
+
+std::string CodegenC::generateDeclarations() const
 {
-    indentLevel--;
+    CodeSink out;
+    emitPreamble(out, true);
+
+    return out.take();
 }
 
-std::string CodegenC::generateHeader(const Program& program)
+
+// ===== Freestanding Runtime =====
+
+struct SystemCall
 {
-    std::stringstream out;
+    const char* name;
+    int number;
+};
 
-    out << "#pragma once\n\n";
+// x86-64 Linux numbers of the externs a freestanding program may declare
+static const SystemCall SYSTEM_CALLS[] = {
+    { "read", 0 }, { "write", 1 }, { "open", 2 }, { "close", 3 }, { "lseek", 8 },
+    { "getpid", 39 }, { "unlink", 87 }, { "exit", 231 }, { "_exit", 231 },
+};
+
+std::string CodegenC::generateFreestandingRuntime() const
+{
+    CodeSink out;
+
+    out << "\n"
+        << "static inline long azin_syscall(long n, long a, long b, long c, long d, long e, long f) {\n"
+        << "    register long r10 __asm__(\"r10\") = d;\n"
+        << "    register long r8 __asm__(\"r8\") = e;\n"
+        << "    register long r9 __asm__(\"r9\") = f;\n"
+        << "    long ret;\n"
+        << "    __asm__ volatile (\"syscall\" : \"=a\"(ret) : \"a\"(n), \"D\"(a), \"S\"(b), \"d\"(c), \"r\"(r10), \"r\"(r8), \"r\"(r9)\n"
+        << "                      : \"rcx\", \"r11\", \"memory\");\n"
+        << "    return ret;\n"
+        << "}\n\n";
 
     for (const auto& decl : program.decls)
     {
-        if (std::holds_alternative<FunctionDecl>(decl))
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& fn = std::get<FunctionDecl>(decl);
+
+        if (!fn.isExtern)
+            continue;
+
+        const SystemCall* call = nullptr;
+
+        for (const auto& candidate : SYSTEM_CALLS)
         {
-            const auto& fn = std::get<FunctionDecl>(decl);
+            if (fn.name == candidate.name)
+                call = &candidate;
+        }
 
-            if (fn.isExtern)
-                continue;
+        if (!call)
+            throw std::runtime_error("Extern function '" + fn.name + "' has no system call for --freestanding");
+
+        if (fn.params.size() > 6)
+            throw std::runtime_error("Extern function '" + fn.name + "' takes more arguments than a system call");
+
+        bool returns = fn.returnType.base != "nore";
 
-            out << mapTypeToC(fn.returnType)
-                << " "
-                << fn.name
-                << "(";
+        // Errors come back as -errno instead of -1 and errno
+        emitSignature(out, fn);
+        out << " {\n    ";
 
-            for (size_t i = 0; i < fn.params.size(); i++)
-            {
-                const auto& p = fn.params[i];
-                out << mapTypeToC(p.type);
+        if (returns)
+            out << "return (" << mapTypeToC(fn.returnType) << ")";
 
-                if (i + 1 < fn.params.size())
-                    out << ", ";
-            }
+        out << "azin_syscall(" << call->number;
 
-            out << ");\n";
+        for (size_t i = 0; i < 6; i++)
+        {
+            if (i < fn.params.size())
+                out << ", (long)" << fn.params[i].name;
+            else
+                out << ", 0";
         }
+
+        out << ");\n";
+
+        if (!returns && call->number == 231)
+            out << "    __builtin_unreachable();\n";
+
+        out << "}\n\n";
     }
 
-    return out.str();
+    // The kernel enters with the stack 16-byte aligned and no return
+    // address, so _start realigns and calls into C
+    out << "__attribute__((used, noreturn)) static void azin_start(void) {\n"
+        << "    azin_syscall(231, main(), 0, 0, 0, 0, 0);\n"
+        << "    __builtin_unreachable();\n"
+        << "}\n\n"
+        << "__asm__(\".text\\n.global _start\\n_start:\\n\"\n"
+        << "        \"    xor %ebp, %ebp\\n    and $-16, %rsp\\n    call azin_start\\n\");\n";
+
+    return out.take();
 }
 
-std::string CodegenC::mapTypeToC(const Type& type)
+
+void CodegenC::emitBodies(CodeSink& out, std::vector<size_t>* ends) const
 {
-    std::string base;
+    std::vector<const FunctionDecl*> bodies;
 
-    if (type.base == "int")      base = "int";
-    else if (type.base == "nore") base = "void";
-    else if (type.base == "bool") base = "bool";
-    else if (type.base == "char") base = "char";
+    for (const auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl))
+        {
+            const auto& fn = std::get<FunctionDecl>(decl);
 
-    else if (type.base == "i8")   base = "int8_t";
-    else if (type.base == "i16")  base = "int16_t";
-    else if (type.base == "i32")  base = "int32_t";
-    else if (type.base == "i64")  base = "int64_t";
+            if (!fn.isExtern)
+                bodies.push_back(&fn);
+        }
+    }
 
-    else if (type.base == "u8")   base = "uint8_t";
-    else if (type.base == "u16")  base = "uint16_t";
-    else if (type.base == "u32")  base = "uint32_t";
-    else if (type.base == "u64")  base = "uint64_t";
+    unsigned workers = bodies.size() < PARALLEL_MIN_FUNCTIONS ? 1 : options.threads;
 
-    else
-        throw std::runtime_error("Unknown type: " + type.base);
+    if (workers == 1)
+    {
+        for (const FunctionDecl* fn : bodies)
+        {
+            emitFunction(out, *fn);
 
-    for (int i = 0; i < type.pointerDepth; i++)
-        base += "*";
+            if (ends)
+                ends->push_back(out.size());
+        }
+        return;
+    }
 
-    return base;
-}
+    // Each body gets a sink of its own; joining them in declaration order
+    // gives the serial output byte for byte
+    std::vector<std::string> texts(bodies.size());
 
+    parallelFor(bodies.size(), workers, [&](size_t i)
+    {
+        CodeSink sink;
+        emitFunction(sink, *bodies[i]);
+        texts[i] = sink.take();
+    });
 
+    for (auto& text : texts)
+    {
+        out << text;
+        std::string().swap(text);
 
+        if (ends)
+            ends->push_back(out.size());
+    }
+}
 
-// Entry Point
 
-std::string CodegenC::generate(const Program& program)
+void CodegenC::emitPreamble(CodeSink& out, bool internalLinkage) const
 {
-    std::stringstream out;
-
     out << "#include <stdint.h>\n";
     out << "#include <stdbool.h>\n";
 
+    if (options.boundsChecks)
+    {
+        out << "static inline int64_t azin_index(int64_t index, int64_t size) {\n"
+            << "    if ((uint64_t)index >= (uint64_t)size) __builtin_trap();\n"
+            << "    return index;\n"
+            << "}\n";
+    }
+
 
     for (const auto& decl : program.decls)
     {
@@ -120,51 +340,50 @@ std::string CodegenC::generate(const Program& program)
         }
     }
 
+    // Externs and prototypes first, so definitions can appear in any order
     for (const auto& decl : program.decls)
     {
         if (std::holds_alternative<FunctionDecl>(decl))
         {
             const auto& fn = std::get<FunctionDecl>(decl);
-            out << generateFunction(fn);
+
+            if (fn.isExtern)
+                emitFunction(out, fn);
         }
     }
 
-
-    return out.str();
+    emitPrototypes(out, internalLinkage);
 }
 
 
-// Function Generation
-
-std::string CodegenC::generateFunction(const FunctionDecl& fn)
+void CodegenC::emitPrototypes(CodeSink& out, bool internalLinkage) const
 {
-    std::stringstream out;
-
-    if (fn.isExtern)
+    for (const auto& decl : program.decls)
     {
-        std::stringstream out;
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
 
-        out << "extern "
-            << mapTypeToC(fn.returnType)
-            << " "
-            << fn.name
-            << "(";
+        const auto& fn = std::get<FunctionDecl>(decl);
 
-        for (size_t i = 0; i < fn.params.size(); ++i)
-        {
-            const auto& p = fn.params[i];
-            out << mapTypeToC(p.type) << " " << p.name;
+        if (fn.isExtern)
+            continue;
 
-            if (i + 1 < fn.params.size())
-                out << ", ";
-        }
+        if (fn.isCold)
+            out << "__attribute__((cold)) ";
+        else if (fn.isHot)
+            out << "__attribute__((hot)) ";
 
-        out << ");\n";
+        if (internalLinkage && !fn.isExported && fn.name != "main")
+            out << (isTinyLeaf(fn) ? "static inline " : "static ");
 
-        return out.str();
+        emitSignature(out, fn);
+        out << ";\n";
     }
+}
 
 
+void CodegenC::emitSignature(CodeSink& out, const FunctionDecl& fn) const
+{
     out << mapTypeToC(fn.returnType) << " " << fn.name << "(";
 
     for (size_t i = 0; i < fn.params.size(); ++i)
@@ -177,228 +396,295 @@ std::string CodegenC::generateFunction(const FunctionDecl& fn)
             out << ", ";
     }
 
-    out << ") {\n";
+    out << ")";
+}
+
 
+// Function Generation
+
+std::string CodegenC::generateFunction(const FunctionDecl& fn) const
+{
+    CodeSink out;
+    emitFunction(out, fn);
 
-    increaseIndent();
+    return out.take();
+}
 
-    for (const auto& stmt : fn.body->statements)
+void CodegenC::emitFunction(CodeSink& out, const FunctionDecl& fn) const
+{
+    if (fn.isExtern)
     {
-        out << indent() << generateStatement(stmt.get());
+        out << "extern ";
+        emitSignature(out, fn);
+        out << ";\n";
+        return;
     }
 
-    decreaseIndent();
 
-    out << "}\n\n";
+    emitLine(out, fn.span);
+    emitSignature(out, fn);
+    out << " {\n";
+
+    emitBlock(out, fn.body.get(), 1);
 
-    return out.str();
+    out << "}\n\n";
 }
 
 
 // Statement Generation
 
-std::string CodegenC::generateStatement(const Stmt* stmt)
+// Debuggers, profilers and the C compiler's diagnostics then attribute
+// the code that follows to the .az line it came from
+void CodegenC::emitLine(CodeSink& out, const Span& span) const
+{
+    if (!options.lineDirectives || span.startLine <= 0 || span.file.empty())
+        return;
+
+    auto path = sourcePaths.find(span.file);
+    out << lineDirective(span.startLine, path != sourcePaths.end() ? path->second : span.file);
+}
+
+// The statements of a block, one level deeper than the line opening it
+void CodegenC::emitBlock(CodeSink& out, const BlockStmt* block, int indentLevel) const
+{
+    for (const auto& stmt : block->statements)
+    {
+        emitLine(out, stmt->span);
+        out.indent(indentLevel);
+        emitStatement(out, stmt.get(), indentLevel);
+    }
+}
+
+void CodegenC::emitStatement(CodeSink& out, const Stmt* stmt, int indentLevel) const
 {
     if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
     {
         if (!ret->value)
-            return "return;\n";
+        {
+            out << "return;\n";
+            return;
+        }
 
-        return "return " +
-            generateExpression(ret->value.get()) +
-            ";\n";
+        out << "return ";
+        emitExpression(out, ret->value.get());
+        out << ";\n";
+        return;
     }
 
 
     if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
     {
+        out << mapTypeToC(var->type) << " " << var->name;
+
         if (var->isArray)
         {
-            return mapTypeToC(var->type) + " " +
-                var->name + "[" +
-                std::to_string(var->arraySize) +
-                "];\n";
+            out << "[" << var->arraySize << "];\n";
+            return;
         }
 
-        return mapTypeToC(var->type) + " " +
-            var->name + " = " +
-            generateExpression(var->initializer.get()) +
-            ";\n";
+        out << " = ";
+        emitExpression(out, var->initializer.get());
+        out << ";\n";
+        return;
     }
 
     if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
     {
-        return generateExpression(assign->target.get()) +
-            " = " +
-            generateExpression(assign->value.get()) +
-            ";\n";
+        emitExpression(out, assign->target.get());
+        out << " = ";
+        emitExpression(out, assign->value.get());
+        out << ";\n";
+        return;
     }
 
 
     if (auto ifstmt = dynamic_cast<const IfStmt*>(stmt))
     {
-        std::stringstream out;
+        out << "if (";
+        emitExpression(out, ifstmt->condition.get());
+        out << ") {\n";
 
-        out << "if (" 
-            << generateExpression(ifstmt->condition.get())
-            << ") {\n";
+        emitBlock(out, ifstmt->thenBranch.get(), indentLevel + 1);
 
-        increaseIndent();
-
-        for (const auto& s : ifstmt->thenBranch->statements)
-            out << indent() << generateStatement(s.get());
-
-        decreaseIndent();
-
-        out << indent() << "}";
+        out.indent(indentLevel);
+        out << "}";
 
         if (ifstmt->elseBranch)
         {
             out << " else {\n";
-            increaseIndent();
 
-            for (const auto& s : ifstmt->elseBranch->statements)
-                out << indent() << generateStatement(s.get());
+            emitBlock(out, ifstmt->elseBranch.get(), indentLevel + 1);
 
-            decreaseIndent();
-
-            out << indent() << "}";
+            out.indent(indentLevel);
+            out << "}";
         }
 
         out << "\n";
-        return out.str();
+        return;
     }
     if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
     {
-        return generateExpression(exprStmt->expression.get()) + ";\n";
+        emitExpression(out, exprStmt->expression.get());
+        out << ";\n";
+        return;
     }
 
     if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
     {
-        std::stringstream out;
+        out << "while (";
+        emitExpression(out, wh->condition.get());
+        out << ") {\n";
+
+        emitBlock(out, wh->body.get(), indentLevel + 1);
 
-        out << "while ("
-            << generateExpression(wh->condition.get())
-            << ") {\n";
+        out.indent(indentLevel);
+        out << "}\n";
+        return;
+    }
 
-        increaseIndent();
 
-        for (const auto& s : wh->body->statements)
-            out << indent() << generateStatement(s.get());
 
-        decreaseIndent();
+    throw std::runtime_error("Unsupported statement in C codegen");
+}
 
-        out << indent() << "}\n";
 
-        return out.str();
-    }
+// Call Resolution
 
+std::string CodegenC::calleeName(const CallExpr* call)
+{
+    if (!call->resolvedCallee.empty())
+        return call->resolvedCallee;
 
+    if (!call->moduleName.empty())
+        return ModuleLoader::mangledName(call->moduleName, call->callee);
 
-    throw std::runtime_error("Unsupported statement in C codegen");
+    return call->callee;
 }
 
 
 // Expression Generation
 
-std::string CodegenC::generateExpression(const Expr* expr)
+void CodegenC::emitExpression(CodeSink& out, const Expr* expr) const
+{
+    if (expr->convertedType != INVALID_TYPE)
+    {
+        out << "(" << mapTypeToC(expr->convertedType) << ")(";
+        emitValue(out, expr);
+        out << ")";
+        return;
+    }
+
+    emitValue(out, expr);
+}
+
+void CodegenC::emitValue(CodeSink& out, const Expr* expr) const
 {
     if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
     {
-        return "&" + generateExpression(addr->target.get());
+        out << "&";
+        emitExpression(out, addr->target.get());
+        return;
     }
     if (auto deref = dynamic_cast<const DerefExpr*>(expr))
     {
-        return "*" + generateExpression(deref->target.get());
+        out << "*";
+        emitExpression(out, deref->target.get());
+        return;
     }
 
     if (auto cast = dynamic_cast<const CastExpr*>(expr))
     {
-        return "(" + mapTypeToC(cast->targetType) + ")"
-            + generateExpression(cast->expr.get());
+        out << "(";
+
+        if (cast->type != INVALID_TYPE)
+            out << mapTypeToC(cast->type);
+        else
+            out << mapTypeToC(cast->targetType);
+
+        out << ")";
+        emitExpression(out, cast->expr.get());
+        return;
     }
 
     if (auto lit = dynamic_cast<const LiteralExpr*>(expr))
-        return lit->value;
+    {
+        out << lit->value;
+
+        // Too large for a signed type: spell out the unsigned 64-bit type
+        // gcc would otherwise pick with a warning
+        Wide value;
+        CType type;
+
+        if (std::isdigit(static_cast<unsigned char>(lit->value.back())) &&
+            parseLiteral(lit->value, value, type) && type.bits == 64 && !type.isSigned)
+            out << "ULL";
+
+        return;
+    }
 
     if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
     {
-        return "(" + unary->op +
-            generateExpression(unary->operand.get()) +
-            ")";
+        out << "(" << unary->op;
+        emitExpression(out, unary->operand.get());
+        out << ")";
+        return;
     }
 
     if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
     {
-        return "(" +
-               generateExpression(bin->left.get()) +
-               " " + bin->op + " " +
-               generateExpression(bin->right.get()) +
-               ")";
+        out << "(";
+        emitExpression(out, bin->left.get());
+        out << " " << bin->op << " ";
+        emitExpression(out, bin->right.get());
+        out << ")";
+        return;
     }
     if (auto var = dynamic_cast<const VarExpr*>(expr))
     {
-        return var->name;
+        out << var->name;
+        return;
     }
     if (auto call = dynamic_cast<const CallExpr*>(expr))
     {
-        if (call->callee == "out" && call->arguments.size() == 1)
-        {
-            const Expr* arg = call->arguments[0].get();
-
-            if (dynamic_cast<const StringExpr*>(arg))
-            {
-                return "std__out(" + generateExpression(arg) + ")";
-            }
-
-            if (dynamic_cast<const AddressOfExpr*>(arg))
-            {
-                return "std__outPtr((int64_t)" + generateExpression(arg) + ")";
-            }
-            
-            if (dynamic_cast<const LiteralExpr*>(arg))
-            {
-                return "std__outInt(" + generateExpression(arg) + ")";
-            }
-
-            if (dynamic_cast<const VarExpr*>(arg))
-            {
-                return "std__outInt(" + generateExpression(arg) + ")";
-            }
-        }
-        std::stringstream out;
-
-        if (!call->moduleName.empty())
-        {
-            out << call->moduleName << "__";
-        }
-
-        out << call->callee << "(";
+        out << calleeName(call);
 
+        out << "(";
 
         for (size_t i = 0; i < call->arguments.size(); i++)
         {
-            out << generateExpression(call->arguments[i].get());
+            emitExpression(out, call->arguments[i].get());
             if (i + 1 < call->arguments.size())
                 out << ", ";
         }
 
         out << ")";
-
-        return out.str();
+        return;
     }
 
     if (auto str = dynamic_cast<const StringExpr*>(expr))
     {
-        return "\"" + str->value + "\"";
+        out << "\"" << str->value << "\"";
+        return;
     }
 
     if (auto idx = dynamic_cast<const IndexExpr*>(expr))
     {
-        return generateExpression(idx->base.get()) +
-            "[" +
-            generateExpression(idx->index.get()) +
-            "]";
+        emitExpression(out, idx->base.get());
+        out << "[";
+
+        if (options.boundsChecks && idx->arraySize >= 0 && !idx->inBounds)
+        {
+            out << "azin_index(";
+            emitExpression(out, idx->index.get());
+            out << ", " << idx->arraySize << ")";
+        }
+        else
+        {
+            emitExpression(out, idx->index.get());
+        }
+
+        out << "]";
+        return;
     }
 
 
@@ -1,33 +1,92 @@
 #pragma once
 
 #include "ast.hpp"
+#include "codesink.hpp"
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace azin
 {
 
+// One shared prototype header plus N independently compilable C files
+struct CodegenUnits
+{
+    std::string header;
+    std::vector<std::string> sources;
+};
+
+struct CodegenOptions
+{
+    bool boundsChecks = false;   // trap on fixed-array indexes not proven in bounds
+    unsigned threads = 1;        // workers emitting function bodies; 0 = one per core
+    bool lineDirectives = false; // `#line` to the .az source before every function and statement
+};
+
+// Generates the C for one analyzed program.
+//
+// A generator only reads the program, and every function body is emitted
+// with its own indentation state into its own sink, so generators and the
+// bodies of one generator can run on several threads. With more than one
+// worker, bodies are emitted in parallel and joined in declaration order:
+// the output is byte-identical to a serial run.
 class CodegenC
 {
 public:
-    static std::string generate(const Program& program);
+    explicit CodegenC(const Program& program, const CodegenOptions& options = {});
+
+    std::string generate() const;
+
+    // Streams the same C into `out`, which may write straight to a file
+    void generate(CodeSink& out) const;
+
+    CodegenUnits generateUnits(int unitCount, const std::string& headerName) const;
+    std::string generateFunction(const FunctionDecl& fn) const;
+
+    // Includes, externs and prototypes: everything before the first
+    // function body, for back ends that emit the bodies themselves
+    std::string generateDeclarations() const;
+
+    // For builds without the C library (x86-64 Linux): each extern as a
+    // raw system call, and a _start that calls main and exits with what
+    // it returns. Throws for an extern no system call implements.
+    std::string generateFreestandingRuntime() const;
+
+    // C name a call lowers to: the overload semantic analysis picked, or
+    // the module-mangled name before analysis has run
+    static std::string calleeName(const CallExpr* call);
 
 private:
-    // Core generators
-    static std::string generateFunction(const FunctionDecl& fn);
-    static std::string generateStatement(const Stmt* stmt);
-    static std::string generateExpression(const Expr* expr);
-    std::string generateHeader(const Program& program);
+    const Program& program;
+    const TypeTable& types;
+    CodegenOptions options;
+
+    // Absolute path of each source file, for #line: the C then differs
+    // between copies of a program in different directories, and so do
+    // its build cache key and debug info
+    std::unordered_map<std::string, std::string> sourcePaths;
 
-    // Indentation helpers
-    static std::string indent();
-    static void increaseIndent();
-    static void decreaseIndent();
+    // Every non-extern body in declaration order; ends[i] (when given)
+    // is the size of `out` after body i
+    void emitBodies(CodeSink& out, std::vector<size_t>* ends) const;
 
-    // Indentation state
-    static int indentLevel;
+    // Core emitters; each appends its C to `out`. Statements are indented
+    // by the level of the block they are in.
+    void emitFunction(CodeSink& out, const FunctionDecl& fn) const;
+    void emitStatement(CodeSink& out, const Stmt* stmt, int indentLevel) const;
+    void emitBlock(CodeSink& out, const BlockStmt* block, int indentLevel) const;
+    void emitExpression(CodeSink& out, const Expr* expr) const;
+    void emitValue(CodeSink& out, const Expr* expr) const;
+    void emitSignature(CodeSink& out, const FunctionDecl& fn) const;
+    // With internalLinkage (everything in one file), functions that are
+    // neither main nor exported are declared static, tiny leaves static
+    // inline, so gcc may inline or drop them
+    void emitPrototypes(CodeSink& out, bool internalLinkage) const;
+    void emitPreamble(CodeSink& out, bool internalLinkage) const;
+    void emitLine(CodeSink& out, const Span& span) const;
 
-    
     static std::string mapTypeToC(const Type& type);
+    const std::string& mapTypeToC(TypeId type) const;
 };
 
 }
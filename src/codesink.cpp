@@ -0,0 +1,83 @@
+#include "codesink.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #include <io.h>
+    #define write _write
+#else
+    #include <unistd.h>
+#endif
+
+namespace azin
+{
+
+CodeSink::CodeSink(int fd)
+    : fd(fd)
+{
+    buffer.reserve(FLUSH_SIZE + FLUSH_SIZE / 4);
+}
+
+CodeSink::~CodeSink()
+{
+    // Best effort; callers that care about errors flush themselves
+    try
+    {
+        flush();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+CodeSink& CodeSink::operator<<(int64_t value)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    return *this << std::string_view(digits, result.ptr - digits);
+}
+
+void CodeSink::indent(int level)
+{
+    buffer.append(static_cast<size_t>(level) * 4, ' ');
+}
+
+std::string CodeSink::take()
+{
+    written += buffer.size();
+
+    std::string text;
+    text.swap(buffer);
+    return text;
+}
+
+void CodeSink::flush()
+{
+    if (fd < 0)
+        return;
+
+    size_t done = 0;
+
+    while (done < buffer.size())
+    {
+        auto count = write(fd, buffer.data() + done, static_cast<unsigned>(buffer.size() - done));
+
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            buffer.clear();
+            throw std::runtime_error("Cannot write generated C");
+        }
+
+        done += static_cast<size_t>(count);
+    }
+
+    written += done;
+    buffer.clear();
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace azin
+{
+
+// Append-only buffer every C emitter writes into. Text is only ever
+// added at the end, so nested constructs never copy what their children
+// produced.
+//
+// A sink either keeps everything in memory (take() hands it over) or
+// streams to a file descriptor, holding at most FLUSH_SIZE bytes before
+// writing them out. flush() must be called once emission is done; write
+// errors throw std::runtime_error.
+class CodeSink
+{
+public:
+    static const size_t FLUSH_SIZE = 64 * 1024;
+
+    CodeSink() = default;
+    explicit CodeSink(int fd);
+    ~CodeSink();
+
+    CodeSink(const CodeSink&) = delete;
+    CodeSink& operator=(const CodeSink&) = delete;
+
+    CodeSink& operator<<(std::string_view text)
+    {
+        buffer.append(text.data(), text.size());
+        if (fd >= 0 && buffer.size() >= FLUSH_SIZE)
+            flush();
+        return *this;
+    }
+
+    CodeSink& operator<<(const char* text) { return *this << std::string_view(text); }
+    CodeSink& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    CodeSink& operator<<(char c) { return *this << std::string_view(&c, 1); }
+
+    CodeSink& operator<<(int64_t value);
+    CodeSink& operator<<(int value) { return *this << static_cast<int64_t>(value); }
+
+    // `level` steps of four spaces
+    void indent(int level);
+
+    // Bytes appended so far, including the ones already written out
+    size_t size() const { return written + buffer.size(); }
+
+    // Memory sinks: everything appended since the last take()
+    std::string take();
+
+    void flush();
+
+private:
+    std::string buffer;
+    int fd = -1;
+    size_t written = 0;
+};
+
+}
@@ -0,0 +1,865 @@
+#include "constfold.hpp"
+#include "cinteger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace azin
+{
+
+// ===== Intervals =====
+
+struct Interval
+{
+    bool known = false;
+    Wide min = 0;
+    Wide max = 0;
+
+    bool isConstant() const { return known && min == max; }
+};
+
+static Interval constant(Wide value)
+{
+    return Interval{ true, value, value };
+}
+
+static Interval fullRange(CType t)
+{
+    return Interval{ true, typeMin(t), typeMax(t) };
+}
+
+static bool fits(const Interval& v, CType t)
+{
+    return v.known && v.min >= typeMin(t) && v.max <= typeMax(t);
+}
+
+static Interval join(const Interval& a, const Interval& b)
+{
+    if (!a.known || !b.known)
+        return Interval{};
+
+    return Interval{ true, std::min(a.min, b.min), std::max(a.max, b.max) };
+}
+
+// C conversion of a value to t: integers wrap, bool tests against zero
+static Interval convertTo(const Interval& v, CType t)
+{
+    if (t.bits == 1)
+    {
+        if (v.known && (v.min > 0 || v.max < 0))
+            return constant(1);
+
+        if (v.isConstant())
+            return constant(0);
+
+        return fullRange(t);
+    }
+
+    if (fits(v, t))
+        return v;
+
+    if (v.isConstant())
+        return constant(wrap(v.min, t));
+
+    return fullRange(t);
+}
+
+// Result of an arithmetic operation computed exactly in Wide. Signed
+// overflow is undefined in C, so a result that might overflow is never
+// folded; unsigned results wrap.
+static Interval arithmeticResult(const Interval& exact, CType t)
+{
+    if (fits(exact, t))
+        return exact;
+
+    if (!t.isSigned && exact.isConstant())
+        return constant(wrap(exact.min, t));
+
+    return fullRange(t);
+}
+
+
+// ===== Folding =====
+
+// What folding learned about one expression
+struct Folded
+{
+    bool isValue = false;   // integer or bool, so range and type are meaningful
+    Interval range;
+    CType type;
+    bool pure = true;       // no calls or memory reads, so it may be dropped
+};
+
+struct FoldContext
+{
+    TypeTable* types = nullptr;
+
+    // Innermost scope last; names map to their VarDeclStmt or Param
+    std::vector<std::unordered_map<std::string, const void*>> scopes;
+
+    std::unordered_map<const void*, CType> variableTypes;   // tracked variables only
+    std::unordered_map<const void*, Interval> values;        // what each holds at this point
+    std::unordered_set<std::string> addressTaken;
+
+    // C type each folded integer expression is evaluated in
+    std::unordered_map<const Expr*, CType> valueTypes;
+
+    FoldStats stats;
+};
+
+static bool cTypeOf(TypeId id, const FoldContext& ctx, CType& out)
+{
+    return id != INVALID_TYPE && cTypeOf(ctx.types->info(id), out);
+}
+
+static const void* resolve(const std::string& name, const FoldContext& ctx)
+{
+    for (auto it = ctx.scopes.rbegin(); it != ctx.scopes.rend(); ++it)
+    {
+        auto found = it->find(name);
+        if (found != it->end())
+            return found->second;
+    }
+
+    return nullptr;
+}
+
+static bool isTracked(const void* decl, const FoldContext& ctx)
+{
+    return decl && ctx.variableTypes.count(decl);
+}
+
+// Variables are tracked when they hold an integer or bool and nothing
+// can write them except a plain assignment
+static void declare(const std::string& name, const void* decl, TypeId type, FoldContext& ctx)
+{
+    ctx.scopes.back()[name] = decl;
+
+    CType t;
+    if (!cTypeOf(type, ctx, t) || ctx.addressTaken.count(name))
+        return;
+
+    ctx.variableTypes[decl] = t;
+    ctx.values[decl] = fullRange(t);
+}
+
+static void assign(const void* decl, const Folded& value, FoldContext& ctx)
+{
+    CType t = ctx.variableTypes[decl];
+    ctx.values[decl] = value.isValue ? convertTo(value.range, t) : fullRange(t);
+}
+
+static Folded foldExpr(std::unique_ptr<Expr>& slot, FoldContext& ctx);
+static Folded foldUse(std::unique_ptr<Expr>& slot, FoldContext& ctx);
+
+static Interval compare(const std::string& op, const Interval& a, const Interval& b)
+{
+    bool always = false;
+    bool never = false;
+
+    bool equal = a.isConstant() && b.isConstant() && a.min == b.min;
+    bool disjoint = a.max < b.min || b.max < a.min;
+
+    if (op == "<")       { always = a.max < b.min;  never = a.min >= b.max; }
+    else if (op == "<=") { always = a.max <= b.min; never = a.min > b.max; }
+    else if (op == ">")  { always = a.min > b.max;  never = a.max <= b.min; }
+    else if (op == ">=") { always = a.min >= b.max; never = a.max < b.min; }
+    else if (op == "==") { always = equal;          never = disjoint; }
+    else if (op == "!=") { always = disjoint;       never = equal; }
+
+    if (always)
+        return constant(1);
+
+    if (never)
+        return constant(0);
+
+    return fullRange(C_BOOL);
+}
+
+static Interval arithmetic(const std::string& op, const Interval& a, const Interval& b, CType t)
+{
+    if (op == "+")
+        return arithmeticResult(Interval{ true, a.min + b.min, a.max + b.max }, t);
+
+    if (op == "-")
+        return arithmeticResult(Interval{ true, a.min - b.max, a.max - b.min }, t);
+
+    if (op == "*")
+    {
+        // Keep the products inside Wide
+        Wide limit = Wide(1) << 63;
+
+        bool small = a.min > -limit && a.max < limit && b.min > -limit && b.max < limit;
+
+        if (!small)
+        {
+            if (!t.isSigned && a.isConstant() && b.isConstant())
+                return constant(static_cast<uint64_t>(a.min) * static_cast<uint64_t>(b.min));
+
+            return fullRange(t);
+        }
+
+        Wide corners[] = { a.min * b.min, a.min * b.max, a.max * b.min, a.max * b.max };
+
+        return arithmeticResult(Interval{ true,
+            *std::min_element(std::begin(corners), std::end(corners)),
+            *std::max_element(std::begin(corners), std::end(corners)) }, t);
+    }
+
+    // Division and remainder only fold with a known, nonzero divisor
+    if (!b.isConstant() || b.min == 0)
+        return fullRange(t);
+
+    Wide d = b.min;
+
+    if (op == "/")
+    {
+        // Truncating division by a constant is monotonic in the dividend
+        if (d > 0)
+            return arithmeticResult(Interval{ true, a.min / d, a.max / d }, t);
+
+        return arithmeticResult(Interval{ true, a.max / d, a.min / d }, t);
+    }
+
+    if (op == "%")
+    {
+        if (a.isConstant())
+            return arithmeticResult(constant(a.min % d), t);
+
+        // The result takes the sign of the dividend and stays below |d|
+        Wide m = (d < 0 ? -d : d) - 1;
+
+        if (a.min >= -m && a.max <= m)
+            return a;
+
+        Wide lo = a.min >= 0 ? 0 : std::max(-m, a.min);
+        Wide hi = a.max <= 0 ? 0 : std::min(m, a.max);
+
+        return Interval{ true, lo, hi };
+    }
+
+    return fullRange(t);
+}
+
+static Folded evaluate(std::unique_ptr<Expr>& slot, FoldContext& ctx)
+{
+    Expr* expr = slot.get();
+    Folded result;
+
+    if (auto lit = dynamic_cast<LiteralExpr*>(expr))
+    {
+        Wide value;
+
+        if (parseLiteral(lit->value, value, result.type))
+        {
+            result.isValue = true;
+            result.range = constant(value);
+        }
+
+        return result;
+    }
+
+    if (auto var = dynamic_cast<VarExpr*>(expr))
+    {
+        const void* decl = resolve(var->name, ctx);
+
+        if (isTracked(decl, ctx))
+        {
+            result.isValue = true;
+            result.type = ctx.variableTypes[decl];
+            result.range = ctx.values[decl];
+        }
+        else if (cTypeOf(var->type, ctx, result.type))
+        {
+            result.isValue = true;
+            result.range = fullRange(result.type);
+        }
+
+        return result;
+    }
+
+    if (auto cast = dynamic_cast<CastExpr*>(expr))
+    {
+        Folded inner = foldExpr(cast->expr, ctx);
+        result.pure = inner.pure;
+
+        if (cTypeOf(cast->type, ctx, result.type))
+        {
+            result.isValue = true;
+            result.range = inner.isValue
+                ? convertTo(inner.range, result.type)
+                : fullRange(result.type);
+        }
+
+        return result;
+    }
+
+    if (auto unary = dynamic_cast<UnaryExpr*>(expr))
+    {
+        Folded operand = foldExpr(unary->operand, ctx);
+        result.pure = operand.pure;
+
+        if (!operand.isValue || unary->op != "-")
+            return result;
+
+        result.isValue = true;
+        result.type = promote(operand.type);
+
+        Interval v = convertTo(operand.range, result.type);
+        result.range = arithmeticResult(Interval{ true, -v.max, -v.min }, result.type);
+
+        return result;
+    }
+
+    if (auto bin = dynamic_cast<BinaryExpr*>(expr))
+    {
+        Folded left = foldExpr(bin->left, ctx);
+        Folded right = foldExpr(bin->right, ctx);
+        result.pure = left.pure && right.pure;
+
+        bool isComparison = bin->op == "==" || bin->op == "!=" ||
+                            bin->op == "<"  || bin->op == ">"  ||
+                            bin->op == "<=" || bin->op == ">=";
+
+        if (!left.isValue || !right.isValue)
+        {
+            // Pointer arithmetic and comparisons are left alone
+            if (isComparison)
+            {
+                result.isValue = true;
+                result.type = C_INT;
+                result.range = fullRange(C_BOOL);
+            }
+
+            return result;
+        }
+
+        CType common = commonType(left.type, right.type);
+        Interval a = convertTo(left.range, common);
+        Interval b = convertTo(right.range, common);
+
+        result.isValue = true;
+
+        if (isComparison)
+        {
+            result.type = C_INT;
+            result.range = compare(bin->op, a, b);
+        }
+        else
+        {
+            result.type = common;
+            result.range = arithmetic(bin->op, a, b, common);
+        }
+
+        return result;
+    }
+
+    if (auto call = dynamic_cast<CallExpr*>(expr))
+    {
+        for (auto& arg : call->arguments)
+            foldUse(arg, ctx);
+
+        result.pure = false;
+    }
+    else if (auto index = dynamic_cast<IndexExpr*>(expr))
+    {
+        if (!dynamic_cast<VarExpr*>(index->base.get()))
+            foldExpr(index->base, ctx);
+
+        Folded position = foldExpr(index->index, ctx);
+        result.pure = false;
+
+        if (index->arraySize >= 0)
+        {
+            ctx.stats.arrayAccesses++;
+
+            index->inBounds = position.isValue && position.range.known &&
+                              position.range.min >= 0 && position.range.max < index->arraySize;
+
+            if (index->inBounds)
+                ctx.stats.accessesInBounds++;
+        }
+    }
+    else if (auto deref = dynamic_cast<DerefExpr*>(expr))
+    {
+        foldExpr(deref->target, ctx);
+        result.pure = false;
+    }
+    else if (auto addr = dynamic_cast<AddressOfExpr*>(expr))
+    {
+        // The operand is a place, not a value
+        if (!dynamic_cast<VarExpr*>(addr->target.get()))
+            foldExpr(addr->target, ctx);
+
+        return result;
+    }
+    else
+    {
+        return result;
+    }
+
+    // Calls and memory reads: any value of their type
+    if (cTypeOf(expr->type, ctx, result.type))
+    {
+        result.isValue = true;
+        result.range = fullRange(result.type);
+    }
+
+    return result;
+}
+
+static bool replaceWithLiteral(std::unique_ptr<Expr>& slot, const Folded& result,
+                               TypeId cast, FoldContext& ctx)
+{
+    CType declared;
+    bool isBool = cTypeOf(slot->type, ctx, declared) && declared.bits == 1;
+
+    std::string text = literalText(result.range.min, result.type, isBool);
+    if (text.empty())
+        return false;
+
+    if (dynamic_cast<VarExpr*>(slot.get()))
+        ctx.stats.variablesPropagated++;
+    else
+        ctx.stats.expressionsFolded++;
+
+    auto literal = std::make_unique<LiteralExpr>(text);
+    literal->span = slot->span;
+    literal->type = slot->type;
+    literal->convertedType = cast;
+    slot = std::move(literal);
+
+    return true;
+}
+
+static bool isFoldable(const std::unique_ptr<Expr>& slot, const Folded& result)
+{
+    return result.isValue && result.pure && result.range.isConstant() &&
+           !dynamic_cast<LiteralExpr*>(slot.get());
+}
+
+// Folds the expression in `slot`, replacing it with a literal when it can
+// only have one value, and records its range
+static Folded foldExpr(std::unique_ptr<Expr>& slot, FoldContext& ctx)
+{
+    if (!slot)
+        return Folded{};
+
+    Folded result = evaluate(slot, ctx);
+
+    if (isFoldable(slot, result))
+    {
+        CType target;
+
+        if (cTypeOf(slot->convertedType, ctx, target))
+        {
+            // The cast is only needed when the constant changes
+            bool keepCast = !fits(result.range, target);
+            replaceWithLiteral(slot, result, keepCast ? slot->convertedType : INVALID_TYPE, ctx);
+        }
+        else if (!cTypeOf(slot->type, ctx, target) || fits(result.range, target))
+        {
+            // A constant C would convert implicitly must fit, or gcc starts
+            // warning about code the user never wrote; see foldUse
+            replaceWithLiteral(slot, result, INVALID_TYPE, ctx);
+        }
+    }
+
+    if (result.isValue)
+        ctx.valueTypes[slot.get()] = result.type;
+
+    if (result.isValue && result.range.known &&
+        result.range.min >= INT64_MIN && result.range.max <= INT64_MAX)
+    {
+        slot->range.known = true;
+        slot->range.min = static_cast<int64_t>(result.range.min);
+        slot->range.max = static_cast<int64_t>(result.range.max);
+    }
+
+    return result;
+}
+
+// Folds a value that C converts to its own Azin type where it is used
+// (initializers, assigned values, arguments, return values). A constant
+// that does not fit is folded anyway, with the conversion spelled out.
+static Folded foldUse(std::unique_ptr<Expr>& slot, FoldContext& ctx)
+{
+    Folded result = foldExpr(slot, ctx);
+
+    if (slot && isFoldable(slot, result))
+        replaceWithLiteral(slot, result, slot->type, ctx);
+
+    return result;
+}
+
+
+// ===== Statements =====
+
+static void collectAddressTaken(const Expr* expr, std::unordered_set<std::string>& out);
+static void collectAddressTaken(const BlockStmt* block, std::unordered_set<std::string>& out);
+
+static void collectAddressTaken(const Stmt* stmt, std::unordered_set<std::string>& out)
+{
+    if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+        collectAddressTaken(var->initializer.get(), out);
+    else if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        collectAddressTaken(assign->target.get(), out);
+        collectAddressTaken(assign->value.get(), out);
+    }
+    else if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+        collectAddressTaken(ret->value.get(), out);
+    else if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+        collectAddressTaken(exprStmt->expression.get(), out);
+    else if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        collectAddressTaken(ifs->condition.get(), out);
+        collectAddressTaken(ifs->thenBranch.get(), out);
+        collectAddressTaken(ifs->elseBranch.get(), out);
+    }
+    else if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        collectAddressTaken(wh->condition.get(), out);
+        collectAddressTaken(wh->body.get(), out);
+    }
+}
+
+static void collectAddressTaken(const BlockStmt* block, std::unordered_set<std::string>& out)
+{
+    if (!block) return;
+
+    for (const auto& stmt : block->statements)
+        collectAddressTaken(stmt.get(), out);
+}
+
+static void collectAddressTaken(const Expr* expr, std::unordered_set<std::string>& out)
+{
+    if (!expr) return;
+
+    if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
+    {
+        if (auto var = dynamic_cast<const VarExpr*>(addr->target.get()))
+            out.insert(var->name);
+        else
+            collectAddressTaken(addr->target.get(), out);
+    }
+    else if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+    {
+        collectAddressTaken(bin->left.get(), out);
+        collectAddressTaken(bin->right.get(), out);
+    }
+    else if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
+        collectAddressTaken(unary->operand.get(), out);
+    else if (auto cast = dynamic_cast<const CastExpr*>(expr))
+        collectAddressTaken(cast->expr.get(), out);
+    else if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        collectAddressTaken(deref->target.get(), out);
+    else if (auto index = dynamic_cast<const IndexExpr*>(expr))
+    {
+        collectAddressTaken(index->base.get(), out);
+        collectAddressTaken(index->index.get(), out);
+    }
+    else if (auto call = dynamic_cast<const CallExpr*>(expr))
+    {
+        for (const auto& arg : call->arguments)
+            collectAddressTaken(arg.get(), out);
+    }
+}
+
+// How a loop changes a variable
+enum class Step
+{
+    Up,     // only ever `x = x + c` with a constant c >= 0
+    Down,   // only ever `x = x - c`
+    Any
+};
+
+static Step stepOf(const std::string& name, const Expr* value)
+{
+    auto bin = dynamic_cast<const BinaryExpr*>(value);
+    if (!bin || (bin->op != "+" && bin->op != "-"))
+        return Step::Any;
+
+    const Expr* self = bin->left.get();
+    const Expr* amount = bin->right.get();
+
+    if (bin->op == "+" && dynamic_cast<const LiteralExpr*>(self))
+        std::swap(self, amount);
+
+    auto var = dynamic_cast<const VarExpr*>(self);
+    auto lit = dynamic_cast<const LiteralExpr*>(amount);
+
+    Wide step;
+    CType type;
+
+    if (!var || var->name != name || !lit || !parseLiteral(lit->value, step, type) || step < 0)
+        return Step::Any;
+
+    return bin->op == "+" ? Step::Up : Step::Down;
+}
+
+// Every variable assigned inside a loop, with how it moves
+static void collectSteps(const BlockStmt* block, std::unordered_map<std::string, Step>& out)
+{
+    if (!block) return;
+
+    for (const auto& stmt : block->statements)
+    {
+        if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt.get()))
+        {
+            if (auto var = dynamic_cast<const VarExpr*>(assign->target.get()))
+            {
+                Step step = stepOf(var->name, assign->value.get());
+                auto it = out.find(var->name);
+
+                if (it == out.end())
+                    out[var->name] = step;
+                else if (it->second != step)
+                    it->second = Step::Any;
+            }
+        }
+        else if (auto ifs = dynamic_cast<const IfStmt*>(stmt.get()))
+        {
+            collectSteps(ifs->thenBranch.get(), out);
+            collectSteps(ifs->elseBranch.get(), out);
+        }
+        else if (auto wh = dynamic_cast<const WhileStmt*>(stmt.get()))
+        {
+            collectSteps(wh->body.get(), out);
+        }
+    }
+}
+
+static std::string negatedComparison(const std::string& op)
+{
+    if (op == "<")  return ">=";
+    if (op == "<=") return ">";
+    if (op == ">")  return "<=";
+    if (op == ">=") return "<";
+    if (op == "==") return "!=";
+    if (op == "!=") return "==";
+    return "";
+}
+
+static std::string mirroredComparison(const std::string& op)
+{
+    if (op == "<")  return ">";
+    if (op == "<=") return ">=";
+    if (op == ">")  return "<";
+    if (op == ">=") return "<=";
+    return op;
+}
+
+// Narrows a variable known to satisfy `side op other`
+static void refineVariable(const Expr* side, const std::string& op, const Expr* other,
+                           FoldContext& ctx)
+{
+    auto var = dynamic_cast<const VarExpr*>(side);
+    auto otherType = ctx.valueTypes.find(other);
+
+    if (!var || !other->range.known || otherType == ctx.valueTypes.end())
+        return;
+
+    const void* decl = resolve(var->name, ctx);
+    if (!isTracked(decl, ctx))
+        return;
+
+    Interval v = ctx.values[decl];
+    Interval e{ true, other->range.min, other->range.max };
+
+    // Only where the comparison in C's common type is the plain one
+    CType common = commonType(ctx.variableTypes[decl], otherType->second);
+    if (!fits(v, common) || !fits(e, common))
+        return;
+
+    if (op == "<")       v.max = std::min(v.max, e.max - 1);
+    else if (op == "<=") v.max = std::min(v.max, e.max);
+    else if (op == ">")  v.min = std::max(v.min, e.min + 1);
+    else if (op == ">=") v.min = std::max(v.min, e.min);
+    else if (op == "==") { v.min = std::max(v.min, e.min); v.max = std::min(v.max, e.max); }
+
+    // An empty range means the branch never runs; nothing to learn
+    if (v.min <= v.max)
+        ctx.values[decl] = v;
+}
+
+// Narrows the variables a condition compares, on the side where it is `holds`
+static void refine(const Expr* cond, bool holds, FoldContext& ctx)
+{
+    auto bin = dynamic_cast<const BinaryExpr*>(cond);
+    if (!bin || negatedComparison(bin->op).empty())
+        return;
+
+    std::string op = holds ? bin->op : negatedComparison(bin->op);
+
+    refineVariable(bin->left.get(), op, bin->right.get(), ctx);
+    refineVariable(bin->right.get(), mirroredComparison(op), bin->left.get(), ctx);
+}
+
+static void foldBlock(BlockStmt* block, FoldContext& ctx);
+
+static void foldStmt(Stmt* stmt, FoldContext& ctx)
+{
+    if (auto var = dynamic_cast<VarDeclStmt*>(stmt))
+    {
+        if (var->isArray)
+        {
+            ctx.scopes.back()[var->name] = var;
+            return;
+        }
+
+        Folded init = foldUse(var->initializer, ctx);
+        declare(var->name, var, ctx.types->intern(var->type), ctx);
+
+        if (isTracked(var, ctx))
+            assign(var, init, ctx);
+    }
+    else if (auto assignment = dynamic_cast<AssignmentStmt*>(stmt))
+    {
+        Folded value = foldUse(assignment->value, ctx);
+
+        if (auto target = dynamic_cast<VarExpr*>(assignment->target.get()))
+        {
+            const void* decl = resolve(target->name, ctx);
+
+            if (isTracked(decl, ctx))
+                assign(decl, value, ctx);
+        }
+        else if (dynamic_cast<IndexExpr*>(assignment->target.get()))
+        {
+            // Never replaced (it reads memory), but its index is folded and checked
+            foldExpr(assignment->target, ctx);
+        }
+        else if (auto deref = dynamic_cast<DerefExpr*>(assignment->target.get()))
+        {
+            foldExpr(deref->target, ctx);
+        }
+    }
+    else if (auto ret = dynamic_cast<ReturnStmt*>(stmt))
+    {
+        foldUse(ret->value, ctx);
+    }
+    else if (auto exprStmt = dynamic_cast<ExpressionStmt*>(stmt))
+    {
+        foldExpr(exprStmt->expression, ctx);
+    }
+    else if (auto ifs = dynamic_cast<IfStmt*>(stmt))
+    {
+        Folded cond = foldExpr(ifs->condition, ctx);
+        auto before = ctx.values;
+
+        refine(ifs->condition.get(), true, ctx);
+        foldBlock(ifs->thenBranch.get(), ctx);
+        auto afterThen = std::move(ctx.values);
+
+        ctx.values = before;
+        refine(ifs->condition.get(), false, ctx);
+        foldBlock(ifs->elseBranch.get(), ctx);
+        auto afterElse = std::move(ctx.values);
+
+        if (cond.isValue && cond.range.isConstant())
+        {
+            ctx.values = cond.range.min ? std::move(afterThen) : std::move(afterElse);
+            return;
+        }
+
+        // Either branch may have run
+        ctx.values = std::move(before);
+
+        for (auto& [decl, value] : ctx.values)
+            value = join(afterThen[decl], afterElse[decl]);
+    }
+    else if (auto wh = dynamic_cast<WhileStmt*>(stmt))
+    {
+        // At the loop head, a variable the loop counts up is still at least
+        // its start value (signed overflow is undefined, so it never wraps);
+        // anything else the loop assigns may hold any value
+        std::unordered_map<std::string, Step> steps;
+        collectSteps(wh->body.get(), steps);
+
+        for (const auto& [name, step] : steps)
+        {
+            const void* decl = resolve(name, ctx);
+            if (!isTracked(decl, ctx))
+                continue;
+
+            CType t = ctx.variableTypes[decl];
+            Interval& value = ctx.values[decl];
+
+            bool monotonic = t.isSigned && t.bits >= 32 && value.known;
+
+            if (monotonic && step == Step::Up)
+                value.max = typeMax(t);
+            else if (monotonic && step == Step::Down)
+                value.min = typeMin(t);
+            else
+                value = fullRange(t);
+        }
+
+        foldExpr(wh->condition, ctx);
+
+        auto head = ctx.values;
+
+        refine(wh->condition.get(), true, ctx);
+        foldBlock(wh->body.get(), ctx);
+
+        // The loop only exits from its head, once the condition fails
+        ctx.values = std::move(head);
+        refine(wh->condition.get(), false, ctx);
+    }
+}
+
+static void foldBlock(BlockStmt* block, FoldContext& ctx)
+{
+    if (!block) return;
+
+    ctx.scopes.emplace_back();
+
+    for (auto& stmt : block->statements)
+        foldStmt(stmt.get(), ctx);
+
+    ctx.scopes.pop_back();
+}
+
+FoldStats foldConstants(Program& program)
+{
+    FoldStats stats;
+
+    for (auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        auto& fn = std::get<FunctionDecl>(decl);
+
+        if (fn.isExtern)
+            continue;
+
+        FoldContext ctx;
+        ctx.types = &program.types;
+
+        collectAddressTaken(fn.body.get(), ctx.addressTaken);
+
+        ctx.scopes.emplace_back();
+
+        for (auto& param : fn.params)
+            declare(param.name, &param, program.types.intern(param.type), ctx);
+
+        foldBlock(fn.body.get(), ctx);
+
+        stats.expressionsFolded += ctx.stats.expressionsFolded;
+        stats.variablesPropagated += ctx.stats.variablesPropagated;
+        stats.arrayAccesses += ctx.stats.arrayAccesses;
+        stats.accessesInBounds += ctx.stats.accessesInBounds;
+    }
+
+    return stats;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstddef>
+
+namespace azin
+{
+
+struct FoldStats
+{
+    size_t expressionsFolded = 0;     // expressions replaced by a literal
+    size_t variablesPropagated = 0;   // variable uses replaced by their known value
+    size_t arrayAccesses = 0;         // indexes into fixed-size arrays
+    size_t accessesInBounds = 0;      // of those, proven in bounds
+};
+
+// Evaluates integer and bool expressions at compile time with the exact
+// semantics of the generated C (promotion to int, usual arithmetic
+// conversions, wraparound per width) and replaces those with a single
+// possible value by a literal. Variable values are followed through
+// straight-line code, joined after if/else and forgotten across loops,
+// so `i = i + 1` chains after a constant initializer fold too. Branch
+// and loop conditions narrow the variables they compare, and variables a
+// loop only counts up (or down) keep their start as a bound, which proves
+// most loop indexes into fixed arrays in bounds (IndexExpr::inBounds).
+//
+// Every integer expression keeps the range it was proven to lie in
+// (Expr::range) for later checks. Needs the types SemanticAnalyzer
+// stores on the AST.
+FoldStats foldConstants(Program& program);
+
+}
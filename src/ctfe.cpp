@@ -0,0 +1,971 @@
+#include "ctfe.hpp"
+#include "cinteger.hpp"
+#include "module.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace azin
+{
+
+// ===== Limits =====
+
+// Statements and expressions one call site may run before it is left
+// for run time, and the same across the whole program
+static const size_t STEPS_PER_CALL = 100000;
+static const size_t STEPS_TOTAL = 10000000;
+
+static const int MAX_CALL_DEPTH = 256;
+static const size_t MAX_MEMORY = 1 << 20;   // bytes of arrays and strings per call site
+
+static const CType C_CHAR{ 8, true };
+static const CType C_PTRDIFF{ 64, true };
+
+
+// ===== Purity =====
+
+static std::string calleeName(const CallExpr* call)
+{
+    if (!call->resolvedCallee.empty())
+        return call->resolvedCallee;
+
+    if (!call->moduleName.empty())
+        return ModuleLoader::mangledName(call->moduleName, call->callee);
+
+    return call->callee;
+}
+
+struct Effects
+{
+    std::unordered_set<std::string> callees;
+    std::unordered_set<std::string> localArrays;
+    bool writesMemory = false;   // through a pointer or a parameter
+};
+
+static void collectEffects(const Expr* expr, Effects& out)
+{
+    if (!expr) return;
+
+    if (auto call = dynamic_cast<const CallExpr*>(expr))
+    {
+        out.callees.insert(calleeName(call));
+
+        for (const auto& arg : call->arguments)
+            collectEffects(arg.get(), out);
+    }
+    else if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+    {
+        collectEffects(bin->left.get(), out);
+        collectEffects(bin->right.get(), out);
+    }
+    else if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
+        collectEffects(unary->operand.get(), out);
+    else if (auto cast = dynamic_cast<const CastExpr*>(expr))
+        collectEffects(cast->expr.get(), out);
+    else if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        collectEffects(deref->target.get(), out);
+    else if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
+        collectEffects(addr->target.get(), out);
+    else if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+    {
+        collectEffects(idx->base.get(), out);
+        collectEffects(idx->index.get(), out);
+    }
+}
+
+static void collectEffects(const BlockStmt* block, Effects& out);
+
+static void collectEffects(const Stmt* stmt, Effects& out)
+{
+    if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+        collectEffects(exprStmt->expression.get(), out);
+    else if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+    {
+        if (var->isArray)
+            out.localArrays.insert(var->name);
+
+        collectEffects(var->initializer.get(), out);
+    }
+    else if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+        collectEffects(ret->value.get(), out);
+    else if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        // Writes into the function's own arrays stay inside the call;
+        // anything else may be memory the caller sees
+        if (auto idx = dynamic_cast<const IndexExpr*>(assign->target.get()))
+        {
+            auto base = dynamic_cast<const VarExpr*>(idx->base.get());
+
+            if (!base || !out.localArrays.count(base->name))
+                out.writesMemory = true;
+        }
+        else if (dynamic_cast<const DerefExpr*>(assign->target.get()))
+            out.writesMemory = true;
+
+        collectEffects(assign->target.get(), out);
+        collectEffects(assign->value.get(), out);
+    }
+    else if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        collectEffects(ifs->condition.get(), out);
+        collectEffects(ifs->thenBranch.get(), out);
+        collectEffects(ifs->elseBranch.get(), out);
+    }
+    else if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        collectEffects(wh->condition.get(), out);
+        collectEffects(wh->body.get(), out);
+    }
+    else if (auto block = dynamic_cast<const BlockStmt*>(stmt))
+        collectEffects(block, out);
+}
+
+static void collectEffects(const BlockStmt* block, Effects& out)
+{
+    if (!block) return;
+
+    for (const auto& stmt : block->statements)
+        collectEffects(stmt.get(), out);
+}
+
+// Names of the pure functions: start from every function with a body and
+// drop those with effects of their own or calls to impure ones until
+// nothing changes
+static std::unordered_set<std::string> findPureFunctions(
+    const std::unordered_map<std::string, const FunctionDecl*>& functions)
+{
+    std::unordered_map<std::string, Effects> effects;
+    std::unordered_set<std::string> pure;
+
+    for (const auto& [name, fn] : functions)
+    {
+        if (fn->isExtern || name == "main")
+            continue;
+
+        Effects& e = effects[name];
+        collectEffects(fn->body.get(), e);
+
+        // An array named like a parameter could make a write through the
+        // parameter look local
+        for (const auto& param : fn->params)
+        {
+            if (e.localArrays.count(param.name))
+                e.writesMemory = true;
+        }
+
+        if (!e.writesMemory)
+            pure.insert(name);
+    }
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (auto it = pure.begin(); it != pure.end();)
+        {
+            bool callsImpure = false;
+
+            for (const auto& callee : effects[*it].callees)
+            {
+                if (!pure.count(callee))
+                {
+                    callsImpure = true;
+                    break;
+                }
+            }
+
+            if (callsImpure)
+            {
+                it = pure.erase(it);
+                changed = true;
+            }
+            else
+                ++it;
+        }
+    }
+
+    return pure;
+}
+
+
+// ===== Interpreter =====
+
+// Thrown to give up on the call being evaluated
+struct Abandon {};
+
+struct Value
+{
+    bool isPointer = false;
+
+    Wide value = 0;         // integers, in the range of type
+    CType type;
+
+    size_t object = 0;      // pointers: the object and byte offset into it
+    Wide offset = 0;
+};
+
+// Memory a pointer can point into: a local char array or a string literal
+struct Object
+{
+    std::vector<signed char> bytes;
+    std::vector<bool> defined;
+    bool writable = true;
+};
+
+struct Variable
+{
+    TypeId type = INVALID_TYPE;
+    Value value;
+    bool defined = false;
+    bool isArray = false;
+};
+
+bool decodeString(const std::string& text, std::string& out)
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] != '\\')
+        {
+            out += text[i];
+            continue;
+        }
+
+        if (++i >= text.size())
+            return false;
+
+        switch (text[i])
+        {
+            case 'n':  out += '\n'; break;
+            case 't':  out += '\t'; break;
+            case 'r':  out += '\r'; break;
+            case '\\': out += '\\'; break;
+            case '\'': out += '\''; break;
+            case '"':  out += '"';  break;
+            case '0':
+                // \0 followed by more digits is a longer octal escape
+                if (i + 1 < text.size() && text[i + 1] >= '0' && text[i + 1] <= '7')
+                    return false;
+                out += '\0';
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+class Interpreter
+{
+public:
+    Interpreter(TypeTable& types,
+                const std::unordered_map<std::string, const FunctionDecl*>& functions,
+                const std::unordered_set<std::string>& pure,
+                size_t& totalSteps)
+        : types(types), functions(functions), pure(pure), totalSteps(totalSteps) {}
+
+    Value evaluate(const Expr* expr);
+    Value call(const FunctionDecl& fn, const std::vector<Value>& args);
+
+private:
+    enum class Flow { Next, Return };
+
+    TypeTable& types;
+    const std::unordered_map<std::string, const FunctionDecl*>& functions;
+    const std::unordered_set<std::string>& pure;
+    size_t& totalSteps;
+
+    size_t steps = 0;
+    int depth = 0;
+    size_t memory = 0;
+
+    std::vector<Object> objects;
+    std::unordered_map<const StringExpr*, size_t> strings;
+
+    // Scopes of the running call, innermost last
+    std::vector<std::unordered_map<std::string, Variable>> scopes;
+
+    TypeId returnType = INVALID_TYPE;
+    Value returned;
+    bool hasReturned = false;
+
+    void step();
+
+    size_t allocate(size_t size, bool writable);
+    Variable& lookup(const std::string& name);
+    bool isBytePointer(TypeId id) const;
+
+    Value integer(Wide value, CType type) const;
+    Value convert(const Value& v, TypeId to) const;
+    Value arithmetic(const std::string& op, const Value& a, const Value& b) const;
+    Value pointerArithmetic(const std::string& op, const Value& a, const Value& b) const;
+
+    Object& objectAt(const Value& pointer, Wide index);
+    Value load(const Value& pointer, Wide index);
+    void store(const Value& pointer, Wide index, const Value& v);
+
+    Value compute(const Expr* expr);
+    Wide toInteger(const Value& v) const;
+    bool isTrue(const Value& v) const;
+
+    Flow execute(const Stmt* stmt);
+    Flow execute(const BlockStmt* block);
+};
+
+void Interpreter::step()
+{
+    if (++steps > STEPS_PER_CALL || ++totalSteps > STEPS_TOTAL)
+        throw Abandon{};
+}
+
+size_t Interpreter::allocate(size_t size, bool writable)
+{
+    memory += size;
+    if (memory > MAX_MEMORY)
+        throw Abandon{};
+
+    Object object;
+    object.bytes.resize(size);
+    object.defined.resize(size, !writable);
+    object.writable = writable;
+
+    objects.push_back(std::move(object));
+    return objects.size() - 1;
+}
+
+Variable& Interpreter::lookup(const std::string& name)
+{
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+    {
+        auto found = it->find(name);
+        if (found != it->end())
+            return found->second;
+    }
+
+    throw Abandon{};
+}
+
+// The only pointers the interpreter follows: char* and char arrays
+bool Interpreter::isBytePointer(TypeId id) const
+{
+    const TypeInfo& info = types.info(id);
+
+    return info.base == BaseKind::Char &&
+           ((info.isPointer && info.pointerDepth == 1 && !info.isArray) ||
+            (info.isArray && info.pointerDepth == 0));
+}
+
+Value Interpreter::integer(Wide value, CType type) const
+{
+    Value v;
+    v.value = value;
+    v.type = type;
+    return v;
+}
+
+Value Interpreter::convert(const Value& v, TypeId to) const
+{
+    CType t;
+
+    if (cTypeOf(types.info(to), t))
+    {
+        if (v.isPointer)
+            throw Abandon{};
+
+        if (t.bits == 1)
+            return integer(v.value != 0, t);
+
+        return integer(wrap(v.value, t), t);
+    }
+
+    if (v.isPointer && isBytePointer(to))
+        return v;
+
+    throw Abandon{};
+}
+
+// Integer arithmetic and comparison after the usual arithmetic
+// conversions; signed overflow and division by zero are undefined
+Value Interpreter::arithmetic(const std::string& op, const Value& a, const Value& b) const
+{
+    CType t = commonType(a.type, b.type);
+    Wide x = wrap(a.value, t);
+    Wide y = wrap(b.value, t);
+
+    if (op == "==") return integer(x == y, C_INT);
+    if (op == "!=") return integer(x != y, C_INT);
+    if (op == "<")  return integer(x < y, C_INT);
+    if (op == "<=") return integer(x <= y, C_INT);
+    if (op == ">")  return integer(x > y, C_INT);
+    if (op == ">=") return integer(x >= y, C_INT);
+
+    Wide result;
+
+    if (op == "+")
+        result = x + y;
+    else if (op == "-")
+        result = x - y;
+    else if (op == "*")
+    {
+        // Two 64-bit unsigned factors can overflow Wide, so multiply
+        // those as unsigned 128-bit and let wrap() reduce the product
+        using Unsigned = unsigned __int128;
+
+        if (t.isSigned)
+            result = x * y;
+        else
+            result = static_cast<Wide>((static_cast<Unsigned>(x) * static_cast<Unsigned>(y)) &
+                                       static_cast<Unsigned>(typeMax(t)));
+    }
+    else if (op == "/" || op == "%")
+    {
+        if (y == 0)
+            throw Abandon{};
+
+        result = op == "/" ? x / y : x % y;
+    }
+    else
+        throw Abandon{};
+
+    if (!t.isSigned)
+        return integer(wrap(result, t), t);
+
+    if (result < typeMin(t) || result > typeMax(t))
+        throw Abandon{};
+
+    return integer(result, t);
+}
+
+Value Interpreter::pointerArithmetic(const std::string& op, const Value& a, const Value& b) const
+{
+    if (a.isPointer && b.isPointer)
+    {
+        // Only pointers into the same object can be compared or subtracted
+        if (a.object != b.object)
+            throw Abandon{};
+
+        if (op == "-")
+            return integer(a.offset - b.offset, C_PTRDIFF);
+
+        return arithmetic(op, integer(a.offset, C_PTRDIFF), integer(b.offset, C_PTRDIFF));
+    }
+
+    if (!a.isPointer || (op != "+" && op != "-"))
+        throw Abandon{};
+
+    Value result = a;
+    result.offset = op == "+" ? a.offset + b.value : a.offset - b.value;
+
+    // One past the end is the furthest a pointer may go
+    if (result.offset < 0 || result.offset > static_cast<Wide>(objects[a.object].bytes.size()))
+        throw Abandon{};
+
+    return result;
+}
+
+Object& Interpreter::objectAt(const Value& pointer, Wide index)
+{
+    if (!pointer.isPointer)
+        throw Abandon{};
+
+    Object& object = objects[pointer.object];
+    Wide at = pointer.offset + index;
+
+    if (at < 0 || at >= static_cast<Wide>(object.bytes.size()))
+        throw Abandon{};
+
+    return object;
+}
+
+Value Interpreter::load(const Value& pointer, Wide index)
+{
+    Object& object = objectAt(pointer, index);
+    size_t at = static_cast<size_t>(pointer.offset + index);
+
+    if (!object.defined[at])
+        throw Abandon{};
+
+    return integer(object.bytes[at], C_CHAR);
+}
+
+void Interpreter::store(const Value& pointer, Wide index, const Value& v)
+{
+    Object& object = objectAt(pointer, index);
+    size_t at = static_cast<size_t>(pointer.offset + index);
+
+    if (!object.writable || v.isPointer)
+        throw Abandon{};
+
+    object.bytes[at] = static_cast<signed char>(wrap(v.value, C_CHAR));
+    object.defined[at] = true;
+}
+
+Wide Interpreter::toInteger(const Value& v) const
+{
+    if (v.isPointer)
+        throw Abandon{};
+
+    return v.value;
+}
+
+bool Interpreter::isTrue(const Value& v) const
+{
+    // Every pointer the interpreter makes points into an object
+    return v.isPointer || v.value != 0;
+}
+
+// Value of the expression where it is used, implicit conversion included
+Value Interpreter::evaluate(const Expr* expr)
+{
+    Value v = compute(expr);
+
+    if (expr->convertedType != INVALID_TYPE)
+        return convert(v, expr->convertedType);
+
+    return v;
+}
+
+Value Interpreter::compute(const Expr* expr)
+{
+    step();
+
+    if (auto lit = dynamic_cast<const LiteralExpr*>(expr))
+    {
+        Value v;
+
+        if (!parseLiteral(lit->value, v.value, v.type))
+            throw Abandon{};
+
+        return v;
+    }
+
+    if (auto str = dynamic_cast<const StringExpr*>(expr))
+    {
+        auto found = strings.find(str);
+
+        if (found == strings.end())
+        {
+            std::string bytes;
+            if (!decodeString(str->value, bytes))
+                throw Abandon{};
+
+            size_t object = allocate(bytes.size() + 1, false);
+            for (size_t i = 0; i < bytes.size(); i++)
+                objects[object].bytes[i] = static_cast<signed char>(bytes[i]);
+
+            found = strings.emplace(str, object).first;
+        }
+
+        Value v;
+        v.isPointer = true;
+        v.object = found->second;
+        return v;
+    }
+
+    if (auto var = dynamic_cast<const VarExpr*>(expr))
+    {
+        Variable& variable = lookup(var->name);
+
+        if (!variable.defined)
+            throw Abandon{};
+
+        return variable.value;
+    }
+
+    if (auto cast = dynamic_cast<const CastExpr*>(expr))
+        return convert(evaluate(cast->expr.get()), cast->type);
+
+    if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
+    {
+        Value operand = evaluate(unary->operand.get());
+
+        if (unary->op != "-")
+            throw Abandon{};
+
+        return arithmetic("-", integer(0, promote(operand.type)), operand);
+    }
+
+    if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        return load(evaluate(deref->target.get()), 0);
+
+    if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+    {
+        Value base = evaluate(idx->base.get());
+        return load(base, toInteger(evaluate(idx->index.get())));
+    }
+
+    if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+    {
+        Value a = evaluate(bin->left.get());
+        Value b = evaluate(bin->right.get());
+
+        if (a.isPointer || b.isPointer)
+            return pointerArithmetic(bin->op, a, b);
+
+        return arithmetic(bin->op, a, b);
+    }
+
+    if (auto c = dynamic_cast<const CallExpr*>(expr))
+    {
+        std::string name = calleeName(c);
+        auto fn = functions.find(name);
+
+        if (fn == functions.end() || !pure.count(name))
+            throw Abandon{};
+
+        std::vector<Value> args;
+        for (const auto& arg : c->arguments)
+            args.push_back(evaluate(arg.get()));
+
+        return call(*fn->second, args);
+    }
+
+    // Addresses of variables are not modelled
+    throw Abandon{};
+}
+
+Interpreter::Flow Interpreter::execute(const Stmt* stmt)
+{
+    step();
+
+    if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+    {
+        evaluate(exprStmt->expression.get());
+        return Flow::Next;
+    }
+
+    if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+    {
+        Variable variable;
+
+        if (var->isArray)
+        {
+            if (var->arraySize < 0)
+                throw Abandon{};
+
+            variable.isArray = true;
+            variable.defined = true;
+            variable.value.isPointer = true;
+            variable.value.object = allocate(static_cast<size_t>(var->arraySize), true);
+        }
+        else
+        {
+            variable.type = types.intern(var->type);
+
+            if (var->initializer)
+            {
+                variable.value = convert(evaluate(var->initializer.get()), variable.type);
+                variable.defined = true;
+            }
+        }
+
+        scopes.back()[var->name] = variable;
+        return Flow::Next;
+    }
+
+    if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        Value value = evaluate(assign->value.get());
+
+        if (auto target = dynamic_cast<const VarExpr*>(assign->target.get()))
+        {
+            Variable& variable = lookup(target->name);
+
+            if (variable.isArray)
+                throw Abandon{};
+
+            variable.value = convert(value, variable.type);
+            variable.defined = true;
+        }
+        else if (auto idx = dynamic_cast<const IndexExpr*>(assign->target.get()))
+        {
+            Value base = evaluate(idx->base.get());
+            store(base, toInteger(evaluate(idx->index.get())), value);
+        }
+        else if (auto deref = dynamic_cast<const DerefExpr*>(assign->target.get()))
+            store(evaluate(deref->target.get()), 0, value);
+        else
+            throw Abandon{};
+
+        return Flow::Next;
+    }
+
+    if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+    {
+        if (ret->value)
+        {
+            returned = convert(evaluate(ret->value.get()), returnType);
+            hasReturned = true;
+        }
+
+        return Flow::Return;
+    }
+
+    if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        if (isTrue(evaluate(ifs->condition.get())))
+            return execute(ifs->thenBranch.get());
+
+        return execute(ifs->elseBranch.get());
+    }
+
+    if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        while (isTrue(evaluate(wh->condition.get())))
+        {
+            if (execute(wh->body.get()) == Flow::Return)
+                return Flow::Return;
+        }
+
+        return Flow::Next;
+    }
+
+    if (auto block = dynamic_cast<const BlockStmt*>(stmt))
+        return execute(block);
+
+    throw Abandon{};
+}
+
+Interpreter::Flow Interpreter::execute(const BlockStmt* block)
+{
+    if (!block)
+        return Flow::Next;
+
+    scopes.emplace_back();
+
+    for (const auto& stmt : block->statements)
+    {
+        if (execute(stmt.get()) == Flow::Return)
+        {
+            scopes.pop_back();
+            return Flow::Return;
+        }
+    }
+
+    scopes.pop_back();
+    return Flow::Next;
+}
+
+Value Interpreter::call(const FunctionDecl& fn, const std::vector<Value>& args)
+{
+    if (++depth > MAX_CALL_DEPTH || args.size() != fn.params.size())
+        throw Abandon{};
+
+    auto callerScopes = std::move(scopes);
+    TypeId callerReturnType = returnType;
+
+    scopes.clear();
+    scopes.emplace_back();
+    returnType = types.intern(fn.returnType);
+    hasReturned = false;
+
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        Variable param;
+        param.type = types.intern(fn.params[i].type);
+        param.value = convert(args[i], param.type);
+        param.defined = true;
+
+        scopes.back()[fn.params[i].name] = param;
+    }
+
+    execute(fn.body.get());
+
+    // Falling off the end leaves nothing a caller could use
+    if (!hasReturned && returnType != builtinType(BaseKind::Nore))
+        throw Abandon{};
+
+    scopes = std::move(callerScopes);
+    returnType = callerReturnType;
+    hasReturned = false;
+    depth--;
+
+    return returned;
+}
+
+
+// ===== Call replacement =====
+
+struct CtfeContext
+{
+    TypeTable* types = nullptr;
+    std::unordered_map<std::string, const FunctionDecl*> functions;
+    std::unordered_set<std::string> pure;
+    size_t totalSteps = 0;
+
+    CtfeStats stats;
+};
+
+static bool isConstantArgument(const Expr* expr)
+{
+    return dynamic_cast<const LiteralExpr*>(expr) || dynamic_cast<const StringExpr*>(expr);
+}
+
+// Replaces the call in `slot` by a literal if it is a constant call to a
+// pure function that returns an integer or bool and finishes in budget
+static void evaluateCall(std::unique_ptr<Expr>& slot, CtfeContext& ctx)
+{
+    auto call = dynamic_cast<CallExpr*>(slot.get());
+    if (!call || call->type == INVALID_TYPE)
+        return;
+
+    std::string name = calleeName(call);
+    auto fn = ctx.functions.find(name);
+
+    if (fn == ctx.functions.end() || !ctx.pure.count(name))
+        return;
+
+    CType t;
+    if (!cTypeOf(ctx.types->info(call->type), t))
+        return;
+
+    for (const auto& arg : call->arguments)
+    {
+        if (!isConstantArgument(arg.get()))
+            return;
+    }
+
+    if (ctx.totalSteps >= STEPS_TOTAL)
+    {
+        ctx.stats.callsAbandoned++;
+        return;
+    }
+
+    Value result;
+
+    try
+    {
+        Interpreter interpreter(*ctx.types, ctx.functions, ctx.pure, ctx.totalSteps);
+
+        std::vector<Value> args;
+        for (const auto& arg : call->arguments)
+            args.push_back(interpreter.evaluate(arg.get()));
+
+        result = interpreter.call(*fn->second, args);
+    }
+    catch (const Abandon&)
+    {
+        ctx.stats.callsAbandoned++;
+        return;
+    }
+
+    std::string text = literalText(result.value, t, t.bits == 1);
+    if (text.empty())
+        return;
+
+    auto literal = std::make_unique<LiteralExpr>(text);
+    literal->span = call->span;
+    literal->type = call->type;
+    literal->convertedType = call->convertedType;
+    slot = std::move(literal);
+
+    ctx.stats.callsEvaluated++;
+}
+
+// Post-order, so calls nested in the arguments of another go first
+static void evaluateCalls(std::unique_ptr<Expr>& slot, CtfeContext& ctx)
+{
+    Expr* expr = slot.get();
+    if (!expr) return;
+
+    if (auto call = dynamic_cast<CallExpr*>(expr))
+    {
+        for (auto& arg : call->arguments)
+            evaluateCalls(arg, ctx);
+
+        evaluateCall(slot, ctx);
+    }
+    else if (auto bin = dynamic_cast<BinaryExpr*>(expr))
+    {
+        evaluateCalls(bin->left, ctx);
+        evaluateCalls(bin->right, ctx);
+    }
+    else if (auto unary = dynamic_cast<UnaryExpr*>(expr))
+        evaluateCalls(unary->operand, ctx);
+    else if (auto cast = dynamic_cast<CastExpr*>(expr))
+        evaluateCalls(cast->expr, ctx);
+    else if (auto deref = dynamic_cast<DerefExpr*>(expr))
+        evaluateCalls(deref->target, ctx);
+    else if (auto addr = dynamic_cast<AddressOfExpr*>(expr))
+        evaluateCalls(addr->target, ctx);
+    else if (auto idx = dynamic_cast<IndexExpr*>(expr))
+    {
+        evaluateCalls(idx->base, ctx);
+        evaluateCalls(idx->index, ctx);
+    }
+}
+
+static void evaluateCalls(BlockStmt* block, CtfeContext& ctx);
+
+static void evaluateCalls(Stmt* stmt, CtfeContext& ctx)
+{
+    if (auto exprStmt = dynamic_cast<ExpressionStmt*>(stmt))
+        evaluateCalls(exprStmt->expression, ctx);
+    else if (auto var = dynamic_cast<VarDeclStmt*>(stmt))
+        evaluateCalls(var->initializer, ctx);
+    else if (auto ret = dynamic_cast<ReturnStmt*>(stmt))
+        evaluateCalls(ret->value, ctx);
+    else if (auto assign = dynamic_cast<AssignmentStmt*>(stmt))
+    {
+        evaluateCalls(assign->target, ctx);
+        evaluateCalls(assign->value, ctx);
+    }
+    else if (auto ifs = dynamic_cast<IfStmt*>(stmt))
+    {
+        evaluateCalls(ifs->condition, ctx);
+        evaluateCalls(ifs->thenBranch.get(), ctx);
+        evaluateCalls(ifs->elseBranch.get(), ctx);
+    }
+    else if (auto wh = dynamic_cast<WhileStmt*>(stmt))
+    {
+        evaluateCalls(wh->condition, ctx);
+        evaluateCalls(wh->body.get(), ctx);
+    }
+    else if (auto block = dynamic_cast<BlockStmt*>(stmt))
+        evaluateCalls(block, ctx);
+}
+
+static void evaluateCalls(BlockStmt* block, CtfeContext& ctx)
+{
+    if (!block) return;
+
+    for (auto& stmt : block->statements)
+        evaluateCalls(stmt.get(), ctx);
+}
+
+CtfeStats evaluatePureCalls(Program& program)
+{
+    CtfeContext ctx;
+    ctx.types = &program.types;
+
+    for (const auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl))
+        {
+            const auto& fn = std::get<FunctionDecl>(decl);
+            ctx.functions[fn.name] = &fn;
+        }
+    }
+
+    ctx.pure = findPureFunctions(ctx.functions);
+    ctx.stats.pureFunctions = ctx.pure.size();
+
+    for (auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        auto& fn = std::get<FunctionDecl>(decl);
+
+        if (!fn.isExtern)
+            evaluateCalls(fn.body.get(), ctx);
+    }
+
+    return ctx.stats;
+}
+
+}
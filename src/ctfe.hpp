@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstddef>
+#include <string>
+
+namespace azin
+{
+
+struct CtfeStats
+{
+    size_t pureFunctions = 0;    // functions without side effects
+    size_t callsEvaluated = 0;   // calls replaced by their result
+    size_t callsAbandoned = 0;   // constant calls the interpreter gave up on
+};
+
+// Runs calls to side-effect-free functions whose arguments are all
+// constants at compile time and replaces them with the integer or bool
+// they return. A function is pure when it is not extern, calls only pure
+// functions and writes memory only through its own local arrays.
+//
+// The interpreter follows the semantics of the generated C exactly and
+// gives up on a call (leaving it for run time) on anything C leaves
+// undefined, on a read of uninitialized memory, past a step budget or
+// past a recursion limit, so compilation cannot hang. Needs the types
+// SemanticAnalyzer stores on the AST.
+CtfeStats evaluatePureCalls(Program& program);
+
+// Appends the bytes a string literal's source text stands for to out.
+// False on escapes other than \n \t \r \\ \' \" and \0.
+bool decodeString(const std::string& text, std::string& out);
+
+}
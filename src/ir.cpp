@@ -0,0 +1,447 @@
+#include "ir.hpp"
+
+#include <algorithm>
+
+namespace azin
+{
+
+// ===== IRFunction =====
+
+ValueId IRFunction::add(IRInst inst)
+{
+    values.push_back(std::move(inst));
+    return static_cast<ValueId>(values.size() - 1);
+}
+
+BlockId IRFunction::addBlock()
+{
+    blocks.emplace_back();
+    return static_cast<BlockId>(blocks.size() - 1);
+}
+
+std::vector<BlockId> IRFunction::successors(BlockId block) const
+{
+    if (blocks[block].insts.empty())
+        return {};
+
+    return terminator(block).targets;
+}
+
+void IRFunction::computePredecessors()
+{
+    for (auto& block : blocks)
+        block.preds.clear();
+
+    for (BlockId b = 0; b < blocks.size(); b++)
+    {
+        if (blocks[b].removed)
+            continue;
+
+        for (BlockId succ : successors(b))
+        {
+            auto& preds = blocks[succ].preds;
+
+            // A branch with both targets the same is still one edge
+            if (std::find(preds.begin(), preds.end(), b) == preds.end())
+                preds.push_back(b);
+        }
+    }
+}
+
+std::vector<BlockId> IRFunction::reversePostorder() const
+{
+    std::vector<BlockId> order;
+    std::vector<bool> visited(blocks.size(), false);
+
+    // Iterative DFS: (block, next successor to visit)
+    std::vector<std::pair<BlockId, size_t>> stack;
+    stack.push_back({ 0, 0 });
+    visited[0] = true;
+
+    while (!stack.empty())
+    {
+        auto& [block, next] = stack.back();
+        std::vector<BlockId> succs = successors(block);
+
+        if (next < succs.size())
+        {
+            BlockId succ = succs[next++];
+
+            if (!visited[succ])
+            {
+                visited[succ] = true;
+                stack.push_back({ succ, 0 });
+            }
+        }
+        else
+        {
+            order.push_back(block);
+            stack.pop_back();
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+
+// ===== Rewriting =====
+
+void replaceUses(IRFunction& fn, const std::unordered_map<ValueId, ValueId>& replacements)
+{
+    if (replacements.empty())
+        return;
+
+    for (auto& inst : fn.values)
+    {
+        if (inst.block == NO_BLOCK)
+            continue;
+
+        for (auto& op : inst.operands)
+        {
+            for (auto it = replacements.find(op); it != replacements.end(); it = replacements.find(op))
+                op = it->second;
+        }
+    }
+}
+
+void removeInst(IRFunction& fn, ValueId id)
+{
+    BlockId block = fn.values[id].block;
+    if (block == NO_BLOCK)
+        return;
+
+    auto& insts = fn.blocks[block].insts;
+    insts.erase(std::find(insts.begin(), insts.end(), id));
+
+    fn.values[id].block = NO_BLOCK;
+}
+
+bool removeTrivialPhis(IRFunction& fn)
+{
+    bool removedAny = false;
+
+    while (true)
+    {
+        std::unordered_map<ValueId, ValueId> replacements;
+        std::vector<ValueId> trivial;
+
+        for (const auto& block : fn.blocks)
+        {
+            if (block.removed)
+                continue;
+
+            for (ValueId id : block.insts)
+            {
+                const IRInst& phi = fn.values[id];
+                if (phi.op != IROp::Phi)
+                    break;
+
+                ValueId same = NO_VALUE;
+                bool isTrivial = true;
+
+                for (ValueId op : phi.operands)
+                {
+                    if (op == same || op == id)
+                        continue;
+
+                    if (same != NO_VALUE)
+                    {
+                        isTrivial = false;
+                        break;
+                    }
+
+                    same = op;
+                }
+
+                if (isTrivial)
+                {
+                    trivial.push_back(id);
+                    replacements[id] = same;
+                }
+            }
+        }
+
+        if (trivial.empty())
+            return removedAny;
+
+        for (ValueId id : trivial)
+        {
+            // Phis that are trivial only through each other collapse too
+            ValueId same = replacements[id];
+
+            while (same != NO_VALUE && same != id && replacements.count(same))
+                same = replacements[same];
+
+            replacements[id] = same == id ? NO_VALUE : same;
+
+            // Only reachable through itself: never actually defined
+            if (replacements[id] == NO_VALUE)
+            {
+                IRInst undef;
+                undef.op = IROp::Undef;
+                undef.type = fn.values[id].type;
+                replacements[id] = fn.add(std::move(undef));
+            }
+
+            removeInst(fn, id);
+        }
+
+        replaceUses(fn, replacements);
+        removedAny = true;
+    }
+}
+
+
+// ===== Op classes =====
+
+bool isTerminator(IROp op)
+{
+    return op == IROp::Jump || op == IROp::Branch || op == IROp::Return;
+}
+
+bool isUnplaced(IROp op)
+{
+    return op == IROp::Const || op == IROp::String || op == IROp::Param || op == IROp::Undef;
+}
+
+bool hasSideEffects(IROp op)
+{
+    return op == IROp::Store || op == IROp::Call || op == IROp::CheckIndex || isTerminator(op);
+}
+
+bool isPureValue(IROp op)
+{
+    switch (op)
+    {
+        case IROp::Add: case IROp::Sub: case IROp::Mul: case IROp::Div: case IROp::Rem:
+        case IROp::Shl: case IROp::Shr: case IROp::And: case IROp::Neg:
+        case IROp::Eq: case IROp::Ne: case IROp::Lt: case IROp::Le: case IROp::Gt: case IROp::Ge:
+        case IROp::Convert: case IROp::PtrAdd: case IROp::PtrDiff:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* irOpName(IROp op)
+{
+    switch (op)
+    {
+        case IROp::Const:      return "const";
+        case IROp::String:     return "string";
+        case IROp::Param:      return "param";
+        case IROp::Undef:      return "undef";
+        case IROp::Alloca:     return "alloca";
+        case IROp::Load:       return "load";
+        case IROp::Store:      return "store";
+        case IROp::Add:        return "add";
+        case IROp::Sub:        return "sub";
+        case IROp::Mul:        return "mul";
+        case IROp::Div:        return "div";
+        case IROp::Rem:        return "rem";
+        case IROp::Shl:        return "shl";
+        case IROp::Shr:        return "shr";
+        case IROp::And:        return "and";
+        case IROp::Neg:        return "neg";
+        case IROp::Eq:         return "eq";
+        case IROp::Ne:         return "ne";
+        case IROp::Lt:         return "lt";
+        case IROp::Le:         return "le";
+        case IROp::Gt:         return "gt";
+        case IROp::Ge:         return "ge";
+        case IROp::Convert:    return "convert";
+        case IROp::PtrAdd:     return "ptradd";
+        case IROp::PtrDiff:    return "ptrdiff";
+        case IROp::CheckIndex: return "checkindex";
+        case IROp::Call:       return "call";
+        case IROp::Phi:        return "phi";
+        case IROp::Jump:       return "jump";
+        case IROp::Branch:     return "branch";
+        case IROp::Return:     return "return";
+    }
+
+    return "?";
+}
+
+
+// ===== Dominators =====
+
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder
+std::vector<BlockId> computeDominators(const IRFunction& fn)
+{
+    std::vector<BlockId> order = fn.reversePostorder();
+    std::vector<size_t> position(fn.blocks.size(), SIZE_MAX);
+
+    for (size_t i = 0; i < order.size(); i++)
+        position[order[i]] = i;
+
+    std::vector<BlockId> idom(fn.blocks.size(), NO_BLOCK);
+    idom[0] = 0;
+
+    auto intersect = [&](BlockId a, BlockId b)
+    {
+        while (a != b)
+        {
+            while (position[a] > position[b]) a = idom[a];
+            while (position[b] > position[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = 1; i < order.size(); i++)
+        {
+            BlockId b = order[i];
+            BlockId dom = NO_BLOCK;
+
+            for (BlockId pred : fn.blocks[b].preds)
+            {
+                if (position[pred] == SIZE_MAX || idom[pred] == NO_BLOCK)
+                    continue;
+
+                dom = dom == NO_BLOCK ? pred : intersect(pred, dom);
+            }
+
+            if (dom != idom[b])
+            {
+                idom[b] = dom;
+                changed = true;
+            }
+        }
+    }
+
+    return idom;
+}
+
+bool dominates(const std::vector<BlockId>& idom, BlockId a, BlockId b)
+{
+    if (idom[b] == NO_BLOCK)
+        return false;
+
+    while (b != a)
+    {
+        if (b == 0)
+            return false;
+
+        b = idom[b];
+    }
+
+    return true;
+}
+
+
+// ===== Printing =====
+
+static std::string typeName(TypeId type, const TypeTable& types)
+{
+    return type == INVALID_TYPE ? "nore" : types.info(type).name;
+}
+
+static std::string operandText(const IRFunction& fn, ValueId id, const TypeTable& types)
+{
+    const IRInst& v = fn.values[id];
+
+    switch (v.op)
+    {
+        case IROp::Const:
+        {
+            const TypeInfo& info = types.info(v.type);
+
+            if (info.base == BaseKind::Bool && !info.isPointer)
+                return v.imm ? "true" : "false";
+
+            return wideToString(v.imm);
+        }
+        case IROp::String: return "\"" + v.text + "\"";
+        case IROp::Param:  return "%" + fn.paramNames[static_cast<size_t>(v.imm)];
+        case IROp::Undef:  return "undef";
+        default:           return "%" + std::to_string(id);
+    }
+}
+
+void printIR(const IRFunction& fn, const TypeTable& types, std::ostream& out)
+{
+    out << "fn " << typeName(fn.returnType, types) << " " << fn.name << "(";
+
+    for (size_t i = 0; i < fn.paramNames.size(); i++)
+    {
+        out << typeName(fn.paramTypes[i], types) << " %" << fn.paramNames[i];
+        if (i + 1 < fn.paramNames.size())
+            out << ", ";
+    }
+
+    out << ")\n";
+
+    for (BlockId b = 0; b < fn.blocks.size(); b++)
+    {
+        const IRBlock& block = fn.blocks[b];
+        if (block.removed)
+            continue;
+
+        out << "bb" << b << ":";
+
+        if (!block.preds.empty())
+        {
+            out << "    ; preds";
+            for (BlockId pred : block.preds)
+                out << " bb" << pred;
+        }
+
+        out << "\n";
+
+        for (ValueId id : block.insts)
+        {
+            const IRInst& inst = fn.values[id];
+            out << "    ";
+
+            if (inst.type != INVALID_TYPE && !isTerminator(inst.op) && inst.op != IROp::Store)
+                out << "%" << id << " = ";
+
+            out << irOpName(inst.op);
+
+            if (inst.type != INVALID_TYPE && !isTerminator(inst.op) && inst.op != IROp::Store)
+                out << " " << typeName(inst.type, types);
+
+            if (inst.op == IROp::Call)
+                out << " " << inst.text;
+
+            for (size_t i = 0; i < inst.operands.size(); i++)
+            {
+                out << (i == 0 ? " " : ", ");
+
+                if (inst.op == IROp::Phi)
+                    out << "[" << operandText(fn, inst.operands[i], types)
+                        << ", bb" << inst.targets[i] << "]";
+                else
+                    out << operandText(fn, inst.operands[i], types);
+            }
+
+            if (inst.op == IROp::Alloca || inst.op == IROp::CheckIndex)
+                out << (inst.operands.empty() ? " " : ", ") << wideToString(inst.imm);
+
+            if (inst.op != IROp::Phi)
+            {
+                for (size_t i = 0; i < inst.targets.size(); i++)
+                    out << (i == 0 && inst.operands.empty() ? " " : ", ") << "bb" << inst.targets[i];
+            }
+
+            out << "\n";
+        }
+    }
+
+    out << "\n";
+}
+
+void printIR(const IRModule& module, std::ostream& out)
+{
+    for (const auto& fn : module.functions)
+        printIR(fn, *module.types, out);
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+// Typed SSA intermediate representation.
+//
+// A function is a list of basic blocks over one pool of instructions.
+// Every instruction defines at most one value, named by its index in the
+// pool. Constants, string literals, parameters and undefined values are
+// not placed in any block; they are used directly as operands. Locals
+// whose address is taken and fixed arrays live in memory (Alloca, Load,
+// Store); every other local is an SSA value, merged with Phi at joins.
+
+#include "ast.hpp"
+#include "cinteger.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace azin
+{
+
+using ValueId = uint32_t;
+using BlockId = uint32_t;
+
+constexpr ValueId NO_VALUE = UINT32_MAX;
+constexpr BlockId NO_BLOCK = UINT32_MAX;
+
+enum class IROp : uint8_t
+{
+    // Unplaced values
+    Const,      // imm in the range of type
+    String,     // text as written in the source, escapes included
+    Param,      // imm-th parameter
+    Undef,      // a variable read before any assignment
+
+    // Memory
+    Alloca,     // imm elements of the pointee of type; the value is their address
+    Load,       // *operands[0]
+    Store,      // *operands[0] = operands[1]
+
+    // Integer arithmetic; operands and result have the same type
+    Add, Sub, Mul, Div, Rem,
+    Shl, Shr, And,
+    Neg,
+
+    // Comparisons; bool result
+    Eq, Ne, Lt, Le, Gt, Ge,
+
+    Convert,    // C conversion of operands[0] to type
+    PtrAdd,     // operands[0] + operands[1] elements
+    PtrDiff,    // operands[0] - operands[1], in elements
+    CheckIndex, // operands[0], trapping unless it is in [0, imm)
+    Call,       // text(operands...); type is INVALID_TYPE for nore
+
+    Phi,        // operands[i] when control came from targets[i]
+
+    // Terminators
+    Jump,       // to targets[0]
+    Branch,     // to targets[0] if operands[0], else targets[1]
+    Return      // operands[0], if any
+};
+
+struct IRInst
+{
+    IROp op;
+    TypeId type = INVALID_TYPE;     // of the value defined, if any
+    std::vector<ValueId> operands;
+    std::vector<BlockId> targets;
+    Wide imm = 0;
+    std::string text;
+    BlockId block = NO_BLOCK;       // NO_BLOCK for unplaced values and removed instructions
+};
+
+struct IRBlock
+{
+    std::vector<ValueId> insts;     // phis first, one terminator last
+    std::vector<BlockId> preds;
+    bool removed = false;
+};
+
+struct IRFunction
+{
+    std::string name;
+    TypeId returnType = INVALID_TYPE;
+    std::vector<std::string> paramNames;
+    std::vector<TypeId> paramTypes;
+    bool isHot = false;
+    bool isCold = false;
+
+    std::vector<IRInst> values;
+    std::vector<IRBlock> blocks;    // entry is block 0
+
+    ValueId add(IRInst inst);
+    BlockId addBlock();
+
+    const IRInst& terminator(BlockId block) const { return values[blocks[block].insts.back()]; }
+    std::vector<BlockId> successors(BlockId block) const;
+
+    // Rebuilds IRBlock::preds from the terminators of the live blocks
+    void computePredecessors();
+
+    // Reachable blocks in reverse postorder, entry first
+    std::vector<BlockId> reversePostorder() const;
+};
+
+struct IRModule
+{
+    TypeTable* types = nullptr;
+    std::vector<IRFunction> functions;   // in program order, externs excluded
+};
+
+// Op classes
+bool isTerminator(IROp op);
+bool isUnplaced(IROp op);
+bool hasSideEffects(IROp op);      // kept even when the value is unused
+bool isPureValue(IROp op);         // the result depends only on the operands
+
+const char* irOpName(IROp op);
+
+// Rewrites every operand through `replacements`, following chains
+void replaceUses(IRFunction& fn, const std::unordered_map<ValueId, ValueId>& replacements);
+
+// Takes an instruction out of its block; its id stays valid
+void removeInst(IRFunction& fn, ValueId id);
+
+// Replaces phis whose operands are all one value (or the phi itself) by
+// that value, until none are left. True if any was removed.
+bool removeTrivialPhis(IRFunction& fn);
+
+// Immediate dominator of every reachable block (entry: itself), NO_BLOCK
+// for unreachable ones
+std::vector<BlockId> computeDominators(const IRFunction& fn);
+bool dominates(const std::vector<BlockId>& idom, BlockId a, BlockId b);
+
+void printIR(const IRFunction& fn, const TypeTable& types, std::ostream& out);
+void printIR(const IRModule& module, std::ostream& out);
+
+}
@@ -0,0 +1,898 @@
+#include "irbuilder.hpp"
+#include "codegen.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace azin
+{
+
+// ===== Helpers =====
+
+// The IR type of values computed in C type t
+static TypeId typeFor(CType t)
+{
+    if (t.bits == 1)
+        return builtinType(BaseKind::Bool);
+
+    switch (t.bits)
+    {
+        case 8:  return builtinType(t.isSigned ? BaseKind::I8 : BaseKind::U8);
+        case 16: return builtinType(t.isSigned ? BaseKind::I16 : BaseKind::U16);
+        case 32: return builtinType(t.isSigned ? BaseKind::Int : BaseKind::U32);
+        default: return builtinType(t.isSigned ? BaseKind::I64 : BaseKind::U64);
+    }
+}
+
+static bool isComparison(const std::string& op)
+{
+    return op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=";
+}
+
+static IROp binaryOp(const std::string& op)
+{
+    if (op == "+")  return IROp::Add;
+    if (op == "-")  return IROp::Sub;
+    if (op == "*")  return IROp::Mul;
+    if (op == "/")  return IROp::Div;
+    if (op == "%")  return IROp::Rem;
+    if (op == "==") return IROp::Eq;
+    if (op == "!=") return IROp::Ne;
+    if (op == "<")  return IROp::Lt;
+    if (op == "<=") return IROp::Le;
+    if (op == ">")  return IROp::Gt;
+    if (op == ">=") return IROp::Ge;
+
+    throw std::runtime_error("Unsupported operator in IR lowering: " + op);
+}
+
+static void collectAddressTaken(const Expr* expr, std::unordered_set<std::string>& out);
+
+static void collectAddressTaken(const Stmt* stmt, std::unordered_set<std::string>& out)
+{
+    if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+        collectAddressTaken(exprStmt->expression.get(), out);
+    else if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+        collectAddressTaken(var->initializer.get(), out);
+    else if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+        collectAddressTaken(ret->value.get(), out);
+    else if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        collectAddressTaken(assign->target.get(), out);
+        collectAddressTaken(assign->value.get(), out);
+    }
+    else if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        collectAddressTaken(ifs->condition.get(), out);
+        collectAddressTaken(ifs->thenBranch.get(), out);
+        collectAddressTaken(ifs->elseBranch.get(), out);
+    }
+    else if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        collectAddressTaken(wh->condition.get(), out);
+        collectAddressTaken(wh->body.get(), out);
+    }
+    else if (auto block = dynamic_cast<const BlockStmt*>(stmt))
+    {
+        for (const auto& s : block->statements)
+            collectAddressTaken(s.get(), out);
+    }
+}
+
+static void collectAddressTaken(const Expr* expr, std::unordered_set<std::string>& out)
+{
+    if (!expr) return;
+
+    if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
+    {
+        if (auto var = dynamic_cast<const VarExpr*>(addr->target.get()))
+            out.insert(var->name);
+
+        collectAddressTaken(addr->target.get(), out);
+    }
+    else if (auto call = dynamic_cast<const CallExpr*>(expr))
+    {
+        for (const auto& arg : call->arguments)
+            collectAddressTaken(arg.get(), out);
+    }
+    else if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+    {
+        collectAddressTaken(bin->left.get(), out);
+        collectAddressTaken(bin->right.get(), out);
+    }
+    else if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
+        collectAddressTaken(unary->operand.get(), out);
+    else if (auto cast = dynamic_cast<const CastExpr*>(expr))
+        collectAddressTaken(cast->expr.get(), out);
+    else if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        collectAddressTaken(deref->target.get(), out);
+    else if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+    {
+        collectAddressTaken(idx->base.get(), out);
+        collectAddressTaken(idx->index.get(), out);
+    }
+}
+
+
+// ===== FunctionLowering =====
+
+namespace
+{
+
+struct Variable
+{
+    TypeId type = INVALID_TYPE;
+    ValueId address = NO_VALUE;   // Alloca, for arrays and locals whose address is taken
+    bool isArray = false;
+};
+
+class FunctionLowering
+{
+public:
+    FunctionLowering(IRFunction& fn, TypeTable& types,
+                     const std::unordered_map<std::string, const FunctionDecl*>& signatures,
+                     bool boundsChecks)
+        : fn(fn), types(types), signatures(signatures), boundsChecks(boundsChecks) {}
+
+    void lower(const FunctionDecl& decl);
+
+private:
+    IRFunction& fn;
+    TypeTable& types;
+    const std::unordered_map<std::string, const FunctionDecl*>& signatures;
+    bool boundsChecks;
+
+    BlockId current = 0;
+
+    std::vector<std::unordered_map<std::string, Variable*>> scopes;
+    std::vector<std::unique_ptr<Variable>> variables;
+    std::unordered_set<std::string> addressTaken;
+
+    // SSA construction state, per block
+    std::vector<std::unordered_map<const Variable*, ValueId>> definitions;
+    std::vector<std::unordered_map<const Variable*, ValueId>> incompletePhis;
+    std::vector<bool> sealed;
+    std::unordered_map<ValueId, ValueId> replaced;   // trivial phis removed while building
+
+    // ===== Building blocks =====
+    BlockId newBlock();
+    ValueId emit(IRInst inst);
+    ValueId emit(IROp op, TypeId type, std::vector<ValueId> operands = {});
+    ValueId unplaced(IROp op, TypeId type, Wide imm = 0);
+    ValueId constant(Wide value, TypeId type) { return unplaced(IROp::Const, type, value); }
+    ValueId allocate(TypeId element, Wide count);
+    void jump(BlockId target);
+    void branch(ValueId condition, BlockId ifTrue, BlockId ifFalse);
+    bool isTerminated() const;
+    TypeId typeOf(ValueId v) const { return fn.values[v].type; }
+
+    // ===== SSA =====
+    void writeVariable(const Variable* var, BlockId block, ValueId value);
+    ValueId readVariable(const Variable* var, BlockId block);
+    ValueId readVariableRecursive(const Variable* var, BlockId block);
+    ValueId addPhiOperands(const Variable* var, ValueId phi);
+    ValueId tryRemoveTrivialPhi(ValueId phi);
+    ValueId resolve(ValueId v) const;
+    ValueId newPhi(BlockId block, TypeId type);
+    void sealBlock(BlockId block);
+
+    // ===== Lowering =====
+    Variable* declare(const std::string& name, TypeId type);
+    Variable* lookup(const std::string& name);
+
+    ValueId convert(ValueId v, TypeId to);
+    ValueId lowerExpr(const Expr* expr);
+    ValueId lowerValue(const Expr* expr);
+    ValueId lowerBinary(const BinaryExpr* bin);
+    ValueId lowerAddress(const Expr* expr);
+    ValueId elementAddress(const IndexExpr* idx);
+
+    void lowerStmt(const Stmt* stmt);
+    void lowerBlock(const BlockStmt* block);
+};
+
+}
+
+BlockId FunctionLowering::newBlock()
+{
+    BlockId block = fn.addBlock();
+
+    definitions.emplace_back();
+    incompletePhis.emplace_back();
+    sealed.push_back(false);
+
+    return block;
+}
+
+ValueId FunctionLowering::emit(IRInst inst)
+{
+    inst.block = current;
+
+    ValueId id = fn.add(std::move(inst));
+    fn.blocks[current].insts.push_back(id);
+
+    return id;
+}
+
+ValueId FunctionLowering::emit(IROp op, TypeId type, std::vector<ValueId> operands)
+{
+    IRInst inst;
+    inst.op = op;
+    inst.type = type;
+    inst.operands = std::move(operands);
+
+    return emit(std::move(inst));
+}
+
+ValueId FunctionLowering::unplaced(IROp op, TypeId type, Wide imm)
+{
+    IRInst inst;
+    inst.op = op;
+    inst.type = type;
+    inst.imm = imm;
+
+    return fn.add(std::move(inst));
+}
+
+// Arrays and address-taken locals live for the whole call, so their
+// storage is allocated once in the entry block
+ValueId FunctionLowering::allocate(TypeId element, Wide count)
+{
+    IRInst inst;
+    inst.op = IROp::Alloca;
+    inst.type = types.pointerTo(element);
+    inst.imm = count;
+    inst.block = 0;
+
+    ValueId id = fn.add(std::move(inst));
+    auto& entry = fn.blocks[0].insts;
+
+    size_t at = 0;
+    while (at < entry.size() && fn.values[entry[at]].op == IROp::Alloca)
+        at++;
+
+    entry.insert(entry.begin() + at, id);
+    return id;
+}
+
+void FunctionLowering::jump(BlockId target)
+{
+    IRInst inst;
+    inst.op = IROp::Jump;
+    inst.targets = { target };
+    emit(std::move(inst));
+
+    fn.blocks[target].preds.push_back(current);
+}
+
+void FunctionLowering::branch(ValueId condition, BlockId ifTrue, BlockId ifFalse)
+{
+    IRInst inst;
+    inst.op = IROp::Branch;
+    inst.operands = { condition };
+    inst.targets = { ifTrue, ifFalse };
+    emit(std::move(inst));
+
+    fn.blocks[ifTrue].preds.push_back(current);
+    fn.blocks[ifFalse].preds.push_back(current);
+}
+
+bool FunctionLowering::isTerminated() const
+{
+    const auto& insts = fn.blocks[current].insts;
+    return !insts.empty() && isTerminator(fn.values[insts.back()].op);
+}
+
+
+// ===== SSA =====
+
+void FunctionLowering::writeVariable(const Variable* var, BlockId block, ValueId value)
+{
+    definitions[block][var] = value;
+}
+
+ValueId FunctionLowering::readVariable(const Variable* var, BlockId block)
+{
+    auto found = definitions[block].find(var);
+    if (found != definitions[block].end())
+        return resolve(found->second);
+
+    return readVariableRecursive(var, block);
+}
+
+ValueId FunctionLowering::readVariableRecursive(const Variable* var, BlockId block)
+{
+    ValueId value;
+    const auto& preds = fn.blocks[block].preds;
+
+    if (!sealed[block])
+    {
+        // More predecessors may come; fill the phi in once they have
+        value = newPhi(block, var->type);
+        incompletePhis[block][var] = value;
+    }
+    else if (preds.size() == 1)
+        value = readVariable(var, preds[0]);
+    else if (preds.empty())
+        value = unplaced(IROp::Undef, var->type);
+    else
+    {
+        // Break cycles through loops with the phi itself
+        value = newPhi(block, var->type);
+        writeVariable(var, block, value);
+        value = addPhiOperands(var, value);
+    }
+
+    writeVariable(var, block, value);
+    return value;
+}
+
+ValueId FunctionLowering::addPhiOperands(const Variable* var, ValueId phi)
+{
+    std::vector<BlockId> preds = fn.blocks[fn.values[phi].block].preds;
+
+    for (BlockId pred : preds)
+    {
+        ValueId value = readVariable(var, pred);
+
+        fn.values[phi].operands.push_back(value);
+        fn.values[phi].targets.push_back(pred);
+    }
+
+    return tryRemoveTrivialPhi(phi);
+}
+
+ValueId FunctionLowering::tryRemoveTrivialPhi(ValueId phi)
+{
+    ValueId same = NO_VALUE;
+
+    for (ValueId op : fn.values[phi].operands)
+    {
+        op = resolve(op);
+
+        if (op == same || op == phi)
+            continue;
+
+        if (same != NO_VALUE)
+            return phi;
+
+        same = op;
+    }
+
+    if (same == NO_VALUE)
+        same = unplaced(IROp::Undef, fn.values[phi].type);
+
+    // Users are rewritten once the function is done
+    replaced[phi] = same;
+    removeInst(fn, phi);
+
+    return same;
+}
+
+ValueId FunctionLowering::resolve(ValueId v) const
+{
+    for (auto it = replaced.find(v); it != replaced.end(); it = replaced.find(v))
+        v = it->second;
+
+    return v;
+}
+
+ValueId FunctionLowering::newPhi(BlockId block, TypeId type)
+{
+    IRInst inst;
+    inst.op = IROp::Phi;
+    inst.type = type;
+    inst.block = block;
+
+    ValueId id = fn.add(std::move(inst));
+    auto& insts = fn.blocks[block].insts;
+
+    size_t at = 0;
+    while (at < insts.size() && fn.values[insts[at]].op == IROp::Phi)
+        at++;
+
+    insts.insert(insts.begin() + at, id);
+    return id;
+}
+
+void FunctionLowering::sealBlock(BlockId block)
+{
+    auto pending = std::move(incompletePhis[block]);
+    incompletePhis[block].clear();
+
+    for (const auto& [var, phi] : pending)
+        addPhiOperands(var, phi);
+
+    sealed[block] = true;
+}
+
+
+// ===== Lowering =====
+
+Variable* FunctionLowering::declare(const std::string& name, TypeId type)
+{
+    variables.push_back(std::make_unique<Variable>());
+
+    Variable* var = variables.back().get();
+    var->type = type;
+
+    scopes.back()[name] = var;
+    return var;
+}
+
+Variable* FunctionLowering::lookup(const std::string& name)
+{
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+    {
+        auto found = it->find(name);
+        if (found != it->end())
+            return found->second;
+    }
+
+    throw std::runtime_error("Undefined variable in IR lowering: " + name);
+}
+
+ValueId FunctionLowering::convert(ValueId v, TypeId to)
+{
+    TypeId from = typeOf(v);
+    if (from == to || to == INVALID_TYPE)
+        return v;
+
+    // Constants convert right away
+    CType fromC, toC;
+    const IRInst& inst = fn.values[v];
+
+    if (inst.op == IROp::Const &&
+        cTypeOf(types.info(from), fromC) && cTypeOf(types.info(to), toC))
+    {
+        return constant(toC.bits == 1 ? Wide(inst.imm != 0) : wrap(inst.imm, toC), to);
+    }
+
+    return emit(IROp::Convert, to, { v });
+}
+
+// The value of expr where it is used, implicit conversion included
+ValueId FunctionLowering::lowerExpr(const Expr* expr)
+{
+    ValueId v = lowerValue(expr);
+
+    if (expr->convertedType != INVALID_TYPE && v != NO_VALUE)
+        return convert(v, expr->convertedType);
+
+    return v;
+}
+
+ValueId FunctionLowering::lowerValue(const Expr* expr)
+{
+    if (auto lit = dynamic_cast<const LiteralExpr*>(expr))
+    {
+        Wide value;
+        CType type;
+
+        if (!parseLiteral(lit->value, value, type))
+            throw std::runtime_error("Unsupported literal in IR lowering: " + lit->value);
+
+        return constant(value, typeFor(type));
+    }
+
+    if (auto str = dynamic_cast<const StringExpr*>(expr))
+    {
+        ValueId v = unplaced(IROp::String, expr->type);
+        fn.values[v].text = str->value;
+        return v;
+    }
+
+    if (auto var = dynamic_cast<const VarExpr*>(expr))
+    {
+        Variable* variable = lookup(var->name);
+
+        if (variable->isArray)
+            return variable->address;
+
+        if (variable->address != NO_VALUE)
+            return emit(IROp::Load, variable->type, { variable->address });
+
+        return readVariable(variable, current);
+    }
+
+    if (auto cast = dynamic_cast<const CastExpr*>(expr))
+        return convert(lowerExpr(cast->expr.get()), expr->type);
+
+    if (auto unary = dynamic_cast<const UnaryExpr*>(expr))
+    {
+        ValueId operand = lowerExpr(unary->operand.get());
+
+        CType t;
+        if (unary->op != "-" || !cTypeOf(types.info(typeOf(operand)), t))
+            throw std::runtime_error("Unsupported unary operator in IR lowering: " + unary->op);
+
+        TypeId promoted = typeFor(promote(t));
+        return emit(IROp::Neg, promoted, { convert(operand, promoted) });
+    }
+
+    if (auto bin = dynamic_cast<const BinaryExpr*>(expr))
+        return lowerBinary(bin);
+
+    if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        return emit(IROp::Load, expr->type, { lowerExpr(deref->target.get()) });
+
+    if (auto addr = dynamic_cast<const AddressOfExpr*>(expr))
+        return lowerAddress(addr->target.get());
+
+    if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+        return emit(IROp::Load, expr->type, { elementAddress(idx) });
+
+    if (auto call = dynamic_cast<const CallExpr*>(expr))
+    {
+        std::string name = CodegenC::calleeName(call);
+        auto signature = signatures.find(name);
+
+        IRInst inst;
+        inst.op = IROp::Call;
+        inst.text = name;
+
+        for (size_t i = 0; i < call->arguments.size(); i++)
+        {
+            ValueId arg = lowerExpr(call->arguments[i].get());
+
+            // C converts each argument to its parameter type
+            if (signature != signatures.end() && i < signature->second->params.size())
+                arg = convert(arg, types.intern(signature->second->params[i].type));
+
+            inst.operands.push_back(arg);
+        }
+
+        // A nore call defines no value
+        if (call->type == builtinType(BaseKind::Nore))
+        {
+            emit(std::move(inst));
+            return NO_VALUE;
+        }
+
+        inst.type = call->type;
+        return emit(std::move(inst));
+    }
+
+    throw std::runtime_error("Unsupported expression in IR lowering");
+}
+
+ValueId FunctionLowering::lowerBinary(const BinaryExpr* bin)
+{
+    ValueId a = lowerExpr(bin->left.get());
+    ValueId b = lowerExpr(bin->right.get());
+
+    const TypeInfo& left = types.info(typeOf(a));
+    const TypeInfo& right = types.info(typeOf(b));
+
+    TypeId index = builtinType(BaseKind::I64);
+
+    if (left.isPointer && right.isPointer)
+    {
+        if (isComparison(bin->op))
+            return emit(binaryOp(bin->op), builtinType(BaseKind::Bool), { a, b });
+
+        if (bin->op == "-")
+            return emit(IROp::PtrDiff, index, { a, b });
+    }
+    else if (left.isPointer)
+    {
+        ValueId offset = convert(b, index);
+
+        if (bin->op == "-")
+            offset = emit(IROp::Neg, index, { offset });
+        else if (bin->op != "+")
+            throw std::runtime_error("Unsupported pointer operator in IR lowering: " + bin->op);
+
+        return emit(IROp::PtrAdd, typeOf(a), { a, offset });
+    }
+    else
+    {
+        // Usual arithmetic conversions
+        CType ta, tb;
+        if (!cTypeOf(left, ta) || !cTypeOf(right, tb))
+            throw std::runtime_error("Unsupported operands in IR lowering: " + bin->op);
+
+        TypeId common = typeFor(commonType(ta, tb));
+        a = convert(a, common);
+        b = convert(b, common);
+
+        if (isComparison(bin->op))
+            return emit(binaryOp(bin->op), builtinType(BaseKind::Bool), { a, b });
+
+        return emit(binaryOp(bin->op), common, { a, b });
+    }
+
+    throw std::runtime_error("Unsupported pointer operator in IR lowering: " + bin->op);
+}
+
+ValueId FunctionLowering::lowerAddress(const Expr* expr)
+{
+    if (auto var = dynamic_cast<const VarExpr*>(expr))
+    {
+        Variable* variable = lookup(var->name);
+
+        if (variable->address == NO_VALUE)
+            throw std::runtime_error("Address of a register variable in IR lowering: " + var->name);
+
+        return variable->address;
+    }
+
+    if (auto idx = dynamic_cast<const IndexExpr*>(expr))
+        return elementAddress(idx);
+
+    if (auto deref = dynamic_cast<const DerefExpr*>(expr))
+        return lowerExpr(deref->target.get());
+
+    throw std::runtime_error("Cannot take this address in IR lowering");
+}
+
+ValueId FunctionLowering::elementAddress(const IndexExpr* idx)
+{
+    ValueId base = lowerExpr(idx->base.get());
+    ValueId index = convert(lowerExpr(idx->index.get()), builtinType(BaseKind::I64));
+
+    if (boundsChecks && idx->arraySize >= 0 && !idx->inBounds)
+    {
+        IRInst check;
+        check.op = IROp::CheckIndex;
+        check.type = builtinType(BaseKind::I64);
+        check.operands = { index };
+        check.imm = idx->arraySize;
+
+        index = emit(std::move(check));
+    }
+
+    return emit(IROp::PtrAdd, typeOf(base), { base, index });
+}
+
+void FunctionLowering::lowerStmt(const Stmt* stmt)
+{
+    if (auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt))
+    {
+        lowerExpr(exprStmt->expression.get());
+        return;
+    }
+
+    if (auto var = dynamic_cast<const VarDeclStmt*>(stmt))
+    {
+        TypeId type = types.intern(var->type);
+
+        if (var->isArray)
+        {
+            Variable* variable = declare(var->name, types.pointerTo(type));
+            variable->isArray = true;
+            variable->address = allocate(type, var->arraySize);
+            return;
+        }
+
+        ValueId value = var->initializer
+            ? convert(lowerExpr(var->initializer.get()), type)
+            : unplaced(IROp::Undef, type);
+
+        Variable* variable = declare(var->name, type);
+
+        if (addressTaken.count(var->name))
+        {
+            variable->address = allocate(type, 1);
+            emit(IROp::Store, INVALID_TYPE, { variable->address, value });
+        }
+        else
+            writeVariable(variable, current, value);
+
+        return;
+    }
+
+    if (auto assign = dynamic_cast<const AssignmentStmt*>(stmt))
+    {
+        if (auto target = dynamic_cast<const VarExpr*>(assign->target.get()))
+        {
+            Variable* variable = lookup(target->name);
+            ValueId value = convert(lowerExpr(assign->value.get()), variable->type);
+
+            if (variable->isArray)
+                throw std::runtime_error("Cannot assign to array: " + target->name);
+
+            if (variable->address != NO_VALUE)
+                emit(IROp::Store, INVALID_TYPE, { variable->address, value });
+            else
+                writeVariable(variable, current, value);
+
+            return;
+        }
+
+        ValueId address = lowerAddress(assign->target.get());
+        ValueId value = lowerExpr(assign->value.get());
+
+        emit(IROp::Store, INVALID_TYPE, { address, convert(value, types.pointee(typeOf(address))) });
+        return;
+    }
+
+    if (auto ret = dynamic_cast<const ReturnStmt*>(stmt))
+    {
+        IRInst inst;
+        inst.op = IROp::Return;
+
+        if (ret->value)
+            inst.operands = { convert(lowerExpr(ret->value.get()), fn.returnType) };
+
+        emit(std::move(inst));
+
+        // Anything after a return is unreachable
+        current = newBlock();
+        sealBlock(current);
+        return;
+    }
+
+    if (auto ifs = dynamic_cast<const IfStmt*>(stmt))
+    {
+        ValueId condition = lowerExpr(ifs->condition.get());
+
+        BlockId thenBlock = newBlock();
+        BlockId elseBlock = ifs->elseBranch ? newBlock() : NO_BLOCK;
+        BlockId merge = newBlock();
+
+        branch(condition, thenBlock, ifs->elseBranch ? elseBlock : merge);
+
+        sealBlock(thenBlock);
+        current = thenBlock;
+        lowerBlock(ifs->thenBranch.get());
+        jump(merge);
+
+        if (ifs->elseBranch)
+        {
+            sealBlock(elseBlock);
+            current = elseBlock;
+            lowerBlock(ifs->elseBranch.get());
+            jump(merge);
+        }
+
+        sealBlock(merge);
+        current = merge;
+        return;
+    }
+
+    if (auto wh = dynamic_cast<const WhileStmt*>(stmt))
+    {
+        BlockId header = newBlock();
+        jump(header);
+
+        // The back edge is not known yet, so the header stays unsealed
+        current = header;
+        ValueId condition = lowerExpr(wh->condition.get());
+
+        BlockId body = newBlock();
+        BlockId exit = newBlock();
+
+        branch(condition, body, exit);
+
+        sealBlock(body);
+        current = body;
+        lowerBlock(wh->body.get());
+        jump(header);
+
+        sealBlock(header);
+        sealBlock(exit);
+        current = exit;
+        return;
+    }
+
+    if (auto block = dynamic_cast<const BlockStmt*>(stmt))
+    {
+        lowerBlock(block);
+        return;
+    }
+
+    throw std::runtime_error("Unsupported statement in IR lowering");
+}
+
+void FunctionLowering::lowerBlock(const BlockStmt* block)
+{
+    if (!block) return;
+
+    scopes.emplace_back();
+
+    for (const auto& stmt : block->statements)
+        lowerStmt(stmt.get());
+
+    scopes.pop_back();
+}
+
+void FunctionLowering::lower(const FunctionDecl& decl)
+{
+    collectAddressTaken(decl.body.get(), addressTaken);
+
+    current = newBlock();
+    sealBlock(current);
+
+    scopes.emplace_back();
+
+    for (size_t i = 0; i < decl.params.size(); i++)
+    {
+        TypeId type = fn.paramTypes[i];
+        ValueId value = unplaced(IROp::Param, type, static_cast<Wide>(i));
+
+        Variable* variable = declare(decl.params[i].name, type);
+
+        if (addressTaken.count(decl.params[i].name))
+        {
+            variable->address = allocate(type, 1);
+            emit(IROp::Store, INVALID_TYPE, { variable->address, value });
+        }
+        else
+            writeVariable(variable, current, value);
+    }
+
+    lowerBlock(decl.body.get());
+
+    // Falling off the end: nore returns, anything else returns zero as
+    // main does in C
+    if (!isTerminated())
+    {
+        IRInst inst;
+        inst.op = IROp::Return;
+
+        if (fn.returnType != INVALID_TYPE)
+            inst.operands = { constant(0, fn.returnType) };
+
+        emit(std::move(inst));
+    }
+
+    replaceUses(fn, replaced);
+    removeTrivialPhis(fn);
+    fn.computePredecessors();
+}
+
+
+// ===== Entry point =====
+
+IRModule lowerProgram(Program& program, bool boundsChecks)
+{
+    IRModule module;
+    module.types = &program.types;
+
+    std::unordered_map<std::string, const FunctionDecl*> signatures;
+
+    for (const auto& decl : program.decls)
+    {
+        if (std::holds_alternative<FunctionDecl>(decl))
+        {
+            const auto& fn = std::get<FunctionDecl>(decl);
+            signatures[fn.name] = &fn;
+        }
+    }
+
+    for (const auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& function = std::get<FunctionDecl>(decl);
+
+        if (function.isExtern)
+            continue;
+
+        IRFunction fn;
+        fn.name = function.name;
+        fn.isHot = function.isHot;
+        fn.isCold = function.isCold;
+
+        TypeId returnType = program.types.intern(function.returnType);
+        fn.returnType = returnType == builtinType(BaseKind::Nore) ? INVALID_TYPE : returnType;
+
+        for (const auto& param : function.params)
+        {
+            fn.paramNames.push_back(param.name);
+            fn.paramTypes.push_back(program.types.intern(param.type));
+        }
+
+        FunctionLowering lowering(fn, program.types, signatures, boundsChecks);
+        lowering.lower(function);
+
+        module.functions.push_back(std::move(fn));
+    }
+
+    return module;
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace azin
+{
+
+// Lowers every function with a body to SSA form, building phis on the fly
+// as variables are read (Braun et al., "Simple and Efficient Construction
+// of Static Single Assignment Form"). Implicit C conversions become
+// explicit Convert instructions, so every operation in the IR works on
+// operands of its own type. With boundsChecks, indexes into fixed arrays
+// not proven in bounds go through CheckIndex.
+//
+// Needs the types SemanticAnalyzer stores on the AST.
+IRModule lowerProgram(Program& program, bool boundsChecks);
+
+}
@@ -0,0 +1,319 @@
+#include "iremit.hpp"
+
+#include <sstream>
+
+namespace azin
+{
+
+// ===== Operands =====
+
+static std::string valueName(ValueId id)
+{
+    return "v" + std::to_string(id);
+}
+
+static std::string cTypeName(TypeId type, const TypeTable& types)
+{
+    return type == INVALID_TYPE ? "void" : types.info(type).cName;
+}
+
+static std::string operandText(const IRFunction& fn, ValueId id, const TypeTable& types)
+{
+    const IRInst& v = fn.values[id];
+
+    switch (v.op)
+    {
+        case IROp::Const:
+        case IROp::Undef:
+        {
+            const TypeInfo& info = types.info(v.type);
+            Wide value = v.op == IROp::Const ? v.imm : 0;
+            CType t;
+
+            if (!cTypeOf(info, t))
+                return "((" + std::string(info.cName) + ")" + wideToString(value) + ")";
+
+            bool isBool = info.base == BaseKind::Bool;
+            std::string text = literalText(value, t, isBool);
+
+            // The most negative value has no literal of its own
+            if (text.empty())
+                return "(" + literalText(value + 1, t, false) + " - 1)";
+
+            return value < 0 ? "(" + text + ")" : text;
+        }
+        case IROp::String: return "\"" + v.text + "\"";
+        case IROp::Param:  return fn.paramNames[static_cast<size_t>(v.imm)];
+        default:           return valueName(id);
+    }
+}
+
+static const char* binaryOperator(IROp op)
+{
+    switch (op)
+    {
+        case IROp::Add:     return "+";
+        case IROp::Sub:     return "-";
+        case IROp::Mul:     return "*";
+        case IROp::Div:     return "/";
+        case IROp::Rem:     return "%";
+        case IROp::Shl:     return "<<";
+        case IROp::Shr:     return ">>";
+        case IROp::And:     return "&";
+        case IROp::Eq:      return "==";
+        case IROp::Ne:      return "!=";
+        case IROp::Lt:      return "<";
+        case IROp::Le:      return "<=";
+        case IROp::Gt:      return ">";
+        case IROp::Ge:      return ">=";
+        case IROp::PtrAdd:  return "+";
+        case IROp::PtrDiff: return "-";
+        default:            return nullptr;
+    }
+}
+
+
+// ===== Functions =====
+
+namespace
+{
+
+class FunctionEmitter
+{
+public:
+    FunctionEmitter(const IRFunction& fn, TypeTable& types) : fn(fn), types(types) {}
+
+    std::string emit()
+    {
+        out << cTypeName(fn.returnType, types) << " " << fn.name << "(";
+
+        for (size_t i = 0; i < fn.paramNames.size(); i++)
+        {
+            out << cTypeName(fn.paramTypes[i], types) << " " << fn.paramNames[i];
+            if (i + 1 < fn.paramNames.size())
+                out << ", ";
+        }
+
+        out << ")\n{\n";
+
+        std::vector<BlockId> order = fn.reversePostorder();
+
+        declareValues(order);
+
+        for (size_t i = 0; i < order.size(); i++)
+            emitBlock(order[i], i + 1 < order.size() ? order[i + 1] : NO_BLOCK);
+
+        out << "}\n\n";
+        return out.str();
+    }
+
+private:
+    const IRFunction& fn;
+    TypeTable& types;
+    std::stringstream out;
+
+    std::string operand(ValueId id) const
+    {
+        return operandText(fn, id, types);
+    }
+
+    void declareValues(const std::vector<BlockId>& order)
+    {
+        for (BlockId b : order)
+        {
+            for (ValueId id : fn.blocks[b].insts)
+            {
+                const IRInst& inst = fn.values[id];
+
+                if (inst.type == INVALID_TYPE || isTerminator(inst.op) || inst.op == IROp::Store)
+                    continue;
+
+                if (inst.op == IROp::Alloca)
+                {
+                    out << "    " << cTypeName(types.pointee(inst.type), types) << " "
+                        << valueName(id) << "[" << wideToString(inst.imm) << "];\n";
+                    continue;
+                }
+
+                std::string type = cTypeName(inst.type, types);
+                out << "    " << type << " " << valueName(id) << ";\n";
+
+                // Phi inputs land here first, so copies on one edge do not
+                // see each other's results
+                if (inst.op == IROp::Phi)
+                    out << "    " << type << " " << valueName(id) << "_next;\n";
+            }
+        }
+    }
+
+    // Copies for the phis of `to` when control comes from `from`
+    void emitPhiCopies(BlockId from, BlockId to)
+    {
+        for (ValueId id : fn.blocks[to].insts)
+        {
+            const IRInst& phi = fn.values[id];
+            if (phi.op != IROp::Phi)
+                break;
+
+            for (size_t i = 0; i < phi.operands.size(); i++)
+            {
+                if (phi.targets[i] == from)
+                    out << "    " << valueName(id) << "_next = " << operand(phi.operands[i]) << ";\n";
+            }
+        }
+    }
+
+    void emitGoto(BlockId from, BlockId to, BlockId next)
+    {
+        emitPhiCopies(from, to);
+
+        if (to != next)
+            out << "    goto bb" << to << ";\n";
+    }
+
+    void emitBlock(BlockId b, BlockId next)
+    {
+        const IRBlock& block = fn.blocks[b];
+
+        if (!block.preds.empty())
+            out << "bb" << b << ":\n";
+
+        for (ValueId id : block.insts)
+        {
+            const IRInst& inst = fn.values[id];
+            std::string name = valueName(id);
+            std::string type = cTypeName(inst.type, types);
+
+            switch (inst.op)
+            {
+                case IROp::Phi:
+                    out << "    " << name << " = " << name << "_next;\n";
+                    break;
+
+                case IROp::Alloca:
+                    break;
+
+                case IROp::Load:
+                    out << "    " << name << " = *" << operand(inst.operands[0]) << ";\n";
+                    break;
+
+                case IROp::Store:
+                    out << "    *" << operand(inst.operands[0]) << " = " << operand(inst.operands[1]) << ";\n";
+                    break;
+
+                case IROp::Neg:
+                    out << "    " << name << " = -" << operand(inst.operands[0]) << ";\n";
+                    break;
+
+                case IROp::Convert:
+                    out << "    " << name << " = (" << type << ")" << operand(inst.operands[0]) << ";\n";
+                    break;
+
+                case IROp::Shl:
+                {
+                    // Shifting a signed value into the sign bit is undefined;
+                    // the unsigned shift wraps like the multiply it replaced
+                    CType t;
+                    cTypeOf(types.info(inst.type), t);
+
+                    if (t.isSigned)
+                    {
+                        std::string u = t.bits == 64 ? "uint64_t" : "uint" + std::to_string(t.bits) + "_t";
+
+                        out << "    " << name << " = (" << type << ")((" << u << ")"
+                            << operand(inst.operands[0]) << " << " << operand(inst.operands[1]) << ");\n";
+                        break;
+                    }
+
+                    out << "    " << name << " = " << operand(inst.operands[0]) << " << "
+                        << operand(inst.operands[1]) << ";\n";
+                    break;
+                }
+
+                case IROp::CheckIndex:
+                    out << "    " << name << " = azin_index(" << operand(inst.operands[0]) << ", "
+                        << wideToString(inst.imm) << ");\n";
+                    break;
+
+                case IROp::Call:
+                    out << "    ";
+                    if (inst.type != INVALID_TYPE)
+                        out << name << " = ";
+
+                    out << inst.text << "(";
+                    for (size_t i = 0; i < inst.operands.size(); i++)
+                    {
+                        out << operand(inst.operands[i]);
+                        if (i + 1 < inst.operands.size())
+                            out << ", ";
+                    }
+                    out << ");\n";
+                    break;
+
+                case IROp::Jump:
+                    emitGoto(b, inst.targets[0], next);
+                    break;
+
+                case IROp::Branch:
+                {
+                    bool copiesThen = hasPhis(inst.targets[0]);
+
+                    out << "    if (" << operand(inst.operands[0]) << ") ";
+
+                    if (copiesThen)
+                    {
+                        out << "{\n";
+                        emitPhiCopies(b, inst.targets[0]);
+                        out << "    goto bb" << inst.targets[0] << ";\n    }\n";
+                    }
+                    else
+                        out << "goto bb" << inst.targets[0] << ";\n";
+
+                    emitGoto(b, inst.targets[1], next);
+                    break;
+                }
+
+                case IROp::Return:
+                    out << "    return";
+                    if (!inst.operands.empty())
+                        out << " " << operand(inst.operands[0]);
+                    out << ";\n";
+                    break;
+
+                default:
+                {
+                    const char* op = binaryOperator(inst.op);
+
+                    out << "    " << name << " = " << operand(inst.operands[0]) << " " << op << " "
+                        << operand(inst.operands[1]) << ";\n";
+                    break;
+                }
+            }
+        }
+    }
+
+    bool hasPhis(BlockId b) const
+    {
+        const auto& insts = fn.blocks[b].insts;
+        return !insts.empty() && fn.values[insts.front()].op == IROp::Phi;
+    }
+};
+
+}
+
+
+// ===== Entry Point =====
+
+std::string generateCFromIR(const Program& program, const IRModule& module, const CodegenOptions& options)
+{
+    std::stringstream out;
+
+    out << CodegenC(program, options).generateDeclarations() << "\n";
+
+    for (const auto& fn : module.functions)
+        out << FunctionEmitter(fn, *module.types).emit();
+
+    return out.str();
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "codegen.hpp"
+#include "ir.hpp"
+
+#include <string>
+
+namespace azin
+{
+
+// C from optimized IR, as a drop-in for CodegenC::generate: the same
+// includes, externs and prototypes, then one function per IR function.
+// SSA values become locals, blocks become labels, and each phi becomes
+// copies on the edges into its block.
+std::string generateCFromIR(const Program& program, const IRModule& module,
+                            const CodegenOptions& options = {});
+
+}
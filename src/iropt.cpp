@@ -0,0 +1,964 @@
+#include "iropt.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace azin
+{
+
+// ===== Helpers =====
+
+static ValueId addConst(IRFunction& fn, Wide value, TypeId type)
+{
+    IRInst inst;
+    inst.op = IROp::Const;
+    inst.type = type;
+    inst.imm = value;
+
+    return fn.add(std::move(inst));
+}
+
+static bool integerType(const TypeTable& types, TypeId type, CType& out)
+{
+    return type != INVALID_TYPE && cTypeOf(types.info(type), out);
+}
+
+static bool isConst(const IRFunction& fn, ValueId v)
+{
+    return fn.values[v].op == IROp::Const;
+}
+
+// k when v is 2^k, else -1
+static int exactLog2(Wide v)
+{
+    if (v <= 0 || (v & (v - 1)) != 0)
+        return -1;
+
+    int k = 0;
+    while ((Wide(1) << k) != v)
+        k++;
+
+    return k;
+}
+
+// The object a pointer was derived from: an Alloca, String, Param, Load,
+// Call or Phi
+static ValueId baseOf(const IRFunction& fn, ValueId v)
+{
+    while (fn.values[v].op == IROp::PtrAdd || fn.values[v].op == IROp::Convert)
+        v = fn.values[v].operands[0];
+
+    return v;
+}
+
+// Allocas whose address is only ever loaded from and stored to, so no
+// call and no other pointer can reach them
+static std::unordered_set<ValueId> privateAllocas(const IRFunction& fn, const TypeTable& types)
+{
+    std::unordered_set<ValueId> allocas;
+    std::unordered_set<ValueId> escaping;
+
+    auto escape = [&](ValueId v)
+    {
+        ValueId base = baseOf(fn, v);
+
+        if (fn.values[base].op == IROp::Alloca)
+            escaping.insert(base);
+    };
+
+    for (const auto& block : fn.blocks)
+    {
+        if (block.removed)
+            continue;
+
+        for (ValueId id : block.insts)
+        {
+            const IRInst& inst = fn.values[id];
+
+            switch (inst.op)
+            {
+                case IROp::Alloca:
+                    allocas.insert(id);
+                    break;
+                case IROp::Call:
+                case IROp::Return:
+                case IROp::Phi:
+                    for (ValueId op : inst.operands)
+                        escape(op);
+                    break;
+                case IROp::Store:
+                    escape(inst.operands[1]);
+                    break;
+                case IROp::Convert:
+                    if (!types.info(inst.type).isPointer)
+                        escape(inst.operands[0]);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    for (ValueId id : escaping)
+        allocas.erase(id);
+
+    return allocas;
+}
+
+// Functions whose calls change nothing the caller can observe: they store
+// only to their own private allocas and call only such functions
+static std::unordered_set<std::string> findPureFunctions(const IRModule& module)
+{
+    std::unordered_map<std::string, std::unordered_set<std::string>> callees;
+    std::unordered_set<std::string> pure;
+
+    for (const auto& fn : module.functions)
+    {
+        auto own = privateAllocas(fn, *module.types);
+        bool writesShared = false;
+
+        for (const auto& block : fn.blocks)
+        {
+            if (block.removed)
+                continue;
+
+            for (ValueId id : block.insts)
+            {
+                const IRInst& inst = fn.values[id];
+
+                if (inst.op == IROp::Store && !own.count(baseOf(fn, inst.operands[0])))
+                    writesShared = true;
+                else if (inst.op == IROp::Call)
+                    callees[fn.name].insert(inst.text);
+            }
+        }
+
+        if (!writesShared)
+            pure.insert(fn.name);
+    }
+
+    // Externs are never in the module, so calling one makes a caller impure
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (auto it = pure.begin(); it != pure.end();)
+        {
+            bool callsImpure = false;
+
+            for (const auto& callee : callees[*it])
+            {
+                if (!pure.count(callee))
+                {
+                    callsImpure = true;
+                    break;
+                }
+            }
+
+            if (callsImpure)
+            {
+                it = pure.erase(it);
+                changed = true;
+            }
+            else
+                ++it;
+        }
+    }
+
+    return pure;
+}
+
+
+// ===== simplify =====
+
+// x op y in C type t; false when C leaves it undefined
+static bool foldArithmetic(IROp op, Wide x, Wide y, CType t, Wide& out)
+{
+    Wide r;
+
+    switch (op)
+    {
+        case IROp::Add: r = x + y; break;
+        case IROp::Sub: r = x - y; break;
+        case IROp::Mul:
+        {
+            using Unsigned = unsigned __int128;
+
+            if (t.isSigned)
+                r = x * y;
+            else
+                r = static_cast<Wide>((static_cast<Unsigned>(x) * static_cast<Unsigned>(y)) &
+                                      static_cast<Unsigned>(typeMax(t)));
+            break;
+        }
+        case IROp::Div:
+        case IROp::Rem:
+            if (y == 0)
+                return false;
+            r = op == IROp::Div ? x / y : x % y;
+            break;
+        case IROp::Shl:
+            // Emitted through the unsigned type, so it wraps
+            if (y < 0 || y >= t.bits)
+                return false;
+            out = wrap(x * (Wide(1) << static_cast<int>(y)), t);
+            return true;
+        case IROp::Shr:
+            if (y < 0 || y >= t.bits)
+                return false;
+            r = x >> static_cast<int>(y);
+            break;
+        case IROp::And:
+            r = x & y;
+            break;
+        default:
+            return false;
+    }
+
+    if (t.isSigned && (r < typeMin(t) || r > typeMax(t)))
+        return false;
+
+    out = wrap(r, t);
+    return true;
+}
+
+static bool compareConstants(IROp op, Wide x, Wide y)
+{
+    switch (op)
+    {
+        case IROp::Eq: return x == y;
+        case IROp::Ne: return x != y;
+        case IROp::Lt: return x < y;
+        case IROp::Le: return x <= y;
+        case IROp::Gt: return x > y;
+        default:       return x >= y;
+    }
+}
+
+// The value that replaces id, id itself when it was rewritten in place,
+// or NO_VALUE when nothing changed
+static ValueId simplifyInst(IRFunction& fn, const TypeTable& types, ValueId id)
+{
+    const IRInst inst = fn.values[id];
+    CType t;
+
+    if (inst.op == IROp::Convert)
+    {
+        CType from;
+        const IRInst& operand = fn.values[inst.operands[0]];
+
+        if (operand.op != IROp::Const || !integerType(types, operand.type, from) ||
+            !integerType(types, inst.type, t))
+            return NO_VALUE;
+
+        return addConst(fn, t.bits == 1 ? Wide(operand.imm != 0) : wrap(operand.imm, t), inst.type);
+    }
+
+    if (inst.op == IROp::Neg)
+    {
+        if (!isConst(fn, inst.operands[0]) || !integerType(types, inst.type, t))
+            return NO_VALUE;
+
+        Wide r;
+        if (!foldArithmetic(IROp::Sub, 0, fn.values[inst.operands[0]].imm, t, r))
+            return NO_VALUE;
+
+        return addConst(fn, r, inst.type);
+    }
+
+    bool isCompare = inst.op >= IROp::Eq && inst.op <= IROp::Ge;
+    bool isArithmetic = inst.op >= IROp::Add && inst.op <= IROp::And;
+
+    if (!isCompare && !isArithmetic)
+        return NO_VALUE;
+
+    ValueId a = inst.operands[0];
+    ValueId b = inst.operands[1];
+
+    if (!integerType(types, fn.values[a].type, t))
+        return NO_VALUE;
+
+    bool constA = isConst(fn, a);
+    bool constB = isConst(fn, b);
+    Wide x = fn.values[a].imm;
+    Wide y = fn.values[b].imm;
+
+    if (constA && constB)
+    {
+        if (isCompare)
+            return addConst(fn, compareConstants(inst.op, x, y), inst.type);
+
+        Wide r;
+        if (!foldArithmetic(inst.op, x, y, t, r))
+            return NO_VALUE;
+
+        return addConst(fn, r, inst.type);
+    }
+
+    if (isCompare)
+        return NO_VALUE;
+
+    switch (inst.op)
+    {
+        case IROp::Add:
+            if (constB && y == 0) return a;
+            if (constA && x == 0) return b;
+            break;
+
+        case IROp::Sub:
+            if (constB && y == 0) return a;
+            break;
+
+        case IROp::Mul:
+        {
+            if (!constA && !constB)
+                break;
+
+            ValueId other = constB ? a : b;
+            Wide c = constB ? y : x;
+
+            if (c == 0) return addConst(fn, 0, inst.type);
+            if (c == 1) return other;
+
+            int k = exactLog2(c);
+            if (k <= 0)
+                break;
+
+            ValueId shift = addConst(fn, k, inst.type);
+
+            IRInst& reduced = fn.values[id];
+            reduced.op = IROp::Shl;
+            reduced.operands = { other, shift };
+            return id;
+        }
+
+        case IROp::Div:
+        case IROp::Rem:
+        {
+            if (!constB)
+                break;
+
+            if (y == 1)
+                return inst.op == IROp::Div ? a : addConst(fn, 0, inst.type);
+
+            // Signed division rounds toward zero, so only unsigned maps
+            // onto a shift or a mask
+            int k = exactLog2(y);
+            if (k <= 0 || t.isSigned)
+                break;
+
+            ValueId operand = addConst(fn, inst.op == IROp::Div ? Wide(k) : y - 1, inst.type);
+
+            IRInst& reduced = fn.values[id];
+            reduced.op = inst.op == IROp::Div ? IROp::Shr : IROp::And;
+            reduced.operands = { a, operand };
+            return id;
+        }
+
+        default:
+            break;
+    }
+
+    return NO_VALUE;
+}
+
+static size_t simplify(IRFunction& fn, const TypeTable& types)
+{
+    std::unordered_map<ValueId, ValueId> replacements;
+    size_t count = 0;
+
+    auto resolve = [&](ValueId v)
+    {
+        for (auto it = replacements.find(v); it != replacements.end(); it = replacements.find(v))
+            v = it->second;
+        return v;
+    };
+
+    for (BlockId b : fn.reversePostorder())
+    {
+        std::vector<ValueId> insts = fn.blocks[b].insts;
+
+        for (ValueId id : insts)
+        {
+            for (auto& op : fn.values[id].operands)
+                op = resolve(op);
+
+            ValueId result = simplifyInst(fn, types, id);
+
+            if (result == NO_VALUE)
+                continue;
+
+            count++;
+
+            if (result != id)
+            {
+                replacements[id] = result;
+                removeInst(fn, id);
+            }
+        }
+    }
+
+    replaceUses(fn, replacements);
+    return count;
+}
+
+
+// ===== cse =====
+
+static std::string operandKey(const IRFunction& fn, ValueId v)
+{
+    const IRInst& inst = fn.values[v];
+
+    // Equal constants are separate values; compare them by contents
+    if (inst.op == IROp::Const)
+        return "#" + std::to_string(inst.type) + ":" + wideToString(inst.imm);
+
+    return "%" + std::to_string(v);
+}
+
+static bool isCommutative(IROp op)
+{
+    return op == IROp::Add || op == IROp::Mul || op == IROp::And ||
+           op == IROp::Eq || op == IROp::Ne;
+}
+
+static std::string valueKey(const IRFunction& fn, const IRInst& inst)
+{
+    std::vector<std::string> operands;
+    for (ValueId op : inst.operands)
+        operands.push_back(operandKey(fn, op));
+
+    if (isCommutative(inst.op))
+        std::sort(operands.begin(), operands.end());
+
+    std::string key = irOpName(inst.op);
+    key += " " + std::to_string(inst.type) + " " + wideToString(inst.imm);
+
+    for (const auto& op : operands)
+        key += " " + op;
+
+    return key;
+}
+
+static size_t eliminateCommonSubexpressions(IRFunction& fn)
+{
+    fn.computePredecessors();
+
+    std::vector<BlockId> order = fn.reversePostorder();
+    std::vector<BlockId> idom = computeDominators(fn);
+    std::vector<std::vector<BlockId>> children(fn.blocks.size());
+
+    for (BlockId b : order)
+    {
+        if (b != 0)
+            children[idom[b]].push_back(b);
+    }
+
+    std::unordered_map<std::string, ValueId> available;
+    std::unordered_map<ValueId, ValueId> replacements;
+    size_t count = 0;
+
+    auto resolve = [&](ValueId v)
+    {
+        for (auto it = replacements.find(v); it != replacements.end(); it = replacements.find(v))
+            v = it->second;
+        return v;
+    };
+
+    // Preorder over the dominator tree; what a block makes available is
+    // visible to the blocks it dominates and withdrawn after them
+    struct Visit
+    {
+        BlockId block;
+        std::vector<std::string> added;
+        size_t nextChild = 0;
+    };
+
+    std::vector<Visit> stack;
+    stack.push_back({ 0, {} });
+
+    auto enter = [&](Visit& visit)
+    {
+        // Loads are reused within the block, until memory may change
+        std::unordered_map<std::string, ValueId> loads;
+
+        std::vector<ValueId> insts = fn.blocks[visit.block].insts;
+
+        for (ValueId id : insts)
+        {
+            for (auto& op : fn.values[id].operands)
+                op = resolve(op);
+
+            const IRInst& inst = fn.values[id];
+
+            if (inst.op == IROp::Store)
+            {
+                // The stored value is what a load from the same address reads
+                loads.clear();
+                loads[operandKey(fn, inst.operands[0])] = inst.operands[1];
+                continue;
+            }
+
+            if (inst.op == IROp::Call)
+            {
+                loads.clear();
+                continue;
+            }
+
+            if (inst.op == IROp::Load)
+            {
+                std::string key = operandKey(fn, inst.operands[0]);
+                auto found = loads.find(key);
+
+                if (found != loads.end() && fn.values[found->second].type == inst.type)
+                {
+                    replacements[id] = found->second;
+                    removeInst(fn, id);
+                    count++;
+                }
+                else
+                    loads[key] = id;
+
+                continue;
+            }
+
+            if (!isPureValue(inst.op) && inst.op != IROp::CheckIndex)
+                continue;
+
+            std::string key = valueKey(fn, inst);
+            auto found = available.find(key);
+
+            if (found != available.end())
+            {
+                replacements[id] = found->second;
+                removeInst(fn, id);
+                count++;
+            }
+            else
+            {
+                available[key] = id;
+                visit.added.push_back(std::move(key));
+            }
+        }
+    };
+
+    enter(stack.back());
+
+    while (!stack.empty())
+    {
+        Visit& top = stack.back();
+
+        if (top.nextChild < children[top.block].size())
+        {
+            BlockId child = children[top.block][top.nextChild++];
+            stack.push_back({ child, {} });
+            enter(stack.back());
+            continue;
+        }
+
+        for (const auto& key : top.added)
+            available.erase(key);
+
+        stack.pop_back();
+    }
+
+    replaceUses(fn, replacements);
+    return count;
+}
+
+
+// ===== licm =====
+
+namespace
+{
+
+struct Loop
+{
+    BlockId header;
+    std::vector<bool> body;
+    size_t size = 0;
+};
+
+}
+
+// Safe to compute early even when the loop would not have reached it:
+// no traps and nothing C leaves undefined
+static bool isSpeculatable(const IRInst& inst, const TypeTable& types)
+{
+    if (!isPureValue(inst.op) || inst.op == IROp::Div || inst.op == IROp::Rem)
+        return false;
+
+    // Signed overflow is undefined, so signed arithmetic stays where it was
+    CType t;
+    bool arithmetic = inst.op == IROp::Add || inst.op == IROp::Sub ||
+                      inst.op == IROp::Mul || inst.op == IROp::Neg;
+
+    return !(arithmetic && integerType(types, inst.type, t) && t.isSigned);
+}
+
+static size_t hoistLoopInvariants(IRFunction& fn, const TypeTable& types,
+                                  const std::unordered_set<std::string>& pure)
+{
+    fn.computePredecessors();
+
+    std::vector<BlockId> order = fn.reversePostorder();
+    std::vector<BlockId> idom = computeDominators(fn);
+
+    // Natural loops, one per header, from their back edges
+    std::vector<Loop> loops;
+    std::unordered_map<BlockId, size_t> loopOf;
+
+    for (BlockId b : order)
+    {
+        for (BlockId succ : fn.successors(b))
+        {
+            if (!dominates(idom, succ, b))
+                continue;
+
+            if (!loopOf.count(succ))
+            {
+                loopOf[succ] = loops.size();
+                loops.push_back({ succ, std::vector<bool>(fn.blocks.size(), false) });
+                loops.back().body[succ] = true;
+                loops.back().size = 1;
+            }
+
+            Loop& loop = loops[loopOf[succ]];
+            std::vector<BlockId> work = { b };
+
+            while (!work.empty())
+            {
+                BlockId x = work.back();
+                work.pop_back();
+
+                if (loop.body[x])
+                    continue;
+
+                loop.body[x] = true;
+                loop.size++;
+
+                for (BlockId pred : fn.blocks[x].preds)
+                    work.push_back(pred);
+            }
+        }
+    }
+
+    // Inner loops first, so their invariants can move on outward
+    std::sort(loops.begin(), loops.end(),
+        [](const Loop& a, const Loop& b) { return a.size < b.size; });
+
+    std::unordered_set<ValueId> own = privateAllocas(fn, types);
+    size_t count = 0;
+
+    for (const Loop& loop : loops)
+    {
+        std::vector<BlockId> outside;
+        for (BlockId pred : fn.blocks[loop.header].preds)
+        {
+            if (!loop.body[pred])
+                outside.push_back(pred);
+        }
+
+        if (outside.size() != 1 || fn.terminator(outside[0]).op != IROp::Jump)
+            continue;
+
+        BlockId preheader = outside[0];
+
+        bool storesShared = false;
+        bool callsImpure = false;
+        std::unordered_set<ValueId> storedBases;
+
+        for (BlockId b : order)
+        {
+            if (!loop.body[b])
+                continue;
+
+            for (ValueId id : fn.blocks[b].insts)
+            {
+                const IRInst& inst = fn.values[id];
+
+                if (inst.op == IROp::Store)
+                {
+                    ValueId base = baseOf(fn, inst.operands[0]);
+                    storedBases.insert(base);
+                    storesShared = storesShared || !own.count(base);
+                }
+                else if (inst.op == IROp::Call && !pure.count(inst.text))
+                    callsImpure = true;
+            }
+        }
+
+        auto inLoop = [&](ValueId v)
+        {
+            BlockId block = fn.values[v].block;
+            return block != NO_BLOCK && loop.body[block];
+        };
+
+        auto readsUnchanged = [&](const IRInst& inst)
+        {
+            if (inst.op == IROp::Load)
+            {
+                ValueId base = baseOf(fn, inst.operands[0]);
+
+                if (own.count(base))
+                    return !storedBases.count(base);
+
+                return !storesShared && !callsImpure;
+            }
+
+            if (inst.op == IROp::Call)
+            {
+                // Without a result, hoisting a call saves nothing
+                if (!pure.count(inst.text) || inst.type == INVALID_TYPE)
+                    return false;
+
+                for (ValueId arg : inst.operands)
+                {
+                    if (types.info(fn.values[arg].type).isPointer)
+                        return !storesShared && !callsImpure;
+                }
+
+                return true;
+            }
+
+            // Division, signed arithmetic and bounds checks read nothing
+            return inst.op != IROp::Alloca && inst.op != IROp::Store && inst.op != IROp::Phi;
+        };
+
+        bool changed = true;
+
+        while (changed)
+        {
+            changed = false;
+
+            for (BlockId b : order)
+            {
+                if (!loop.body[b])
+                    continue;
+
+                // Anything that may trap or read memory moves only from
+                // the top of the header, where nothing ran before it
+                bool ranBefore = false;
+                std::vector<ValueId> insts = fn.blocks[b].insts;
+
+                for (ValueId id : insts)
+                {
+                    const IRInst& inst = fn.values[id];
+
+                    if (isTerminator(inst.op) || inst.op == IROp::Phi)
+                        continue;
+
+                    bool invariant = std::none_of(inst.operands.begin(), inst.operands.end(), inLoop);
+                    bool speculatable = isSpeculatable(inst, types);
+
+                    bool hoist = invariant &&
+                        (speculatable || (b == loop.header && !ranBefore && readsUnchanged(inst)));
+
+                    if (!hoist)
+                    {
+                        if (!speculatable)
+                            ranBefore = true;
+                        continue;
+                    }
+
+                    removeInst(fn, id);
+
+                    auto& target = fn.blocks[preheader].insts;
+                    target.insert(target.end() - 1, id);
+                    fn.values[id].block = preheader;
+
+                    count++;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+
+// ===== dce =====
+
+static size_t eliminateDeadCode(IRFunction& fn)
+{
+    size_t removed = 0;
+
+    // Branches on constants only ever take one way
+    for (auto& block : fn.blocks)
+    {
+        if (block.removed || block.insts.empty())
+            continue;
+
+        IRInst& term = fn.values[block.insts.back()];
+        if (term.op != IROp::Branch)
+            continue;
+
+        const IRInst& condition = fn.values[term.operands[0]];
+
+        if (condition.op == IROp::Const || term.targets[0] == term.targets[1])
+        {
+            BlockId taken = condition.op == IROp::Const && condition.imm == 0
+                ? term.targets[1] : term.targets[0];
+
+            term.op = IROp::Jump;
+            term.operands.clear();
+            term.targets = { taken };
+        }
+    }
+
+    // Unreachable blocks
+    std::vector<bool> reachable(fn.blocks.size(), false);
+    for (BlockId b : fn.reversePostorder())
+        reachable[b] = true;
+
+    for (BlockId b = 0; b < fn.blocks.size(); b++)
+    {
+        IRBlock& block = fn.blocks[b];
+
+        if (reachable[b] || block.removed)
+            continue;
+
+        for (ValueId id : block.insts)
+            fn.values[id].block = NO_BLOCK;
+
+        removed += block.insts.size();
+        block.insts.clear();
+        block.removed = true;
+    }
+
+    fn.computePredecessors();
+
+    // Phi operands for edges that are gone
+    for (auto& block : fn.blocks)
+    {
+        if (block.removed)
+            continue;
+
+        for (ValueId id : block.insts)
+        {
+            IRInst& phi = fn.values[id];
+            if (phi.op != IROp::Phi)
+                break;
+
+            std::vector<ValueId> operands;
+            std::vector<BlockId> targets;
+
+            for (size_t i = 0; i < phi.operands.size(); i++)
+            {
+                bool edge = std::find(block.preds.begin(), block.preds.end(), phi.targets[i]) != block.preds.end();
+                bool seen = std::find(targets.begin(), targets.end(), phi.targets[i]) != targets.end();
+
+                if (edge && !seen)
+                {
+                    operands.push_back(phi.operands[i]);
+                    targets.push_back(phi.targets[i]);
+                }
+            }
+
+            phi.operands = std::move(operands);
+            phi.targets = std::move(targets);
+        }
+    }
+
+    removeTrivialPhis(fn);
+
+    // Everything with an effect is live, and so is whatever it uses
+    std::vector<bool> live(fn.values.size(), false);
+    std::vector<ValueId> work;
+
+    for (const auto& block : fn.blocks)
+    {
+        for (ValueId id : block.insts)
+        {
+            if (hasSideEffects(fn.values[id].op))
+            {
+                live[id] = true;
+                work.push_back(id);
+            }
+        }
+    }
+
+    while (!work.empty())
+    {
+        ValueId id = work.back();
+        work.pop_back();
+
+        for (ValueId op : fn.values[id].operands)
+        {
+            if (!live[op])
+            {
+                live[op] = true;
+                work.push_back(op);
+            }
+        }
+    }
+
+    for (auto& block : fn.blocks)
+    {
+        std::vector<ValueId> kept;
+
+        for (ValueId id : block.insts)
+        {
+            if (live[id])
+                kept.push_back(id);
+            else
+            {
+                fn.values[id].block = NO_BLOCK;
+                removed++;
+            }
+        }
+
+        block.insts = std::move(kept);
+    }
+
+    return removed;
+}
+
+
+// ===== Pipeline =====
+
+IROptStats optimizeIR(IRModule& module, std::ostream* dump)
+{
+    IROptStats stats;
+    const TypeTable& types = *module.types;
+
+    auto dumpIR = [&](const char* title)
+    {
+        if (!dump)
+            return;
+
+        *dump << "; ===== IR " << title << " =====\n\n";
+        printIR(module, *dump);
+    };
+
+    dumpIR("before optimization");
+
+    for (auto& fn : module.functions)
+        stats.simplified += simplify(fn, types);
+
+    dumpIR("after simplify");
+
+    for (auto& fn : module.functions)
+        stats.eliminated += eliminateCommonSubexpressions(fn);
+
+    dumpIR("after cse");
+
+    std::unordered_set<std::string> pure = findPureFunctions(module);
+
+    for (auto& fn : module.functions)
+        stats.hoisted += hoistLoopInvariants(fn, types, pure);
+
+    dumpIR("after licm");
+
+    for (auto& fn : module.functions)
+        stats.removed += eliminateDeadCode(fn);
+
+    dumpIR("after dce");
+
+    return stats;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstddef>
+#include <ostream>
+
+namespace azin
+{
+
+struct IROptStats
+{
+    size_t simplified = 0;   // instructions strength-reduced or folded
+    size_t eliminated = 0;   // common subexpressions replaced by an earlier value
+    size_t hoisted = 0;      // loop-invariant instructions moved to the preheader
+    size_t removed = 0;      // dead instructions and unreachable blocks' contents
+};
+
+// Runs, over every function:
+//   simplify - folds constant operations and reduces strength (x * 8 to
+//              x << 3, unsigned x / 8 to x >> 3, x * 1 to x)
+//   cse      - replaces pure operations, bounds checks and loads already
+//              computed on every path (dominator-scoped value numbering)
+//   licm     - moves loop-invariant work to the loop preheader: arithmetic
+//              that cannot trap from anywhere in the loop, and from the
+//              top of the header also loads and calls to functions without
+//              side effects whose inputs the loop cannot change, such as
+//              strlen(msg) in a condition
+//   dce      - folds constant branches, drops unreachable blocks and
+//              instructions whose values are never used
+//
+// With dump set, prints the IR before the first pass and after each one.
+IROptStats optimizeIR(IRModule& module, std::ostream* dump = nullptr);
+
+}
@@ -0,0 +1,434 @@
+#include "json.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace azin
+{
+
+// ===== Access =====
+
+Json Json::array()
+{
+    Json value;
+    value.kind = Kind::Array;
+    return value;
+}
+
+Json Json::object()
+{
+    Json value;
+    value.kind = Kind::Object;
+    return value;
+}
+
+const Json& Json::operator[](const std::string& key) const
+{
+    static const Json null;
+
+    for (const auto& member : members)
+    {
+        if (member.first == key)
+            return member.second;
+    }
+
+    return null;
+}
+
+const Json& Json::operator[](size_t index) const
+{
+    static const Json null;
+
+    return index < items.size() ? items[index] : null;
+}
+
+size_t Json::size() const
+{
+    return kind == Kind::Object ? members.size() : items.size();
+}
+
+const std::string& Json::asString() const
+{
+    static const std::string empty;
+
+    return kind == Kind::String ? text : empty;
+}
+
+Json& Json::set(const std::string& key, Json value)
+{
+    kind = Kind::Object;
+
+    for (auto& member : members)
+    {
+        if (member.first == key)
+        {
+            member.second = std::move(value);
+            return *this;
+        }
+    }
+
+    members.emplace_back(key, std::move(value));
+    return *this;
+}
+
+Json& Json::push(Json value)
+{
+    kind = Kind::Array;
+    items.push_back(std::move(value));
+    return *this;
+}
+
+
+// ===== Parsing =====
+
+namespace
+{
+
+class JsonParser
+{
+public:
+    explicit JsonParser(const std::string& source) : source(source) {}
+
+    Json parseDocument()
+    {
+        Json value = parseValue();
+        skipWhitespace();
+
+        if (position != source.size())
+            throw error("trailing characters");
+
+        return value;
+    }
+
+private:
+    const std::string& source;
+    size_t position = 0;
+
+    std::runtime_error error(const std::string& message) const
+    {
+        return std::runtime_error("Invalid JSON at offset " + std::to_string(position) + ": " + message);
+    }
+
+    void skipWhitespace()
+    {
+        while (position < source.size() &&
+               (source[position] == ' ' || source[position] == '\t' ||
+                source[position] == '\n' || source[position] == '\r'))
+            position++;
+    }
+
+    bool consumeWord(const char* word)
+    {
+        size_t length = std::char_traits<char>::length(word);
+
+        if (source.compare(position, length, word) != 0)
+            return false;
+
+        position += length;
+        return true;
+    }
+
+    void expect(char c)
+    {
+        skipWhitespace();
+
+        if (position >= source.size() || source[position] != c)
+            throw error(std::string("expected '") + c + "'");
+
+        position++;
+    }
+
+    Json parseValue()
+    {
+        skipWhitespace();
+
+        if (position >= source.size())
+            throw error("unexpected end");
+
+        char c = source[position];
+
+        if (c == '{') return parseObject();
+        if (c == '[') return parseArray();
+        if (c == '"') return Json(parseString());
+
+        if (consumeWord("true"))  return Json(true);
+        if (consumeWord("false")) return Json(false);
+        if (consumeWord("null"))  return Json();
+
+        const char* start = source.c_str() + position;
+        char* end = nullptr;
+        double number = std::strtod(start, &end);
+
+        if (end == start)
+            throw error("unexpected character");
+
+        position += end - start;
+        return Json(number);
+    }
+
+    Json parseObject()
+    {
+        Json object = Json::object();
+        expect('{');
+        skipWhitespace();
+
+        if (position < source.size() && source[position] == '}')
+        {
+            position++;
+            return object;
+        }
+
+        while (true)
+        {
+            skipWhitespace();
+
+            if (position >= source.size() || source[position] != '"')
+                throw error("expected a member name");
+
+            std::string key = parseString();
+            expect(':');
+            object.set(key, parseValue());
+
+            skipWhitespace();
+
+            if (position < source.size() && source[position] == ',')
+            {
+                position++;
+                continue;
+            }
+
+            expect('}');
+            return object;
+        }
+    }
+
+    Json parseArray()
+    {
+        Json array = Json::array();
+        expect('[');
+        skipWhitespace();
+
+        if (position < source.size() && source[position] == ']')
+        {
+            position++;
+            return array;
+        }
+
+        while (true)
+        {
+            array.push(parseValue());
+            skipWhitespace();
+
+            if (position < source.size() && source[position] == ',')
+            {
+                position++;
+                continue;
+            }
+
+            expect(']');
+            return array;
+        }
+    }
+
+    unsigned parseHex4()
+    {
+        if (position + 4 > source.size())
+            throw error("truncated \\u escape");
+
+        unsigned value = 0;
+
+        for (int i = 0; i < 4; i++)
+        {
+            char c = source[position++];
+            value <<= 4;
+
+            if (c >= '0' && c <= '9')      value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else throw error("bad \\u escape");
+        }
+
+        return value;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code)
+    {
+        if (code < 0x80)
+            out += static_cast<char>(code);
+        else if (code < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    std::string parseString()
+    {
+        position++;   // opening quote
+        std::string out;
+
+        while (true)
+        {
+            if (position >= source.size())
+                throw error("unterminated string");
+
+            char c = source[position++];
+
+            if (c == '"')
+                return out;
+
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+
+            if (position >= source.size())
+                throw error("unterminated string");
+
+            char escape = source[position++];
+
+            switch (escape)
+            {
+                case '"':  out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/'; break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u':
+                {
+                    unsigned code = parseHex4();
+
+                    // A surrogate pair spells one code point outside the BMP
+                    if (code >= 0xD800 && code < 0xDC00 && source.compare(position, 2, "\\u") == 0)
+                    {
+                        position += 2;
+                        unsigned low = parseHex4();
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    appendUtf8(out, code);
+                    break;
+                }
+                default:
+                    throw error("bad escape");
+            }
+        }
+    }
+};
+
+}
+
+Json Json::parse(const std::string& source)
+{
+    return JsonParser(source).parseDocument();
+}
+
+
+// ===== Writing =====
+
+static void dumpString(const std::string& text, std::string& out)
+{
+    static const char HEX[] = "0123456789abcdef";
+
+    out += '"';
+
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out += "\\u00";
+                    out += HEX[(c >> 4) & 0xF];
+                    out += HEX[c & 0xF];
+                }
+                else
+                    out += c;
+        }
+    }
+
+    out += '"';
+}
+
+void Json::dump(std::string& out) const
+{
+    switch (kind)
+    {
+        case Kind::Null:
+            out += "null";
+            break;
+
+        case Kind::Bool:
+            out += boolean ? "true" : "false";
+            break;
+
+        case Kind::Number:
+            // Ids, lines and columns are integers; print them without a fraction
+            if (std::floor(number) == number && std::fabs(number) < 9007199254740992.0)
+                out += std::to_string(static_cast<int64_t>(number));
+            else
+                out += std::to_string(number);
+            break;
+
+        case Kind::String:
+            dumpString(text, out);
+            break;
+
+        case Kind::Array:
+            out += '[';
+            for (size_t i = 0; i < items.size(); i++)
+            {
+                if (i > 0)
+                    out += ',';
+                items[i].dump(out);
+            }
+            out += ']';
+            break;
+
+        case Kind::Object:
+            out += '{';
+            for (size_t i = 0; i < members.size(); i++)
+            {
+                if (i > 0)
+                    out += ',';
+                dumpString(members[i].first, out);
+                out += ':';
+                members[i].second.dump(out);
+            }
+            out += '}';
+            break;
+    }
+}
+
+std::string Json::dump() const
+{
+    std::string out;
+    dump(out);
+    return out;
+}
+
+}
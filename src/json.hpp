@@ -0,0 +1,60 @@
+#pragma once
+
+// Just enough JSON for the language server's JSON-RPC messages
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace azin
+{
+
+class Json
+{
+public:
+    enum class Kind { Null, Bool, Number, String, Array, Object };
+
+    Json() = default;
+    Json(bool value) : kind(Kind::Bool), boolean(value) {}
+    Json(int value) : kind(Kind::Number), number(value) {}
+    Json(int64_t value) : kind(Kind::Number), number(static_cast<double>(value)) {}
+    Json(double value) : kind(Kind::Number), number(value) {}
+    Json(const char* value) : kind(Kind::String), text(value) {}
+    Json(std::string value) : kind(Kind::String), text(std::move(value)) {}
+
+    static Json array();
+    static Json object();
+
+    // Throws std::runtime_error on malformed input
+    static Json parse(const std::string& source);
+    std::string dump() const;
+
+    Kind type() const { return kind; }
+    bool isNull() const { return kind == Kind::Null; }
+
+    // Reading a missing member, or a value of another kind, gives null or
+    // a default, so optional fields need no checks
+    const Json& operator[](const std::string& key) const;
+    const Json& operator[](size_t index) const;
+    size_t size() const;
+
+    bool asBool() const { return kind == Kind::Bool && boolean; }
+    int64_t asInt() const { return kind == Kind::Number ? static_cast<int64_t>(number) : 0; }
+    const std::string& asString() const;
+
+    Json& set(const std::string& key, Json value);   // objects
+    Json& push(Json value);                          // arrays
+
+private:
+    Kind kind = Kind::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;   // in insertion order
+
+    void dump(std::string& out) const;
+};
+
+}
@@ -239,13 +239,14 @@ namespace azin
     }
 
     TokenType Lexer::resolveKeyword(const std::string& text) {
-        static std::unordered_map<std::string, TokenType> keywords = {
+        static const std::unordered_map<std::string, TokenType> keywords = {
             {"return", TokenType::RETURN},
             {"if",     TokenType::IF},
             {"else",   TokenType::ELSE},
             {"while",  TokenType::WHILE},
             {"for",    TokenType::FOR},
             {"extern", TokenType::EXTERN},
+            {"export", TokenType::EXPORT},
 
             {"int",    TokenType::TYPE_INT},
             {"i8",  TokenType::TYPE_I8},
@@ -21,6 +21,7 @@ namespace azin
         WHILE,
         FOR,
         EXTERN,
+        EXPORT,
 
 
         // Types
@@ -0,0 +1,988 @@
+#include "lsp.hpp"
+#include "callgraph.hpp"
+#include "json.hpp"
+#include "lexer.hpp"
+#include "module.hpp"
+#include "parser.hpp"
+#include "semantic.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace azin
+{
+
+namespace
+{
+
+// ===== Documents =====
+
+// One top-level declaration and the text it was parsed from
+struct Chunk
+{
+    std::string text;
+    size_t offset = 0;  // where text starts in the document
+    int line = 0;       // the same, as a 0-based line and column
+    int column = 0;
+
+    std::optional<TopLevelDecl> decl;           // empty if it did not parse
+    std::string signature;                      // functions only
+    std::vector<std::string> callees;           // as the analyzer looks them up
+    bool fresh = true;                          // parsed since the last analysis
+
+    // Parse, semantic or module error; empty if none. Messages of the form
+    // "... at file:line:column -> ..." give a position inside text
+    // (1-based); the others are reported on the declaration's first line.
+    std::string error;
+    int errorLine = 0;
+    int errorColumn = 0;
+    bool duplicate = false;     // a function of this name was declared earlier
+};
+
+struct Document
+{
+    std::string path;
+    std::string text;
+    std::vector<Chunk> chunks;          // in document order
+
+    // Functions edited away since the last analysis, as (name, signature)
+    std::vector<std::pair<std::string, std::string>> removed;
+
+    Program modules;                    // declarations from !use, and the type table
+    std::vector<std::string> uses;      // what modules was loaded for
+    bool modulesStale = true;
+
+    SemanticAnalyzer analyzer{ 1 };
+};
+
+// Cuts text[begin, end) into top-level declarations without lexing it:
+// one ends at the '}' closing its body, at a ';' outside braces (extern)
+// or at the end of a !use line. Strings, characters and comments are
+// skipped, so braces inside them do not count. `line` and `column` are
+// the position of begin. `complete` is false when the text ends inside a
+// declaration.
+static std::vector<Chunk> splitDeclarations(const std::string& text, size_t begin, size_t end,
+                                            int line, int column, bool& complete)
+{
+    std::vector<Chunk> chunks;
+
+    size_t start = begin;
+    int startLine = 0;
+    int startColumn = 0;
+    bool started = false;
+
+    int depth = 0;
+    bool inUse = false;
+
+    auto cut = [&](size_t at)
+    {
+        if (started)
+        {
+            Chunk chunk;
+            chunk.text = text.substr(start, at - start);
+            chunk.offset = start;
+            chunk.line = startLine;
+            chunk.column = startColumn;
+            chunks.push_back(std::move(chunk));
+        }
+
+        started = false;
+        inUse = false;
+        depth = 0;
+    };
+
+    size_t i = begin;
+
+    while (i < end)
+    {
+        char c = text[i];
+
+        // Whitespace between declarations belongs to neither
+        if (!started && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+        {
+            started = true;
+            start = i;
+            startLine = line;
+            startColumn = column;
+        }
+
+        if (c == '\n')
+        {
+            i++;
+            line++;
+            column = 0;
+
+            if (inUse && depth == 0)
+                cut(i);
+
+            continue;
+        }
+
+        if (c == '/' && i + 1 < end && text[i + 1] == '/')
+        {
+            while (i < end && text[i] != '\n')
+            {
+                i++;
+                column++;
+            }
+            continue;
+        }
+
+        if (c == '"' || c == '\'')
+        {
+            i++;
+            column++;
+
+            while (i < end && text[i] != c && text[i] != '\n')
+            {
+                if (text[i] == '\\' && i + 1 < end && text[i + 1] != '\n')
+                {
+                    i++;
+                    column++;
+                }
+
+                i++;
+                column++;
+            }
+
+            if (i < end && text[i] == c)
+            {
+                i++;
+                column++;
+            }
+            continue;
+        }
+
+        i++;
+        column++;
+
+        if (c == '!' && depth == 0)
+            inUse = true;
+        else if (c == '{')
+            depth++;
+        else if (c == '}')
+        {
+            if (depth > 0)
+                depth--;
+
+            if (depth == 0)
+                cut(i);
+        }
+        else if (c == ';' && depth == 0)
+            cut(i);
+    }
+
+    complete = !started;
+    cut(end);
+
+    return chunks;
+}
+
+static void setError(Chunk& chunk, const std::string& message)
+{
+    chunk.error = message;
+    chunk.errorLine = 0;
+    chunk.errorColumn = 0;
+
+    // "<kind> at <file>:<line>:<column> -> <message>"
+    size_t arrow = message.find(" -> ");
+    if (arrow == std::string::npos)
+        return;
+
+    size_t columnStart = message.rfind(':', arrow);
+    if (columnStart == std::string::npos || columnStart == 0)
+        return;
+
+    size_t lineStart = message.rfind(':', columnStart - 1);
+    if (lineStart == std::string::npos)
+        return;
+
+    try
+    {
+        chunk.errorLine = std::stoi(message.substr(lineStart + 1, columnStart - lineStart - 1));
+        chunk.errorColumn = std::stoi(message.substr(columnStart + 1, arrow - columnStart - 1));
+
+        // The position is relative to the chunk; the editor shows the real one
+        chunk.error = message.substr(arrow + 4);
+    }
+    catch (const std::exception&)
+    {
+        chunk.errorLine = 0;
+        chunk.errorColumn = 0;
+    }
+}
+
+static std::string signatureOf(const FunctionDecl& fn)
+{
+    std::stringstream out;
+    out << fn.returnType << " " << fn.name << "(";
+
+    for (const auto& param : fn.params)
+        out << param.type << ",";
+
+    out << ")";
+    return out.str();
+}
+
+static void parseChunk(Chunk& chunk, const std::string& path)
+{
+    Lexer lexer(chunk.text);
+    std::vector<Token> tokens = lexer.tokenize();
+
+    try
+    {
+        Parser parser(tokens, path);
+        Program parsed = parser.parse();
+
+        // A chunk holding only a comment declares nothing
+        if (parsed.decls.empty())
+            return;
+
+        chunk.decl = std::move(parsed.decls.front());
+    }
+    catch (const std::exception& e)
+    {
+        setError(chunk, e.what());
+        return;
+    }
+
+    if (auto* fn = std::get_if<FunctionDecl>(&*chunk.decl))
+    {
+        chunk.signature = signatureOf(*fn);
+
+        for (const auto& site : collectCalls(*fn))
+            chunk.callees.push_back(site.callee);
+    }
+}
+
+static FunctionDecl* functionOf(Chunk& chunk)
+{
+    return chunk.decl ? std::get_if<FunctionDecl>(&*chunk.decl) : nullptr;
+}
+
+// Puts `fresh` in place of chunks [first, last). Declarations whose text
+// did not change keep what was parsed and checked before; the others are
+// lexed and parsed now.
+static void replaceChunks(Document& document, size_t first, size_t last, std::vector<Chunk> fresh)
+{
+    auto& chunks = document.chunks;
+    std::unordered_map<std::string, std::vector<size_t>> unchanged;
+
+    for (size_t i = first; i < last; i++)
+        unchanged[chunks[i].text].push_back(i);
+
+    std::vector<bool> reused(chunks.size(), false);
+
+    for (auto& chunk : fresh)
+    {
+        auto it = unchanged.find(chunk.text);
+
+        if (it == unchanged.end() || it->second.empty())
+        {
+            parseChunk(chunk, document.path);
+            continue;
+        }
+
+        size_t old = it->second.back();
+        it->second.pop_back();
+        reused[old] = true;
+
+        size_t offset = chunk.offset;
+        int line = chunk.line;
+        int column = chunk.column;
+
+        chunk = std::move(chunks[old]);
+        chunk.offset = offset;
+        chunk.line = line;
+        chunk.column = column;
+    }
+
+    // A chunk parsed since the last analysis was never declared, so only
+    // analyzed ones count as removed; otherwise an intermediate version
+    // from an earlier change of the same didChange would cancel against
+    // its replacement and hide a rename
+    for (size_t i = first; i < last; i++)
+    {
+        if (!reused[i] && !chunks[i].fresh && functionOf(chunks[i]))
+            document.removed.emplace_back(functionOf(chunks[i])->name, chunks[i].signature);
+    }
+
+    chunks.erase(chunks.begin() + first, chunks.begin() + last);
+    chunks.insert(chunks.begin() + first,
+                  std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+}
+
+// Line and column just past `text` when it starts at (line, column)
+static std::pair<int, int> endOf(const std::string& text, int line, int column)
+{
+    size_t lastNewline = text.rfind('\n');
+
+    if (lastNewline == std::string::npos)
+        return { line, column + static_cast<int>(text.size()) };
+
+    line += static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+    return { line, static_cast<int>(text.size() - lastNewline - 1) };
+}
+
+// Byte offset of an LSP position, clamped to the text. Columns count
+// bytes, which matches UTF-16 for ASCII sources.
+static size_t offsetOf(const std::string& text, const Json& position, int& line, int& column)
+{
+    int64_t wanted = position["line"].asInt();
+    size_t offset = 0;
+    line = 0;
+
+    while (line < wanted)
+    {
+        size_t newline = text.find('\n', offset);
+        if (newline == std::string::npos)
+            break;
+
+        offset = newline + 1;
+        line++;
+    }
+
+    size_t end = text.find('\n', offset);
+    if (end == std::string::npos)
+        end = text.size();
+
+    size_t at = std::min(end, offset + static_cast<size_t>(std::max<int64_t>(0, position["character"].asInt())));
+    column = static_cast<int>(at - offset);
+
+    return at;
+}
+
+// Applies one contentChanges entry. Only the declarations the edit
+// touches are cut again, and the ones after it move by the size of the
+// edit; an unclosed brace pulls in following declarations until the
+// text balances again.
+static void applyChange(Document& document, const Json& change)
+{
+    const Json& range = change["range"];
+    const std::string& replacement = change["text"].asString();
+    auto& chunks = document.chunks;
+    bool complete;
+
+    if (range.isNull())
+    {
+        document.text = replacement;
+        replaceChunks(document, 0, chunks.size(),
+                      splitDeclarations(document.text, 0, document.text.size(), 0, 0, complete));
+        return;
+    }
+
+    int line, column, endLine, endColumn;
+    size_t start = offsetOf(document.text, range["start"], line, column);
+    size_t end = std::max(start, offsetOf(document.text, range["end"], endLine, endColumn));
+
+    // Declarations overlapping or touching [start, end]
+    size_t first = std::partition_point(chunks.begin(), chunks.end(),
+        [&](const Chunk& c) { return c.offset + c.text.size() < start; }) - chunks.begin();
+    size_t last = std::partition_point(chunks.begin(), chunks.end(),
+        [&](const Chunk& c) { return c.offset <= end; }) - chunks.begin();
+
+    last = std::max(first, last);
+
+    size_t regionStart = start;
+    size_t regionEnd = end;
+
+    if (first < last)
+    {
+        if (chunks[first].offset < start)
+        {
+            regionStart = chunks[first].offset;
+            line = chunks[first].line;
+            column = chunks[first].column;
+        }
+
+        regionEnd = std::max(end, chunks[last - 1].offset + chunks[last - 1].text.size());
+    }
+
+    std::string oldRegion = document.text.substr(regionStart, regionEnd - regionStart);
+    document.text.replace(start, end - start, replacement);
+
+    ptrdiff_t delta = static_cast<ptrdiff_t>(replacement.size()) - static_cast<ptrdiff_t>(end - start);
+    size_t newEnd = regionEnd + delta;
+
+    std::vector<Chunk> fresh = splitDeclarations(document.text, regionStart, newEnd, line, column, complete);
+
+    while (!complete && last < chunks.size())
+    {
+        size_t extra = chunks[last].offset + chunks[last].text.size() - regionEnd;
+
+        oldRegion += document.text.substr(newEnd, extra);
+        regionEnd += extra;
+        newEnd += extra;
+        last++;
+
+        fresh = splitDeclarations(document.text, regionStart, newEnd, line, column, complete);
+    }
+
+    // Unterminated at the last declaration: like a full split, the chunk
+    // runs to the end of the text, so its errors sit where a fresh open
+    // puts them and a later edit at the end still touches it
+    if (!complete && newEnd < document.text.size())
+    {
+        oldRegion += document.text.substr(newEnd);
+        regionEnd += document.text.size() - newEnd;
+        newEnd = document.text.size();
+
+        fresh = splitDeclarations(document.text, regionStart, newEnd, line, column, complete);
+    }
+
+    // Everything after the region keeps its text and moves with the edit
+    std::pair<int, int> oldEnd = endOf(oldRegion, line, column);
+    std::pair<int, int> newEndPosition = endOf(document.text.substr(regionStart, newEnd - regionStart), line, column);
+
+    for (size_t i = last; i < chunks.size(); i++)
+    {
+        Chunk& chunk = chunks[i];
+
+        if (chunk.line == oldEnd.first)
+            chunk.column += newEndPosition.second - oldEnd.second;
+
+        chunk.line += newEndPosition.first - oldEnd.first;
+        chunk.offset += delta;
+    }
+
+    replaceChunks(document, first, last, std::move(fresh));
+}
+
+
+// ===== Paths =====
+
+static std::string uriToPath(const std::string& uri)
+{
+    std::string path = uri.rfind("file://", 0) == 0 ? uri.substr(7) : uri;
+    std::string decoded;
+
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        if (path[i] == '%' && i + 2 < path.size())
+        {
+            decoded += static_cast<char>(std::stoi(path.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+            decoded += path[i];
+    }
+
+    // file:///C:/x on Windows
+    if (decoded.size() > 2 && decoded[0] == '/' && decoded[2] == ':')
+        decoded.erase(0, 1);
+
+    return decoded;
+}
+
+// !use paths resolve against the document's directory, then the
+// workspace root; open documents are read from the editor, not the disk
+class WorkspaceFiles : public FileProvider
+{
+public:
+    WorkspaceFiles(const std::unordered_map<std::string, std::unique_ptr<Document>>& documents,
+                   std::string directory, std::string root)
+        : documents(documents), directory(std::move(directory)), root(std::move(root)) {}
+
+    std::optional<std::string> read(const std::string& path) override
+    {
+        for (const std::string& base : { directory, root })
+        {
+            std::filesystem::path full = std::filesystem::path(path).is_absolute()
+                ? std::filesystem::path(path)
+                : std::filesystem::path(base) / path;
+
+            std::string normal = full.lexically_normal().string();
+
+            for (const auto& entry : documents)
+            {
+                if (entry.second->path == normal)
+                    return entry.second->text;
+            }
+
+            if (std::optional<std::string> source = disk.read(normal))
+                return source;
+        }
+
+        return std::nullopt;
+    }
+
+private:
+    const std::unordered_map<std::string, std::unique_ptr<Document>>& documents;
+    std::string directory;
+    std::string root;
+    DiskFileProvider disk;
+};
+
+
+// ===== Server =====
+
+class Server
+{
+public:
+    Server(std::istream& in, std::ostream& out) : in(in), out(out)
+    {
+        root = std::filesystem::current_path().string();
+    }
+
+    int run()
+    {
+        std::string body;
+
+        while (readMessage(body))
+        {
+            Json message;
+
+            try
+            {
+                message = Json::parse(body);
+            }
+            catch (const std::exception& e)
+            {
+                respondError(Json(), -32700, e.what());
+                continue;
+            }
+
+            if (message["method"].asString() == "exit")
+                return shutdownRequested ? 0 : 1;
+
+            try
+            {
+                handle(message);
+            }
+            catch (const std::exception& e)
+            {
+                if (!message["id"].isNull())
+                    respondError(message["id"], -32603, e.what());
+                else
+                    logMessage(e.what());
+            }
+        }
+
+        return 1;
+    }
+
+private:
+    std::istream& in;
+    std::ostream& out;
+    std::string root;
+    bool shutdownRequested = false;
+
+    std::unordered_map<std::string, std::unique_ptr<Document>> documents;   // by URI
+
+    // ===== Transport =====
+
+    bool readMessage(std::string& body)
+    {
+        size_t length = 0;
+        bool haveLength = false;
+        std::string line;
+
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if (line.empty())
+            {
+                if (haveLength)
+                    break;
+                continue;
+            }
+
+            if (line.rfind("Content-Length:", 0) == 0)
+            {
+                length = std::stoul(line.substr(15));
+                haveLength = true;
+            }
+        }
+
+        if (!haveLength)
+            return false;
+
+        body.assign(length, '\0');
+        in.read(&body[0], static_cast<std::streamsize>(length));
+
+        return static_cast<size_t>(in.gcount()) == length;
+    }
+
+    void send(const Json& message)
+    {
+        std::string body = message.dump();
+
+        out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+        out.flush();
+    }
+
+    void respond(const Json& id, Json result)
+    {
+        Json message = Json::object();
+        message.set("jsonrpc", "2.0");
+        message.set("id", id);
+        message.set("result", std::move(result));
+        send(message);
+    }
+
+    void respondError(const Json& id, int code, const std::string& text)
+    {
+        Json error = Json::object();
+        error.set("code", code);
+        error.set("message", text);
+
+        Json message = Json::object();
+        message.set("jsonrpc", "2.0");
+        message.set("id", id);
+        message.set("error", std::move(error));
+        send(message);
+    }
+
+    void notify(const std::string& method, Json params)
+    {
+        Json message = Json::object();
+        message.set("jsonrpc", "2.0");
+        message.set("method", method);
+        message.set("params", std::move(params));
+        send(message);
+    }
+
+    void logMessage(const std::string& text)
+    {
+        Json params = Json::object();
+        params.set("type", 4);
+        params.set("message", text);
+        notify("window/logMessage", std::move(params));
+    }
+
+    // ===== Requests =====
+
+    void handle(const Json& message)
+    {
+        const std::string& method = message["method"].asString();
+        const Json& id = message["id"];
+        const Json& params = message["params"];
+
+        if (method == "initialize")
+        {
+            if (!params["rootUri"].isNull())
+                root = uriToPath(params["rootUri"].asString());
+            else if (!params["rootPath"].isNull())
+                root = params["rootPath"].asString();
+
+            Json sync = Json::object();
+            sync.set("openClose", true);
+            sync.set("change", 2);   // incremental
+
+            Json capabilities = Json::object();
+            capabilities.set("textDocumentSync", std::move(sync));
+
+            Json info = Json::object();
+            info.set("name", "azc");
+
+            Json result = Json::object();
+            result.set("capabilities", std::move(capabilities));
+            result.set("serverInfo", std::move(info));
+
+            respond(id, std::move(result));
+        }
+        else if (method == "shutdown")
+        {
+            shutdownRequested = true;
+            respond(id, Json());
+        }
+        else if (method == "textDocument/didOpen")
+        {
+            const Json& item = params["textDocument"];
+            const std::string& uri = item["uri"].asString();
+
+            auto document = std::make_unique<Document>();
+            document->path = std::filesystem::path(uriToPath(uri)).lexically_normal().string();
+
+            Json whole = Json::object();
+            whole.set("text", item["text"]);
+            applyChange(*document, whole);
+
+            documents[uri] = std::move(document);
+            changed(uri);
+        }
+        else if (method == "textDocument/didChange")
+        {
+            const std::string& uri = params["textDocument"]["uri"].asString();
+
+            auto it = documents.find(uri);
+            if (it == documents.end())
+                return;
+
+            const Json& changes = params["contentChanges"];
+
+            for (size_t i = 0; i < changes.size(); i++)
+                applyChange(*it->second, changes[i]);
+
+            changed(uri);
+        }
+        else if (method == "textDocument/didClose")
+        {
+            const std::string& uri = params["textDocument"]["uri"].asString();
+            documents.erase(uri);
+
+            Json cleared = Json::object();
+            cleared.set("uri", uri);
+            cleared.set("diagnostics", Json::array());
+            notify("textDocument/publishDiagnostics", std::move(cleared));
+        }
+        else if (!id.isNull())
+        {
+            respondError(id, -32601, "Unhandled method: " + method);
+        }
+    }
+
+    // ===== Analysis =====
+
+    void changed(const std::string& uri)
+    {
+        Document& document = *documents[uri];
+
+        // Documents that use this one as a module see its new text
+        for (auto& entry : documents)
+        {
+            if (entry.first == uri)
+                continue;
+
+            for (const auto& use : entry.second->uses)
+            {
+                std::filesystem::path usePath = std::filesystem::path(entry.second->path).parent_path() / use;
+
+                if (usePath.lexically_normal().string() == document.path)
+                {
+                    entry.second->modulesStale = true;
+                    analyze(entry.first, *entry.second);
+                }
+            }
+        }
+
+        analyze(uri, document);
+    }
+
+    void analyze(const std::string& uri, Document& document)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        // Names whose set of signatures changed: what the edits removed
+        // against what they parsed anew
+        std::unordered_map<std::string, std::vector<std::string>> removed;
+        std::unordered_map<std::string, std::vector<std::string>> added;
+        size_t reparsed = 0;
+
+        for (auto& [name, signature] : document.removed)
+            removed[name].push_back(signature);
+
+        document.removed.clear();
+
+        for (auto& chunk : document.chunks)
+        {
+            if (!chunk.fresh)
+                continue;
+
+            reparsed++;
+
+            if (FunctionDecl* fn = functionOf(chunk))
+                added[fn->name].push_back(chunk.signature);
+        }
+
+        std::unordered_set<std::string> changedNames;
+
+        for (auto* side : { &removed, &added })
+        {
+            for (auto& [name, list] : *side)
+            {
+                std::vector<std::string> a = removed[name];
+                std::vector<std::string> b = added[name];
+
+                std::sort(a.begin(), a.end());
+                std::sort(b.begin(), b.end());
+
+                if (a != b)
+                    changedNames.insert(name);
+            }
+        }
+
+        bool reloaded = loadModules(document);
+        bool redeclare = reloaded || !changedNames.empty();
+
+        if (redeclare)
+        {
+            document.analyzer.reset(document.modules);
+
+            for (auto& decl : document.modules.decls)
+            {
+                if (auto* fn = std::get_if<FunctionDecl>(&decl))
+                    document.analyzer.declareFunction(*fn);
+            }
+        }
+
+        size_t checked = 0;
+        size_t functions = 0;
+
+        for (auto& chunk : document.chunks)
+        {
+            FunctionDecl* fn = functionOf(chunk);
+            bool fresh = chunk.fresh;
+            chunk.fresh = false;
+
+            if (!fn)
+                continue;
+
+            functions++;
+
+            if (redeclare)
+                chunk.duplicate = !document.analyzer.declareFunction(*fn);
+
+            // Callers depend only on signatures, so a body edit re-checks
+            // just that body
+            bool dependent = reloaded || changedNames.count(fn->name);
+
+            for (size_t i = 0; i < chunk.callees.size() && !dependent && !changedNames.empty(); i++)
+                dependent = changedNames.count(chunk.callees[i]) > 0;
+
+            if (!fresh && !dependent)
+                continue;
+
+            checked++;
+            setError(chunk, "");
+
+            if (chunk.duplicate)
+            {
+                setError(chunk, "Function redeclared: " + fn->name);
+                continue;
+            }
+
+            try
+            {
+                document.analyzer.checkFunction(*fn);
+            }
+            catch (const std::exception& e)
+            {
+                setError(chunk, e.what());
+            }
+        }
+
+        publish(uri, document);
+
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - startTime).count();
+
+        std::stringstream summary;
+        summary << "Parsed " << reparsed << " of " << document.chunks.size()
+                << " declarations, checked " << checked << " of " << functions
+                << " functions in " << ms << " ms";
+        logMessage(summary.str());
+    }
+
+    // Loads the document's !use modules when they changed. True if it did.
+    bool loadModules(Document& document)
+    {
+        std::vector<std::string> uses;
+
+        for (auto& chunk : document.chunks)
+        {
+            if (chunk.decl && std::holds_alternative<UseDecl>(*chunk.decl))
+                uses.push_back(std::get<UseDecl>(*chunk.decl).path);
+        }
+
+        if (!document.modulesStale && uses == document.uses)
+            return false;
+
+        document.modules.decls.clear();
+        document.uses = uses;
+        document.modulesStale = false;
+
+        std::string directory = std::filesystem::path(document.path).parent_path().string();
+        WorkspaceFiles files(documents, directory, root);
+        ModuleLoader loader(files);
+
+        for (auto& chunk : document.chunks)
+        {
+            if (!chunk.decl || !std::holds_alternative<UseDecl>(*chunk.decl))
+                continue;
+
+            setError(chunk, "");
+
+            try
+            {
+                for (auto& decl : loader.loadModule(std::get<UseDecl>(*chunk.decl).path))
+                    document.modules.decls.push_back(std::move(decl));
+            }
+            catch (const std::exception& e)
+            {
+                setError(chunk, e.what());
+            }
+        }
+
+        return true;
+    }
+
+    void publish(const std::string& uri, const Document& document)
+    {
+        Json diagnostics = Json::array();
+
+        auto position = [](int line, int character)
+        {
+            Json pos = Json::object();
+            pos.set("line", line);
+            pos.set("character", character);
+            return pos;
+        };
+
+        for (const auto& chunk : document.chunks)
+        {
+            if (chunk.error.empty())
+                continue;
+
+            int line = chunk.line;
+            int column = chunk.column;
+
+            // A known position marks one character, anything else the
+            // declaration's whole first line
+            size_t lineEnd = chunk.text.find('\n');
+            int width = static_cast<int>(lineEnd == std::string::npos ? chunk.text.size() : lineEnd);
+
+            if (chunk.errorLine > 0)
+            {
+                line += chunk.errorLine - 1;
+                column = (chunk.errorLine == 1 ? column : 0) + std::max(chunk.errorColumn - 1, 0);
+                width = 1;
+            }
+
+            Json range = Json::object();
+            range.set("start", position(line, column));
+            range.set("end", position(line, column + width));
+
+            Json diagnostic = Json::object();
+            diagnostic.set("range", std::move(range));
+            diagnostic.set("severity", 1);
+            diagnostic.set("source", "azc");
+            diagnostic.set("message", chunk.error);
+            diagnostics.push(std::move(diagnostic));
+        }
+
+        Json params = Json::object();
+        params.set("uri", uri);
+        params.set("diagnostics", std::move(diagnostics));
+        notify("textDocument/publishDiagnostics", std::move(params));
+    }
+};
+
+}
+
+
+int runLanguageServer(std::istream& in, std::ostream& out)
+{
+    Server server(in, out);
+    return server.run();
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+namespace azin
+{
+
+// Language server over stdio: JSON-RPC with Content-Length framing.
+//
+// Open documents stay lexed, parsed and analyzed in memory, one top-level
+// declaration at a time. An edit re-lexes and re-parses only the
+// declarations whose text changed, then re-checks those functions and,
+// when a signature changed, the functions that call it. Modules pulled in
+// with !use are loaded once per document and kept until its !use lines or
+// an open module change.
+//
+// Returns the exit code: 0 after shutdown and exit, 1 otherwise.
+int runLanguageServer(std::istream& in, std::ostream& out);
+
+}
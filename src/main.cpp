@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <limits>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -5,11 +7,10 @@
 #include <string>
 
 #include "lexer.hpp"
-#include "parser.hpp"
 #include "ast.hpp"
-#include "codegen.hpp"
-#include "semantic.hpp"
-#include "module.hpp"
+#include "azin.hpp"
+#include "cache.hpp"
+#include "lsp.hpp"
 
 
 using namespace azin;
@@ -24,6 +25,28 @@ std::string removeExtension(const std::string& filename)
     return p.stem().string();
 }
 
+// "-O2 -g" -> { "-O2", "-g" }
+static std::vector<std::string> splitFlags(const std::string& flags)
+{
+    std::vector<std::string> result;
+    std::stringstream stream(flags);
+    std::string flag;
+
+    while (stream >> flag)
+        result.push_back(flag);
+
+    return result;
+}
+
+// Unsigned decimal: no sign, no suffix. Throws `expected` for anything else
+static uint64_t parseNumber(const std::string& text, const std::string& expected)
+{
+    if (text.empty() || text.size() > 18 || text.find_first_not_of("0123456789") != std::string::npos)
+        throw std::runtime_error(expected + ", got '" + text + "'");
+
+    return std::stoull(text);
+}
+
 // File Reading
 
 static std::string readFile(const std::string& path)
@@ -37,6 +60,50 @@ static std::string readFile(const std::string& path)
     return buffer.str();
 }
 
+// Run Mode
+
+// `azc run [--checked] <file.az>`: runs main in the bytecode interpreter
+// and exits with what it returns. No C, no executable; AZIN_TRACE still
+// applies.
+static int runScript(int argc, char** argv)
+{
+    try
+    {
+        Tracer tracer(std::cerr);
+        if (const char* spec = std::getenv("AZIN_TRACE"))
+            tracer.configure(spec);
+
+        CompileOptions options;
+        options.trace = &tracer;
+        std::string sourcePath;
+
+        for (int i = 2; i < argc; i++)
+        {
+            std::string arg = argv[i];
+
+            if (arg == "--checked")
+                options.checked = true;
+            else if (!arg.empty() && arg[0] == '-')
+                throw std::runtime_error("Unknown option: " + arg);
+            else
+                sourcePath = arg;
+        }
+
+        if (sourcePath.empty())
+            throw std::runtime_error("Usage: azc run [--checked] <file.az>");
+
+        DiskFileProvider files;
+        Compiler compiler(files, options);
+
+        return static_cast<int>(compiler.run(sourcePath));
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
+
 // Token Debug Dump
 
 static const char* tokenTypeToString(TokenType type)
@@ -55,6 +122,7 @@ static const char* tokenTypeToString(TokenType type)
         case TokenType::WHILE: return "WHILE";
         case TokenType::FOR: return "FOR";
         case TokenType::EXTERN: return "EXTERN";
+        case TokenType::EXPORT: return "EXPORT";
 
         case TokenType::TYPE_INT: return "TYPE_INT";
         case TokenType::TYPE_NORE: return "TYPE_NORE";
@@ -326,142 +394,307 @@ static void dumpAST(const Program& program)
 
 int main(int argc, char** argv)
 {
-    std::ofstream debugFile("debug.log", std::ios::out | std::ios::trunc);
-    if (!debugFile)
-        return 1;
+    if (argc == 2 && std::string(argv[1]) == "--lsp")
+        return runLanguageServer(std::cin, std::cout);
 
-    std::streambuf* coutBuf = std::cout.rdbuf();
-    std::streambuf* cerrBuf = std::cerr.rdbuf();
+    if (argc >= 2 && std::string(argv[1]) == "run")
+        return runScript(argc, argv);
 
-    std::cout.rdbuf(debugFile.rdbuf());
-
-    std::cout << "===== AZC DEBUG SESSION START =====\n";
+    // Traces go to stderr, dumps to stdout; both stay off unless asked for
+    Tracer tracer(std::cerr);
 
     try
     {
-        if (argc < 2)
-            throw std::runtime_error("Usage: azc <file.az>");
+        if (const char* spec = std::getenv("AZIN_TRACE"))
+            tracer.configure(spec);
+
+        std::string sourcePath;
+        std::string orderProfilePath;
+        int codegenUnits = 1;
+        bool useCache = true;
+        bool checked = false;
+        bool ir = false;
+        bool dumpIR = false;
+        bool dumpTokensOf = false;
+        bool dumpASTOf = false;
+        bool emitC = false;
+        bool native = false;
+        bool debugInfo = false;
+        bool freestanding = false;
+        int optimize = -1;
+        bool lto = false;
+        bool marchNative = false;
+        bool profileGenerate = false;
+        std::string profileUse;
+        std::string cc = std::getenv("CC") ? std::getenv("CC") : "gcc";
+        std::string cflags = std::getenv("CFLAGS") ? std::getenv("CFLAGS") : "";
+        std::string cacheDir;
+        uint64_t cacheSizeMB = 512;
+
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
 
-        std::string sourcePath = argv[1];
-        std::string baseName = removeExtension(sourcePath);
-        std::string cFileName = baseName + ".c";
+            if (arg == "-j" || arg == "--codegen-units")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error(arg + " expects a positive number");
 
-        #ifdef _WIN32
-                bool windows = true;
-                std::string exeFileName = baseName + ".exe";
-        #else
-                std::string exeFileName = baseName;
-        #endif
+                uint64_t units = parseNumber(argv[++i], arg + " expects a positive number");
 
+                if (units < 1 || units > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+                    throw std::runtime_error(arg + " expects a positive number, got '" + argv[i] + "'");
 
+                codegenUnits = static_cast<int>(units);
+            }
+            else if (arg == "--checked")
+            {
+                checked = true;
+            }
+            else if (arg == "--ir")
+            {
+                ir = true;
+            }
+            else if (arg == "--dump-ir")
+            {
+                ir = true;
+                dumpIR = true;
+            }
+            else if (arg == "--dump-tokens")
+            {
+                dumpTokensOf = true;
+            }
+            else if (arg == "--dump-ast")
+            {
+                dumpASTOf = true;
+            }
+            else if (arg == "--trace")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--trace expects categories, e.g. modules,sema=debug or all");
 
-        // =========================
-        // READ FILE
-        // =========================
+                tracer.configure(argv[++i]);
+            }
+            else if (arg == "--emit-c")
+            {
+                emitC = true;
+            }
+            else if (arg == "--native")
+            {
+                native = true;
+            }
+            else if (arg == "-g")
+            {
+                debugInfo = true;
+            }
+            else if (arg == "--freestanding")
+            {
+                freestanding = true;
+            }
+            else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3")
+            {
+                optimize = arg[2] - '0';
+            }
+            else if (arg == "--lto")
+            {
+                lto = true;
+            }
+            else if (arg == "--march=native")
+            {
+                marchNative = true;
+            }
+            else if (arg == "--pgo-generate")
+            {
+                profileGenerate = true;
+            }
+            else if (arg == "--pgo-use")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--pgo-use expects a profile name or directory");
 
-        std::cout << "Reading file: " << sourcePath << "\n";
+                profileUse = argv[++i];
+            }
+            else if (arg == "--cc")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--cc expects a compiler");
 
-        std::string source = readFile(sourcePath);
+                cc = argv[++i];
+            }
+            else if (arg == "--cflags")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--cflags expects flags");
 
-        std::cout << "File loaded successfully.\n";
-        std::cout << "File size: " << source.size() << " bytes\n";
+                cflags = argv[++i];
+            }
+            else if (arg == "--no-cache")
+            {
+                useCache = false;
+            }
+            else if (arg == "--cache-dir")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--cache-dir expects a directory");
 
-        // =========================
-        // LEXER
-        // =========================
+                cacheDir = argv[++i];
+            }
+            else if (arg == "--cache-size")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--cache-size expects a size in MiB");
 
-        std::cout << "\n--- Starting Lexical Analysis ---\n";
-        Lexer lexer(source);
-        auto tokens = lexer.tokenize();
+                cacheSizeMB = parseNumber(argv[++i], "--cache-size expects a size in MiB");
 
-        std::cout << "Lexical analysis complete.\n";
-        std::cout << "Total tokens: " << tokens.size() << "\n";
+                // Bytes must fit in 64 bits
+                if (cacheSizeMB > (std::numeric_limits<uint64_t>::max() >> 20))
+                    throw std::runtime_error("--cache-size is too large: " + std::string(argv[i]));
+            }
+            else if (arg == "--order-profile")
+            {
+                if (i + 1 >= argc)
+                    throw std::runtime_error("--order-profile expects a file");
 
-        dumpTokens(tokens);
+                orderProfilePath = argv[++i];
+            }
+            else if (!arg.empty() && arg[0] == '-')
+            {
+                throw std::runtime_error("Unknown option: " + arg);
+            }
+            else
+            {
+                sourcePath = arg;
+            }
+        }
 
-        // =========================
-        // PARSER
-        // =========================
+        if (sourcePath.empty())
+            throw std::runtime_error(
+                "Usage: azc <file.az> [-j N | --codegen-units N] [--order-profile <file>]"
+                " [--checked] [--ir] [--native] [--freestanding] [-g] [-O0..-O3] [--lto] [--march=native]"
+                " [--pgo-generate | --pgo-use <profile>] [--emit-c] [--cc <compiler>] [--cflags \"<flags>\"]"
+                " [--no-cache] [--cache-dir <dir>] [--cache-size <MiB>]"
+                " [--dump-tokens] [--dump-ast] [--dump-ir] [--trace <category[=level],...>]\n"
+                "       azc run [--checked] <file.az>\n"
+                "       azc --lsp");
 
-        std::cout << "\n--- Starting Parsing ---\n";
+        std::string baseName = removeExtension(sourcePath);
 
-        ModuleLoader loader;
-        Program program = loader.loadProgramWithModules(sourcePath);
+        if (profileGenerate && !profileUse.empty())
+            throw std::runtime_error("--pgo-generate and --pgo-use cannot be combined");
 
+        if ((profileGenerate || !profileUse.empty()) && native)
+            throw std::runtime_error("Profile-guided builds need the C backend, not --native");
 
-        std::cout << "Parsing completed successfully.\n";
+        if (freestanding && native)
+            throw std::runtime_error("--freestanding needs the C backend, not --native");
 
-        // =========================
-        // AST DUMP
-        // =========================
+        // Profiles live next to the build cache, one directory per program;
+        // --pgo-use also takes a directory of its own
+        std::string profiles = (cacheDir.empty() ? BuildCache::defaultDirectory() : cacheDir) + "/profiles/";
+        std::string profileGenerateDir = profileGenerate ? profiles + baseName : "";
+        std::string profileUseDir = profileUse;
 
-        dumpAST(program);
+        if (!profileUse.empty() && !std::filesystem::is_directory(profileUse))
+            profileUseDir = profiles + profileUse;
 
-        // =========================
-        // SEMANTIC ANALYSIS
-        // =========================
+        // A profile is only worth using when the C compiler optimizes, and
+        // it only matches a build at the level it was collected at
+        if (optimize < 0)
+            optimize = (profileGenerate || !profileUse.empty()) ? 2 : 0;
 
-        std::cout << "\n--- Starting Semantic Analysis ---\n";
+        CallProfile orderProfile;
+        if (!orderProfilePath.empty())
+        {
+            orderProfile = loadCallProfile(orderProfilePath);
+            tracer(TraceCategory::Sema, [&](std::ostream& out) { out << "Using profile: " << orderProfilePath; });
+        }
 
-        SemanticAnalyzer analyzer;
-        analyzer.analyze(program);
+        std::unique_ptr<BuildCache> cache;
+        if (useCache)
+        {
+            cache = std::make_unique<BuildCache>(
+                cacheDir.empty() ? BuildCache::defaultDirectory() : cacheDir,
+                cacheSizeMB * 1024 * 1024, cc);
+        }
 
-        std::cout << "Semantic analysis complete.\n";
+        CompileOptions options;
+        options.codegenUnits = codegenUnits;
+        options.checked = checked;
+        options.ir = ir;
+        options.dumpIR = dumpIR ? &std::cout : nullptr;
+        options.emitC = emitC;
+        options.native = native;
+        options.debugInfo = debugInfo;
+        options.freestanding = freestanding;
+        options.optimize = optimize;
+        options.lto = lto;
+        options.marchNative = marchNative;
+        options.profileGenerate = profileGenerateDir;
+        options.profileUse = profileUseDir;
+        options.cc.command = cc;
+        options.cc.flags = splitFlags(cflags);
+        options.orderProfile = orderProfilePath.empty() ? nullptr : &orderProfile;
+        options.cache = cache.get();
+        options.trace = &tracer;
+
+        DiskFileProvider files;
+        Compiler compiler(files, options);
 
         // =========================
-        // CODEGEN
+        // DUMPS (opt-in)
         // =========================
 
-        std::cout << "\n--- Starting C Code Generation ---\n";
-
-        std::string cCode = CodegenC::generate(program);
+        if (dumpTokensOf)
+        {
+            Lexer lexer(readFile(sourcePath));
+            dumpTokens(lexer.tokenize());
+        }
 
-        std::ofstream cFile(cFileName);
-        cFile << cCode;
-        cFile.close();
+        Program program = compiler.load(sourcePath);
 
-        std::cout << "C source written to " << cFileName << "\n";
+        if (dumpASTOf)
+            dumpAST(program);
 
         // =========================
-        // BUILD
+        // ANALYSIS, CODEGEN + BUILD
         // =========================
 
-        std::string command = "gcc " + cFileName + " -o " + exeFileName;
+        compiler.analyze(program);
 
-        std::cout << "Running: " << command << "\n";
+        std::string exeFileName = compiler.build(program, baseName);
 
-        int result = std::system(command.c_str());
+        // Warnings went straight to the terminal when gcc ran in a shell
+        std::cerr << compiler.compilerOutput();
+
+        if (cache)
+        {
+            cache->evict();
+
+            // Always shown, unlike the traces: whether a build was reused
+            // is part of what the driver reports
+            if (cache->hits() + cache->misses() > 0)
+            {
+                std::cout << "Build cache: " << cache->hits() << " hits, "
+                          << cache->misses() << " misses (" << cache->directory() << ")\n";
+            }
+        }
 
-        if (result != 0)
-            throw std::runtime_error("GCC compilation failed.");
+        tracer(TraceCategory::Build, [&](std::ostream& out) { out << "Compilation successful: " << exeFileName; });
 
-        std::string delCommand = "rm ";
-        std::cout << "Compilation successful: " << exeFileName << "\n";
-        if (windows) {delCommand = "del ";}
-        std::string cleanCommand = delCommand + "*.c";
-        //std::system(cleanCommand.c_str());  
+        if (profileGenerate)
+        {
+            std::cerr << "Instrumented build: run " << exeFileName << " on representative input, then rebuild with"
+                      << " --pgo-use " << baseName << " (profile in " << profileGenerateDir << ")\n";
+        }
     }
     catch (const std::exception& e)
     {
-        // Full debug info to log
-        std::cout << "\n!!! EXCEPTION CAUGHT !!!\n";
-        std::cout << e.what() << "\n";
-
-        // Clean message to user
         std::cerr << e.what() << "\n";
     }
     catch (...)
     {
-        std::cout << "\n!!! UNKNOWN CRITICAL ERROR !!!\n";
         std::cerr << "Unknown critical error\n";
     }
 
-
-    std::cout << "\n===== AZC DEBUG SESSION END =====\n";
-
-    std::cout.rdbuf(coutBuf);
-    std::cerr.rdbuf(cerrBuf);
-    debugFile.close();
-
     return 0;
 }
\ No newline at end of file
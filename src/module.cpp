@@ -5,24 +5,59 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
-#include <iostream>
 #include <unordered_set>
 #include <filesystem>
 
 namespace azin
 {
 
-std::string ModuleLoader::readFile(const std::string& path)
+// ===== File providers =====
+
+std::optional<std::string> DiskFileProvider::read(const std::string& path)
 {
     std::ifstream file(path);
     if (!file)
-        throw std::runtime_error("Cannot open file: " + path);
+        return std::nullopt;
 
     std::stringstream buffer;
     buffer << file.rdbuf();
     return buffer.str();
 }
 
+void MemoryFileProvider::add(const std::string& path, const std::string& source)
+{
+    files[path] = source;
+}
+
+std::optional<std::string> MemoryFileProvider::read(const std::string& path)
+{
+    auto it = files.find(path);
+    if (it == files.end())
+        return std::nullopt;
+
+    return it->second;
+}
+
+
+// ===== ModuleLoader =====
+
+ModuleLoader::ModuleLoader(FileProvider& files, const Tracer* tracer)
+    : files(files), tracer(tracer) {}
+
+std::string ModuleLoader::readFile(const std::string& path)
+{
+    std::optional<std::string> source = files.read(path);
+    if (!source)
+        throw std::runtime_error("Cannot open file: " + path);
+
+    return std::move(*source);
+}
+
+std::string ModuleLoader::mangledName(const std::string& moduleName, const std::string& name)
+{
+    return moduleName + "__" + name;
+}
+
 Program ModuleLoader::loadProgramWithModules(const std::string& entryPath)
 {
     std::vector<TopLevelDecl> mergedDecls;
@@ -36,6 +71,14 @@ Program ModuleLoader::loadProgramWithModules(const std::string& entryPath)
     return program;
 }
 
+std::vector<TopLevelDecl> ModuleLoader::loadModule(const std::string& path)
+{
+    std::vector<TopLevelDecl> decls;
+    loadFileRecursive(path, decls, false);
+
+    return decls;
+}
+
 
 static void mangleCallsInExpr(Expr* expr,
                               const std::string& moduleName,
@@ -129,7 +172,7 @@ static void mangleCallsInExpr(Expr* expr,
         // Only remap unqualified calls to local functions
         if (call->moduleName.empty() && localFunctions.count(call->callee))
         {
-            call->callee = moduleName + "__" + call->callee;
+            call->callee = ModuleLoader::mangledName(moduleName, call->callee);
         }
 
         // Recurse into arguments
@@ -189,16 +232,48 @@ void ModuleLoader::loadFileRecursive(const std::string& path,
 
     loadedModules.insert(path);
 
-    std::cout << "\n--- Loading Module: " << path << " ---\n";
+    if (tracer)
+        (*tracer)(TraceCategory::Modules, [&](std::ostream& out) { out << "Loading " << path; });
 
     std::string source = readFile(path);
 
     Lexer lexer(source);
     auto tokens = lexer.tokenize();
 
+    if (tracer)
+        (*tracer)(TraceCategory::Lexer, [&](std::ostream& out)
+        {
+            out << path << ": " << source.size() << " bytes, " << tokens.size() << " tokens";
+        });
+
     Parser parser(tokens, path);
     Program program = parser.parse();
 
+    if (tracer)
+    {
+        (*tracer)(TraceCategory::Parse, [&](std::ostream& out)
+        {
+            out << path << ": " << program.decls.size() << " declarations";
+        });
+
+        for (const auto& decl : program.decls)
+        {
+            if (!std::holds_alternative<FunctionDecl>(decl))
+                continue;
+
+            const auto& fn = std::get<FunctionDecl>(decl);
+
+            (*tracer)(TraceCategory::Parse, TraceLevel::Debug, [&](std::ostream& out)
+            {
+                // Extern declarations carry no span
+                out << path;
+                if (fn.span.startLine > 0)
+                    out << ":" << fn.span.startLine;
+                out << ": " << (fn.isExtern ? "extern " : "") << fn.name;
+            });
+        }
+    }
+
     // Extract module name from filename (use filesystem to handle paths reliably)
     std::filesystem::path modulePath(path);
     std::string moduleName = modulePath.stem().string();
@@ -236,7 +311,7 @@ void ModuleLoader::loadFileRecursive(const std::string& path,
                 if (fn.body)
                     mangleCallsInBlock(fn.body.get(), moduleName, localFunctions);
 
-                fn.name = moduleName + "__" + fn.name;
+                fn.name = mangledName(moduleName, fn.name);
             }
 
             mergedDecls.push_back(std::move(decl));
@@ -1,19 +1,62 @@
 #pragma once
 
 #include "ast.hpp"
+#include "trace.hpp"
+#include <optional>
+#include <ostream>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 namespace azin
 {
 
+// Where module sources come from. The entry file and every !use path are
+// resolved through it, so callers can compile without touching the disk.
+class FileProvider
+{
+public:
+    virtual ~FileProvider() = default;
+    virtual std::optional<std::string> read(const std::string& path) = 0;
+};
+
+class DiskFileProvider : public FileProvider
+{
+public:
+    std::optional<std::string> read(const std::string& path) override;
+};
+
+class MemoryFileProvider : public FileProvider
+{
+public:
+    void add(const std::string& path, const std::string& source);
+    std::optional<std::string> read(const std::string& path) override;
+
+private:
+    std::unordered_map<std::string, std::string> files;
+};
+
 class ModuleLoader
 {
 public:
+    // Traces each file loaded (modules), its token count (lexer) and its
+    // declarations (parse); nullptr keeps it quiet
+    explicit ModuleLoader(FileProvider& files, const Tracer* tracer = nullptr);
+
     Program loadProgramWithModules(const std::string& entryPath);
 
+    // C name of function `name` from module `moduleName` (the stem of its
+    // file, e.g. std); the entry file's functions keep their own names
+    static std::string mangledName(const std::string& moduleName, const std::string& name);
+
+    // The declarations of one !use target and everything it uses, mangled
+    // as modules; files this loader has already loaded are skipped
+    std::vector<TopLevelDecl> loadModule(const std::string& path);
+
 private:
+    FileProvider& files;
+    const Tracer* tracer;
     std::unordered_set<std::string> loadedModules;
 
     // @deprecated
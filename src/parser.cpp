@@ -220,6 +220,11 @@ FunctionDecl Parser::parseFunction()
     if (match(TokenType::EXTERN))
         return parseExtern();
 
+    bool exported = match(TokenType::EXPORT);
+
+    if (exported && check(TokenType::EXTERN))
+        throw error("An extern function cannot be exported");
+
     Type returnType = parseType();
     currentFunctionReturnType = returnType.base;
 
@@ -262,6 +267,7 @@ FunctionDecl Parser::parseFunction()
         std::move(body)
     };
 
+    fn.isExported = exported;
     fn.span = makeSpan(startToken, endToken, currentFile);
 
     return fn;
@@ -317,6 +323,7 @@ std::unique_ptr<Stmt> Parser::parseStatement()
     }
 
     // Handle generic expression statements and assignments
+    Token startToken = peek();
     auto expr = parseExpression();
 
     if (match(TokenType::EQUAL))
@@ -324,14 +331,20 @@ std::unique_ptr<Stmt> Parser::parseStatement()
         auto value = parseExpression();
         consume(TokenType::SEMICOLON, "Expected ';'");
 
-        return std::make_unique<AssignmentStmt>(
+        auto node = std::make_unique<AssignmentStmt>(
             std::move(expr),
             std::move(value)
         );
+
+        node->span = makeSpan(startToken, previous(), currentFile);
+        return node;
     }
 
     consume(TokenType::SEMICOLON, "Expected ';'");
-    return std::make_unique<ExpressionStmt>(std::move(expr));
+
+    auto node = std::make_unique<ExpressionStmt>(std::move(expr));
+    node->span = makeSpan(startToken, previous(), currentFile);
+    return node;
 
 
     throw error("Unknown statement");
@@ -415,7 +428,10 @@ std::unique_ptr<ReturnStmt> Parser::parseReturn()
     {
         consume(TokenType::SEMICOLON, "Expected ';'");
         Token endToken = previous();
-        return std::make_unique<ReturnStmt>(nullptr);
+
+        auto node = std::make_unique<ReturnStmt>(nullptr);
+        node->span = makeSpan(startToken, endToken, currentFile);
+        return node;
     }
 
     auto value = parseExpression();
@@ -0,0 +1,271 @@
+#include "process.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+    #include <cstdio>
+    #include <filesystem>
+    #include <fstream>
+    #include <random>
+#else
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+
+    extern char** environ;
+#endif
+
+namespace azin
+{
+
+std::string commandLine(const std::vector<std::string>& args)
+{
+    std::string line;
+
+    for (const auto& arg : args)
+    {
+        if (!line.empty())
+            line += " ";
+
+        if (!arg.empty() && arg.find_first_of(" \t\"'\\$") == std::string::npos)
+        {
+            line += arg;
+            continue;
+        }
+
+        line += "\"";
+        for (char c : arg)
+        {
+            if (c == '"' || c == '\\' || c == '$')
+                line += '\\';
+            line += c;
+        }
+        line += "\"";
+    }
+
+    return line;
+}
+
+#ifdef _WIN32
+
+// No posix_spawn here: the input goes through a temporary file and the
+// command through the shell
+ProcessResult runProcess(const std::vector<std::string>& args, const std::string& input)
+{
+    namespace fs = std::filesystem;
+
+    std::random_device random;
+    fs::path inputPath = fs::temp_directory_path() / ("azin-" + std::to_string(random()) + ".in");
+
+    {
+        std::ofstream file(inputPath, std::ios::out | std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Cannot write file: " + inputPath.string());
+
+        file << input;
+    }
+
+    std::string command = "\"" + commandLine(args) + " < \"" + inputPath.string() + "\" 2>&1\"";
+
+    FILE* pipe = _popen(command.c_str(), "r");
+    if (!pipe)
+    {
+        fs::remove(inputPath);
+        throw std::runtime_error("Cannot run " + args[0]);
+    }
+
+    ProcessResult result;
+    char buffer[4096];
+    size_t count;
+
+    while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+        result.output.append(buffer, count);
+
+    result.exitCode = _pclose(pipe);
+
+    std::error_code ec;
+    fs::remove(inputPath, ec);
+
+    return result;
+}
+
+#else
+
+static void makePipe(int fds[2])
+{
+    #ifdef __linux__
+        if (pipe2(fds, O_CLOEXEC) != 0)
+            throw std::runtime_error(std::string("Cannot create pipe: ") + std::strerror(errno));
+    #else
+        if (pipe(fds) != 0)
+            throw std::runtime_error(std::string("Cannot create pipe: ") + std::strerror(errno));
+
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    #endif
+}
+
+// Writes to a pipe whose reader is gone fail with EPIPE instead of
+// killing the process. Only this thread's mask is touched, and a
+// SIGPIPE raised meanwhile is taken off the queue before it is restored.
+class SigpipeBlock
+{
+public:
+    SigpipeBlock()
+    {
+        sigemptyset(&pipeSet);
+        sigaddset(&pipeSet, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSet, &previous);
+    }
+
+    ~SigpipeBlock()
+    {
+        sigset_t pending;
+        sigpending(&pending);
+
+        if (sigismember(&pending, SIGPIPE) && !sigismember(&previous, SIGPIPE))
+        {
+            int taken;
+            sigwait(&pipeSet, &taken);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+private:
+    sigset_t pipeSet;
+    sigset_t previous;
+};
+
+ProcessResult runProcess(const std::vector<std::string>& args, const std::string& input)
+{
+    if (args.empty())
+        throw std::runtime_error("No command to run");
+
+    int in[2];
+    int out[2];
+
+    makePipe(in);
+
+    try
+    {
+        makePipe(out);
+    }
+    catch (...)
+    {
+        close(in[0]);
+        close(in[1]);
+        throw;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 2);
+
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    close(in[0]);
+    close(out[1]);
+
+    if (spawned != 0)
+    {
+        close(in[1]);
+        close(out[0]);
+        throw std::runtime_error("Cannot run " + args[0] + ": " + std::strerror(spawned));
+    }
+
+    // Feed stdin and drain stdout together, so neither side can fill
+    // its pipe and wait on the other forever
+    ProcessResult result;
+    size_t written = 0;
+    int writeFd = in[1];
+
+    fcntl(writeFd, F_SETFL, fcntl(writeFd, F_GETFL) | O_NONBLOCK);
+
+    if (input.empty())
+    {
+        close(writeFd);
+        writeFd = -1;
+    }
+
+    {
+        SigpipeBlock block;
+        char buffer[4096];
+
+        for (;;)
+        {
+            pollfd fds[2];
+            int count = 0;
+
+            fds[count++] = { out[0], POLLIN, 0 };
+            if (writeFd >= 0)
+                fds[count++] = { writeFd, POLLOUT, 0 };
+
+            if (poll(fds, count, -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+
+            if (writeFd >= 0 && fds[1].revents)
+            {
+                ssize_t n = write(writeFd, input.data() + written, input.size() - written);
+
+                if (n > 0)
+                    written += static_cast<size_t>(n);
+
+                // Done, or the child stopped reading (EPIPE)
+                if (written == input.size() || (n < 0 && errno != EAGAIN && errno != EINTR))
+                {
+                    close(writeFd);
+                    writeFd = -1;
+                }
+            }
+
+            if (fds[0].revents)
+            {
+                ssize_t n = read(out[0], buffer, sizeof(buffer));
+
+                if (n > 0)
+                    result.output.append(buffer, static_cast<size_t>(n));
+                else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                    break;
+            }
+        }
+    }
+
+    if (writeFd >= 0)
+        close(writeFd);
+    close(out[0]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+
+    if (WIFEXITED(status))
+        result.exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        result.exitCode = 128 + WTERMSIG(status);
+
+    return result;
+}
+
+#endif
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace azin
+{
+
+struct ProcessResult
+{
+    int exitCode = 0;       // 128 + signal number if it was killed
+    std::string output;     // stdout and stderr, interleaved as written
+};
+
+// Starts args[0] (looked up in PATH) with args as its argv, no shell in
+// between, feeds `input` to its stdin and collects everything it prints
+// until it exits. Throws std::runtime_error if it cannot be started.
+ProcessResult runProcess(const std::vector<std::string>& args, const std::string& input = "");
+
+// args joined for display, quoting the ones a shell would split
+std::string commandLine(const std::vector<std::string>& args);
+
+}
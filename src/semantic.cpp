@@ -1,4 +1,7 @@
 #include "semantic.hpp"
+#include "module.hpp"
+#include "threadpool.hpp"
+#include <iterator>
 #include <stdexcept>
 
 namespace azin {
@@ -6,81 +9,193 @@ namespace azin {
 // ===== SymbolTable =====
 
 void SymbolTable::enterScope() {
-    scopes.emplace_back();
+    scopeMarks.push_back(entries.size());
 }
 
-bool isInteger(const Type& t)
-{
-    return t.base == "char" ||
-           t.base == "int"  ||
-           t.base == "i8"   ||
-           t.base == "i16"  ||
-           t.base == "i32"  ||
-           t.base == "i64"  ||
-           t.base == "u8"   ||
-           t.base == "u16"  ||
-           t.base == "u32"  ||
-           t.base == "u64";
+void SymbolTable::exitScope() {
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+
+    while (entries.size() > mark) {
+        const Entry& entry = entries.back();
+        slots[entry.slot].head = entry.shadowed;
+        entries.pop_back();
+    }
 }
 
-void SymbolTable::exitScope() {
-    scopes.pop_back();
+size_t SymbolTable::findSlot(const std::string& name, size_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+
+    // Linear probing; names are never removed, so there are no tombstones
+    while (slots[i].used && (slots[i].hash != hash || slots[i].name != name))
+        i = (i + 1) & mask;
+
+    return i;
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(old.empty() ? 64 : old.size() * 2, Slot{});
+
+    std::vector<uint32_t> moved(old.size());
+
+    for (size_t i = 0; i < old.size(); i++) {
+        if (!old[i].used)
+            continue;
+
+        size_t j = findSlot(old[i].name, old[i].hash);
+        slots[j] = std::move(old[i]);
+        moved[i] = static_cast<uint32_t>(j);
+    }
+
+    for (auto& entry : entries)
+        entry.slot = moved[entry.slot];
 }
 
 bool SymbolTable::declare(const std::string& name, const Symbol& symbol) {
-    if (scopes.empty())
+    if (scopeMarks.empty())
         enterScope();
 
-    auto& current = scopes.back();
+    if ((usedSlots + 1) * 2 > slots.size())
+        grow();
 
-    if (current.find(name) != current.end())
+    size_t hash = std::hash<std::string>{}(name);
+    size_t i = findSlot(name, hash);
+    Slot& slot = slots[i];
+
+    if (!slot.used) {
+        slot.used = true;
+        slot.name = name;
+        slot.hash = hash;
+        usedSlots++;
+    }
+
+    uint32_t depth = static_cast<uint32_t>(scopeMarks.size());
+
+    if (slot.head >= 0 && entries[slot.head].depth == depth)
         return false;
 
-    current[name] = symbol;
+    entries.push_back(Entry{ symbol, slot.head, depth, static_cast<uint32_t>(i) });
+    slot.head = static_cast<int32_t>(entries.size() - 1);
     return true;
 }
 
 Symbol* SymbolTable::lookup(const std::string& name) {
-    for (int i = scopes.size() - 1; i >= 0; --i) {
-        auto it = scopes[i].find(name);
-        if (it != scopes[i].end())
-            return &it->second;
-    }
-    return nullptr;
+    return const_cast<Symbol*>(static_cast<const SymbolTable*>(this)->lookup(name));
+}
+
+const Symbol* SymbolTable::lookup(const std::string& name) const {
+    if (slots.empty())
+        return nullptr;
+
+    size_t i = findSlot(name, std::hash<std::string>{}(name));
+
+    if (!slots[i].used || slots[i].head < 0)
+        return nullptr;
+
+    return &entries[slots[i].head].symbol;
+}
+
+
+// ===== SemanticAnalyzer =====
+
+// Checking a body resolves every call and type in it, so a few dozen repay the threads
+static constexpr size_t PARALLEL_MIN_FUNCTIONS = 32;
+
+SemanticAnalyzer::SemanticAnalyzer(unsigned threads)
+    : threads(threads)
+{
+}
+
+// ===== Overloads =====
+
+// out@std prints any value: strings as text, integers in decimal and
+// other pointers as hex addresses. Each is its own std function.
+static const std::string OUT_OVERLOADS[] = {
+    ModuleLoader::mangledName("std", "out"),
+    ModuleLoader::mangledName("std", "outInt"),
+    ModuleLoader::mangledName("std", "outPtr"),
+};
+
+std::vector<std::string> SemanticAnalyzer::overloadsOf(const std::string& name)
+{
+    if (name == OUT_OVERLOADS[0])
+        return std::vector<std::string>(std::begin(OUT_OVERLOADS), std::end(OUT_OVERLOADS));
+
+    return { name };
+}
+
+static std::string resolveOverload(const std::string& name, const TypeInfo& arg)
+{
+    if (name != OUT_OVERLOADS[0])
+        return name;
+
+    bool isString = arg.base == BaseKind::Char &&
+        ((arg.pointerDepth == 1 && !arg.isArray) || (arg.pointerDepth == 0 && arg.isArray));
+
+    if (isString)
+        return OUT_OVERLOADS[0];
+
+    if (arg.isPointer || arg.isArray)
+        return OUT_OVERLOADS[2];
+
+    if (arg.hasIntegerBase)
+        return OUT_OVERLOADS[1];
+
+    return name;
+}
+
+const Symbol* SemanticAnalyzer::lookup(const FunctionContext& ctx, const std::string& name) const
+{
+    if (const Symbol* local = ctx.locals.lookup(name))
+        return local;
+
+    return functions.lookup(name);
+}
+
+bool SemanticAnalyzer::areTypesCompatible(TypeId from, TypeId to) const
+{
+    return types->compatible(from, to);
+}
+
+// Records the implicit conversion of an analyzed expression to `to` so
+// codegen can spell it out. Arrays decay on their own, and literals are
+// left to C so it still warns when a constant does not fit.
+void SemanticAnalyzer::convert(Expr* expr, TypeId to)
+{
+    if (expr->type == to || types->info(expr->type).isArray)
+        return;
+
+    if (dynamic_cast<LiteralExpr*>(expr))
+        return;
+
+    expr->convertedType = to;
+}
+
+void SemanticAnalyzer::reset(Program& program)
+{
+    types = &program.types;
+
+    functions = SymbolTable();
+    functions.enterScope();
 }
 
-bool SemanticAnalyzer::areTypesCompatible(const Type& from, const Type& to)
+bool SemanticAnalyzer::declareFunction(const FunctionDecl& fn)
 {
-    // exact match
-    if (from == to) return true;
-
-    // pointer depth + base match (e.g. int* == int*)
-    if (from.pointerDepth == to.pointerDepth &&
-        from.base == to.base &&
-        from.isArray == to.isArray)
-        return true;
-
-    // array -> pointer decay (char[] -> char*)
-    if (from.isArray &&
-        to.pointerDepth > 0 &&
-        from.base == to.base)
-        return true;
-
-    // integer conversions
-    if (from.pointerDepth == 0 && to.pointerDepth == 0 &&
-        isInteger(from) && isInteger(to))
-        return true;
-
-    // pointer → integer (like uintptr_t)
-    if (from.pointerDepth > 0 && isInteger(to))
-        return true;
-
-    return false;
+    Symbol sym;
+    sym.kind = SymbolKind::Function;
+    sym.type = types->intern(fn.returnType);
+
+    for (auto& p : fn.params)
+        sym.paramTypes.push_back(types->intern(p.type));
+
+    return functions.declare(fn.name, sym);
 }
 
 void SemanticAnalyzer::analyze(Program& program)
 {
-    symbols.enterScope();
+    reset(program);
     bool foundMain = false;
 
     // ===== First pass: declare all functions globally =====
@@ -90,27 +205,28 @@ void SemanticAnalyzer::analyze(Program& program)
         {
             auto& fn = std::get<FunctionDecl>(decl);
 
-            Symbol sym;
-            sym.kind = SymbolKind::Function;
-            sym.type = fn.returnType;
-
-            for (auto& p : fn.params)
-                sym.paramTypes.push_back(p.type);
-
-            if (!symbols.declare(fn.name, sym))
+            if (!declareFunction(fn))
                 throw std::runtime_error("Function redeclared: " + fn.name);
         }
     }
 
     // ===== Second pass: analyze function bodies =====
+    std::vector<FunctionDecl*> bodies;
+
     for (auto& decl : program.decls)
     {
         if (std::holds_alternative<FunctionDecl>(decl))
-        {
-            auto& fn = std::get<FunctionDecl>(decl);
-            analyzeFunction(fn);
-        }
+            bodies.push_back(&std::get<FunctionDecl>(decl));
     }
+
+    // parallelFor rethrows the error of the first failing body in
+    // declaration order, as a serial run would
+    unsigned workers = bodies.size() < PARALLEL_MIN_FUNCTIONS ? 1 : threads;
+
+    parallelFor(bodies.size(), workers, [&](size_t i)
+    {
+        analyzeFunction(*bodies[i]);
+    });
     
     for (const auto& decl : program.decls)
     {
@@ -119,7 +235,7 @@ void SemanticAnalyzer::analyze(Program& program)
             const auto& fn = std::get<FunctionDecl>(decl);
             if (fn.name == "main")
             {
-                if (fn.returnType.base != "int")
+                if (types->intern(fn.returnType) != builtinType(BaseKind::Int))
                     throw std::runtime_error("main must return int");
 
                 foundMain = true;
@@ -129,60 +245,56 @@ void SemanticAnalyzer::analyze(Program& program)
 
     if (!foundMain)
         throw std::runtime_error("No main function found");
-
-    symbols.exitScope();
 }
 
 
 void SemanticAnalyzer::analyzeFunction(FunctionDecl& fn)
 {
-    currentFunctionReturnType = fn.returnType;
-    foundReturnInCurrentFunction = false;   
-
     if (fn.isExtern)
     {
         return;
     }
 
-    symbols.enterScope();
+    FunctionContext ctx;
+    ctx.returnType = types->intern(fn.returnType);
+
+    ctx.locals.enterScope();
 
 
     for (auto& param : fn.params)
     {
         Symbol sym;
         sym.kind = SymbolKind::Variable;
-        sym.type = param.type;
+        sym.type = types->intern(param.type);
 
-        if (!symbols.declare(param.name, sym))
+        if (!ctx.locals.declare(param.name, sym))
             throw std::runtime_error("Parameter redeclared: " + param.name);
     }
 
-    analyzeBlock(fn.body.get());
+    analyzeBlock(ctx, fn.body.get());
 
-    if (currentFunctionReturnType.base != "nore" && !foundReturnInCurrentFunction)
+    if (ctx.returnType != builtinType(BaseKind::Nore) && !ctx.foundReturn)
         throw std::runtime_error("Missing return in function: " + fn.name);
-
-    symbols.exitScope();
 }
 
 
-void SemanticAnalyzer::analyzeBlock(BlockStmt* block)
+void SemanticAnalyzer::analyzeBlock(FunctionContext& ctx, BlockStmt* block)
 {
-    symbols.enterScope();
+    ctx.locals.enterScope();
 
     for (auto& stmt : block->statements)
-        analyzeStatement(stmt.get());
+        analyzeStatement(ctx, stmt.get());
 
-    symbols.exitScope();
+    ctx.locals.exitScope();
 }
 
-void SemanticAnalyzer::analyzeStatement(Stmt* stmt)
+void SemanticAnalyzer::analyzeStatement(FunctionContext& ctx, Stmt* stmt)
 {
     if (auto var = dynamic_cast<VarDeclStmt*>(stmt))
     {
         if (var->isArray)
         {
-            if (var->type.base != "char")
+            if (baseKindFromName(var->type.base) != BaseKind::Char)
                 throw std::runtime_error("Only char arrays supported for now");
 
             Type arrayType = var->type;
@@ -190,22 +302,24 @@ void SemanticAnalyzer::analyzeStatement(Stmt* stmt)
 
             Symbol sym;
             sym.kind = SymbolKind::Variable;
-            sym.type = arrayType;
+            sym.type = types->intern(arrayType);
+            sym.isArray = true;
+            sym.arraySize = var->arraySize;
 
-            if (!symbols.declare(var->name, sym))
+            if (!ctx.locals.declare(var->name, sym))
                 throw std::runtime_error("Variable redeclared: " + var->name);
 
             return;
         }
 
 
-        Type initType = analyzeExpression(var->initializer.get());
+        TypeId initType = analyzeExpression(ctx, var->initializer.get());
+        TypeId varType = types->intern(var->type);
 
-        if (!areTypesCompatible(initType, var->type))
+        if (!areTypesCompatible(initType, varType))
         {
             // special-case: int -> char conversion allowed for literals or arithmetic
-            if (initType.pointerDepth == 0 && var->type.pointerDepth == 0 &&
-                initType.base == "int" && var->type.base == "char")
+            if (initType == builtinType(BaseKind::Int) && varType == builtinType(BaseKind::Char))
             {
                 if (dynamic_cast<BinaryExpr*>(var->initializer.get()))
                 {
@@ -229,28 +343,20 @@ void SemanticAnalyzer::analyzeStatement(Stmt* stmt)
         }
 
 
+        convert(var->initializer.get(), varType);
+
         Symbol sym;
         sym.kind = SymbolKind::Variable;
-        sym.type = var->type;
+        sym.type = varType;
 
-        if (!symbols.declare(var->name, sym))
+        if (!ctx.locals.declare(var->name, sym))
             throw std::runtime_error("Variable redeclared: " + var->name);
 
-
-        if (var->isArray)
-        {
-            Type charType;
-            charType.base = "char";
-
-            if (var->type != charType)
-                throw std::runtime_error("Cannot make an array on variable: " + var->name + " because it isn't char");
-        }
-
     }
     else if (auto assign = dynamic_cast<AssignmentStmt*>(stmt))
     {
-        Type targetType = analyzeExpression(assign->target.get());
-        Type valueType  = analyzeExpression(assign->value.get());
+        TypeId targetType = analyzeExpression(ctx, assign->target.get());
+        TypeId valueType  = analyzeExpression(ctx, assign->value.get());
         if (targetType == valueType)
         {
             // OK
@@ -264,15 +370,17 @@ void SemanticAnalyzer::analyzeStatement(Stmt* stmt)
             throw std::runtime_error("Type mismatch in assignment");
         }
 
+        convert(assign->value.get(), targetType);
+
     }
     else if (auto ret = dynamic_cast<ReturnStmt*>(stmt))
     {
-        if (currentFunctionReturnType.base == "nore")
+        if (ctx.returnType == builtinType(BaseKind::Nore))
         {
             if (ret->value)
                 throw std::runtime_error("nore function cannot return a value");
 
-            foundReturnInCurrentFunction = true;
+            ctx.foundReturn = true;
             return;
         }
 
@@ -280,108 +388,99 @@ void SemanticAnalyzer::analyzeStatement(Stmt* stmt)
         if (!ret->value)
             throw std::runtime_error("Non-nore function must return a value");
 
-        Type valueType = analyzeExpression(ret->value.get());
+        TypeId valueType = analyzeExpression(ctx, ret->value.get());
 
-        if (valueType != currentFunctionReturnType)
+        if (valueType != ctx.returnType)
             throw std::runtime_error("Return type mismatch");
 
-        foundReturnInCurrentFunction = true;
+        ctx.foundReturn = true;
     }
     
 
 
     else if (auto ifstmt = dynamic_cast<IfStmt*>(stmt))
     {
-        Type condType = analyzeExpression(ifstmt->condition.get());
-
-        Type boolType;
-        boolType.base = "bool";
+        TypeId condType = analyzeExpression(ctx, ifstmt->condition.get());
 
-        if (condType != boolType)
+        if (condType != builtinType(BaseKind::Bool))
             throw std::runtime_error("Condition must be bool");
 
-        analyzeBlock(ifstmt->thenBranch.get());
+        analyzeBlock(ctx, ifstmt->thenBranch.get());
 
         if (ifstmt->elseBranch)
-            analyzeBlock(ifstmt->elseBranch.get());
+            analyzeBlock(ctx, ifstmt->elseBranch.get());
     }
 
     else if (auto wh = dynamic_cast<WhileStmt*>(stmt))
     {
-        Type condType = analyzeExpression(wh->condition.get());
+        TypeId condType = analyzeExpression(ctx, wh->condition.get());
 
-        Type boolType;
-        boolType.base = "bool";
-
-        if (condType != boolType)
+        if (condType != builtinType(BaseKind::Bool))
             throw std::runtime_error("While condition must be bool");
 
-        analyzeBlock(wh->body.get());
+        analyzeBlock(ctx, wh->body.get());
     }
 
 
     else if (auto exprStmt = dynamic_cast<ExpressionStmt*>(stmt))
     {
-        analyzeExpression(exprStmt->expression.get());
+        analyzeExpression(ctx, exprStmt->expression.get());
     }
 }
 
-Type SemanticAnalyzer::analyzeExpression(Expr* expr)
+TypeId SemanticAnalyzer::analyzeExpression(FunctionContext& ctx, Expr* expr)
+{
+    expr->type = inferExpression(ctx, expr);
+    return expr->type;
+}
+
+TypeId SemanticAnalyzer::inferExpression(FunctionContext& ctx, Expr* expr)
 {
     if (auto addr = dynamic_cast<AddressOfExpr*>(expr))
     {
-        Type inner = analyzeExpression(addr->target.get());
-        inner.pointerDepth += 1;
-        inner.isArray = false;
-        return inner;
+        TypeId inner = analyzeExpression(ctx, addr->target.get());
+        return types->pointerTo(inner);
     }
     if (auto deref = dynamic_cast<DerefExpr*>(expr))
     {
-        Type inner = analyzeExpression(deref->target.get());
+        TypeId inner = analyzeExpression(ctx, deref->target.get());
 
-        if (inner.pointerDepth == 0)
+        if (!types->info(inner).isPointer)
             throw std::runtime_error("Cannot dereference non-pointer");
 
-        inner.pointerDepth -= 1;
-        return inner;
+        const TypeInfo& t = types->info(inner);
+        return types->intern(t.base, t.pointerDepth - 1, t.isArray);
     }
     if (auto lit = dynamic_cast<LiteralExpr*>(expr))
     {
-        Type t;
-
         if (lit->value == "true" || lit->value == "false")
-        {
-            t.base = "bool";
-            return t;
-        }
+            return builtinType(BaseKind::Bool);
 
         // char literal: 'a'
         if (lit->value.size() >= 3 &&
             lit->value.front() == '\'' &&
             lit->value.back() == '\'')
         {
-            t.base = "char";
-            return t;
+            return builtinType(BaseKind::Char);
         }
 
         // default: number → int
-        t.base = "int";
-        return t;
+        return builtinType(BaseKind::Int);
     }
 
     if (auto cast = dynamic_cast<CastExpr*>(expr))
     {
         // Analyze inner expression but do not restrict it
-        analyzeExpression(cast->expr.get());
+        analyzeExpression(ctx, cast->expr.get());
 
         // allow any explicit cast
-        return cast->targetType;
+        return types->intern(cast->targetType);
     }
 
     // ===== VARIABLE =====
     if (auto var = dynamic_cast<VarExpr*>(expr))
     {
-        Symbol* sym = symbols.lookup(var->name);
+        const Symbol* sym = lookup(ctx, var->name);
 
         if (!sym)
             throw std::runtime_error(
@@ -406,10 +505,10 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
 
         if (!call->moduleName.empty())
         {
-            lookupName = call->moduleName + "__" + call->callee;
+            lookupName = ModuleLoader::mangledName(call->moduleName, call->callee);
         }
 
-        Symbol* sym = symbols.lookup(lookupName);
+        const Symbol* sym = lookup(ctx, lookupName);
 
 
         if (!sym)
@@ -422,30 +521,40 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
             throw std::runtime_error("Incorrect argument count in call to: " + call->callee);
 
 
+        std::string resolved = lookupName;
+
         for (size_t i = 0; i < call->arguments.size(); ++i)
         {
-            Type argType = analyzeExpression(call->arguments[i].get());
-
-            Type paramType = sym->paramTypes[i];
+            TypeId argType = analyzeExpression(ctx, call->arguments[i].get());
 
-            if (argType == paramType)
+            // Overloads take one argument and are picked by its type
+            if (call->arguments.size() == 1)
             {
-                // exact match
-            }
-            else if (argType.isArray &&
-                    paramType.pointerDepth > 0 &&
-                    argType.base == paramType.base)
-            {
-                // array decays to pointer
+                std::string overload = resolveOverload(lookupName, types->info(argType));
+
+                if (overload != resolved)
+                {
+                    if (const Symbol* target = functions.lookup(overload))
+                    {
+                        sym = target;
+                        resolved = overload;
+                    }
+                }
             }
-            else if (!areTypesCompatible(argType, paramType))
+
+            TypeId paramType = sym->paramTypes[i];
+
+            // exact matches and array-to-pointer decay are part of compatibility
+            if (!areTypesCompatible(argType, paramType))
             {
                 throw std::runtime_error("Argument type mismatch in call to: " + call->callee);
             }
 
-
+            convert(call->arguments[i].get(), paramType);
         }
 
+        call->resolvedCallee = resolved;
+
         return sym->type;
     }
 
@@ -453,11 +562,11 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
     // ===== UNARY =====
     if (auto unary = dynamic_cast<UnaryExpr*>(expr))
     {
-        Type operandType = analyzeExpression(unary->operand.get());
+        TypeId operandType = analyzeExpression(ctx, unary->operand.get());
 
         if (unary->op == "-")
         {
-            if (!isInteger(operandType))
+            if (!types->info(operandType).hasIntegerBase)
                 throw std::runtime_error("Unary minus only supported on integers");
 
             return operandType;
@@ -470,38 +579,41 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
     // ===== BINARY =====
     if (auto bin = dynamic_cast<BinaryExpr*>(expr))
     {
-        Type leftType  = analyzeExpression(bin->left.get());
-        Type rightType = analyzeExpression(bin->right.get());
+        TypeId leftType  = analyzeExpression(ctx, bin->left.get());
+        TypeId rightType = analyzeExpression(ctx, bin->right.get());
 
         if (!areTypesCompatible(leftType, rightType))
             throw std::runtime_error(
-                "Type mismatch: " + leftType.base + " vs " + rightType.base
+                std::string("Type mismatch: ") +
+                baseKindName(types->info(leftType).base) + " vs " +
+                baseKindName(types->info(rightType).base)
             );
 
+        const TypeInfo& left = types->info(leftType);
+        const TypeInfo& right = types->info(rightType);
+
 
         // Comparison operators → bool
         if (bin->op == "==" || bin->op == "!=" ||
             bin->op == "<"  || bin->op == ">"  ||
             bin->op == "<=" || bin->op == ">=")
         {
-            Type t;
-            t.base = "bool";
-            return t;
+            return builtinType(BaseKind::Bool);
         }
 
-        if (leftType.pointerDepth > 0 &&
-            rightType.base == "int" &&
-            rightType.pointerDepth == 0)
+        if (left.isPointer &&
+            right.base == BaseKind::Int &&
+            !right.isPointer)
         {
             return leftType;
         }
 
-        if (leftType.pointerDepth > 0 &&
-            rightType.pointerDepth > 0 &&
-            leftType.base == rightType.base &&
+        if (left.isPointer &&
+            right.isPointer &&
+            left.base == right.base &&
             bin->op == "-")
         {
-            return Type{"int", 0, false};
+            return builtinType(BaseKind::Int);
         }
         
 
@@ -510,7 +622,7 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
             bin->op == "*" || bin->op == "/" ||
             bin->op == "%")
         {
-            if (!isInteger(leftType))
+            if (!left.hasIntegerBase)
                 throw std::runtime_error("Arithmetic only supported on integers");
 
             return leftType;
@@ -523,31 +635,33 @@ Type SemanticAnalyzer::analyzeExpression(Expr* expr)
     // ===== STRING LITERAL =====
     if (auto str = dynamic_cast<StringExpr*>(expr))
     {
-        Type t;
-        t.base = "char";
-        t.pointerDepth = 1;  // string = char*
-        return t;
+        // string = char*
+        return types->pointerTo(builtinType(BaseKind::Char));
     }
 
     // ===== ARRAY INDEX =====
     if (auto index = dynamic_cast<IndexExpr*>(expr))
     {
-        Type baseType = analyzeExpression(index->base.get());
+        TypeId baseType = analyzeExpression(ctx, index->base.get());
 
-        if (baseType.pointerDepth == 0 && !baseType.isArray)
+        if (!types->info(baseType).isPointer && !types->info(baseType).isArray)
             throw std::runtime_error("Indexing non-array variable");
 
 
-        Type indexType = analyzeExpression(index->index.get());
+        TypeId indexType = analyzeExpression(ctx, index->index.get());
 
-        if (indexType.base != "int")
+        if (types->info(indexType).base != BaseKind::Int)
             throw std::runtime_error("Array index must be int");
 
-        Type elementType = baseType;
-        if (elementType.pointerDepth > 0)
-            elementType.pointerDepth--;  
-        elementType.isArray = false;
-        return elementType;
+        if (auto var = dynamic_cast<VarExpr*>(index->base.get()))
+        {
+            const Symbol* sym = lookup(ctx, var->name);
+
+            if (sym->isArray)
+                index->arraySize = sym->arraySize;
+        }
+
+        return types->pointee(baseType);
 
     }
 
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "ast.hpp"
-#include <unordered_map>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -14,13 +14,22 @@ enum class SymbolKind {
 
 struct Symbol {
     SymbolKind kind;
-    Type type; // return type for function, type for variable
-    std::vector<Type> paramTypes; // only used if function
+    TypeId type = 0; // return type for function, type for variable
+    std::vector<TypeId> paramTypes; // only used if function
     bool isArray = false;
     int arraySize = -1;
 };
 
 
+// Flat scoped symbol table.
+//
+// Every name has one slot in an open-addressed hash table pointing at its
+// innermost declaration; shadowed declarations hang off it as a chain.
+// Declarations are appended to an undo log, and exitScope pops back to
+// the mark taken by enterScope, restoring each shadowed entry. Lookups
+// cost one hash probe at any nesting depth and scopes allocate nothing.
+//
+// Pointers returned by lookup stay valid until the next declare.
 class SymbolTable {
 public:
     void enterScope();
@@ -28,26 +37,72 @@ public:
 
     bool declare(const std::string& name, const Symbol& symbol);
     Symbol* lookup(const std::string& name);
+    const Symbol* lookup(const std::string& name) const;
 
 private:
-    std::vector<std::unordered_map<std::string, Symbol>> scopes;
-    
+    struct Slot {
+        std::string name;
+        size_t hash = 0;
+        int32_t head = -1;     // innermost live entry, -1 if none
+        bool used = false;
+    };
+
+    struct Entry {
+        Symbol symbol;
+        int32_t shadowed;      // entry this one hides, -1 if none
+        uint32_t depth;        // scope depth it was declared in
+        uint32_t slot;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<Entry> entries;         // undo log, innermost scope last
+    std::vector<size_t> scopeMarks;     // entries.size() at each enterScope
+    size_t usedSlots = 0;
+
+    size_t findSlot(const std::string& name, size_t hash) const;
+    void grow();
+};
+
+// State of the one function body being analyzed
+struct FunctionContext {
+    SymbolTable locals;
+    TypeId returnType = 0;
+    bool foundReturn = false;
 };
 
+// Declares every function signature first, then analyzes the bodies.
+// The function table is read-only once declared, so bodies are analyzed
+// concurrently; when several fail, the error of the function declared
+// first is the one thrown, as in a serial run.
 class SemanticAnalyzer {
 public:
+    explicit SemanticAnalyzer(unsigned threads = 0);   // 0 = one per core
+
     void analyze(Program& program);
 
+    // Incremental checking, for the language server: start over with an
+    // empty function table, declare signatures (false if the name is
+    // taken), then check any body again whenever it changes
+    void reset(Program& program);
+    bool declareFunction(const FunctionDecl& fn);
+    void checkFunction(FunctionDecl& fn) { analyzeFunction(fn); }
+
+    // Every function a call to `name` may resolve to, `name` included
+    static std::vector<std::string> overloadsOf(const std::string& name);
+
 private:
-    SymbolTable symbols;
-    Type currentFunctionReturnType;
-    bool foundReturnInCurrentFunction = false;
+    unsigned threads;
+    SymbolTable functions;
+    TypeTable* types = nullptr;
 
     void analyzeFunction(FunctionDecl& fn);
-    void analyzeBlock(BlockStmt* block);
-    void analyzeStatement(Stmt* stmt);
-    Type analyzeExpression(Expr* expr);
-    bool areTypesCompatible(const Type& from, const Type& to);
+    void analyzeBlock(FunctionContext& ctx, BlockStmt* block);
+    void analyzeStatement(FunctionContext& ctx, Stmt* stmt);
+    TypeId analyzeExpression(FunctionContext& ctx, Expr* expr);
+    TypeId inferExpression(FunctionContext& ctx, Expr* expr);
+    void convert(Expr* expr, TypeId to);
+    const Symbol* lookup(const FunctionContext& ctx, const std::string& name) const;
+    bool areTypesCompatible(TypeId from, TypeId to) const;
 };
 
 }
@@ -0,0 +1,368 @@
+#include "specialize.hpp"
+#include "ctfe.hpp"
+#include "module.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace azin
+{
+
+// ===== Helpers =====
+
+static std::string calleeName(const CallExpr* call)
+{
+    if (!call->resolvedCallee.empty())
+        return call->resolvedCallee;
+
+    if (!call->moduleName.empty())
+        return ModuleLoader::mangledName(call->moduleName, call->callee);
+
+    return call->callee;
+}
+
+static bool isVariable(const Expr* expr, const std::string& name)
+{
+    auto var = dynamic_cast<const VarExpr*>(expr);
+    return var && var->name == name;
+}
+
+// Source text for bytes, using only escapes decodeString reads back
+static std::string encodeString(const std::string& bytes)
+{
+    std::string out;
+
+    for (char c : bytes)
+    {
+        switch (c)
+        {
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            case '\r': out += "\\r";  break;
+            case '\\': out += "\\\\"; break;
+            case '"':  out += "\\\""; break;
+            default:   out += c;      break;
+        }
+    }
+
+    return out;
+}
+
+// A copy of a call, with the arguments given
+static std::unique_ptr<CallExpr> copyCall(const CallExpr* call, std::vector<std::unique_ptr<Expr>> args)
+{
+    auto copy = std::make_unique<CallExpr>(call->callee, std::move(args), call->moduleName);
+    copy->resolvedCallee = call->resolvedCallee;
+    copy->type = call->type;
+    copy->convertedType = call->convertedType;
+    copy->range = call->range;
+    return copy;
+}
+
+
+// ===== Specialization =====
+
+// What a call to a function shaped like out turns into:
+// write(fd, msg, strlen(msg)), with the literal for msg
+struct Wrapper
+{
+    const CallExpr* length = nullptr;   // strlen(msg)
+    const CallExpr* write = nullptr;    // write(fd, msg, len)
+    TypeId lengthConversion = INVALID_TYPE;
+};
+
+static bool matchWrapper(const FunctionDecl& fn, Wrapper& out)
+{
+    if (fn.isExtern || !fn.body || fn.params.size() != 1 || fn.body->statements.size() != 2)
+        return false;
+
+    const std::string& msg = fn.params[0].name;
+
+    auto var = dynamic_cast<const VarDeclStmt*>(fn.body->statements[0].get());
+    auto stmt = dynamic_cast<const ExpressionStmt*>(fn.body->statements[1].get());
+
+    if (!var || var->isArray || !stmt)
+        return false;
+
+    auto length = dynamic_cast<const CallExpr*>(var->initializer.get());
+    auto write = dynamic_cast<const CallExpr*>(stmt->expression.get());
+
+    if (!length || !write || length->arguments.size() != 1 || write->arguments.size() != 3)
+        return false;
+
+    if (!isVariable(length->arguments[0].get(), msg))
+        return false;
+
+    // write(<constant>, msg, len), each used as is
+    if (!dynamic_cast<const LiteralExpr*>(write->arguments[0].get()) ||
+        !isVariable(write->arguments[1].get(), msg) ||
+        !isVariable(write->arguments[2].get(), var->name))
+        return false;
+
+    // strlen's result is converted at most once on its way to write
+    TypeId stored = length->convertedType;
+    TypeId passed = write->arguments[2]->convertedType;
+
+    if (stored != INVALID_TYPE && passed != INVALID_TYPE)
+        return false;
+
+    out.length = length;
+    out.write = write;
+    out.lengthConversion = stored != INVALID_TYPE ? stored : passed;
+    return true;
+}
+
+static std::unique_ptr<StringExpr> copyString(const StringExpr* str, TypeId conversion)
+{
+    auto copy = std::make_unique<StringExpr>(str->value);
+    copy->span = str->span;
+    copy->type = str->type;
+    copy->convertedType = conversion;
+    return copy;
+}
+
+static std::unique_ptr<Expr> specialize(const CallExpr* call, const Wrapper& wrapper)
+{
+    auto str = static_cast<const StringExpr*>(call->arguments[0].get());
+
+    const Expr* msgUse = wrapper.length->arguments[0].get();
+
+    std::vector<std::unique_ptr<Expr>> lengthArgs;
+    lengthArgs.push_back(copyString(str, msgUse->convertedType));
+
+    auto length = copyCall(wrapper.length, std::move(lengthArgs));
+    length->span = call->span;
+    length->convertedType = wrapper.lengthConversion;
+
+    auto fd = static_cast<const LiteralExpr*>(wrapper.write->arguments[0].get());
+    auto fdCopy = std::make_unique<LiteralExpr>(fd->value);
+    fdCopy->span = call->span;
+    fdCopy->type = fd->type;
+    fdCopy->convertedType = fd->convertedType;
+    fdCopy->range = fd->range;
+
+    std::vector<std::unique_ptr<Expr>> writeArgs;
+    writeArgs.push_back(std::move(fdCopy));
+    writeArgs.push_back(copyString(str, wrapper.write->arguments[1]->convertedType));
+    writeArgs.push_back(std::move(length));
+
+    auto write = copyCall(wrapper.write, std::move(writeArgs));
+    write->span = call->span;
+    write->convertedType = INVALID_TYPE;
+    return write;
+}
+
+struct SpecializeContext
+{
+    std::unordered_map<std::string, Wrapper> wrappers;
+    SpecializeStats* stats = nullptr;
+};
+
+static void specializeCalls(BlockStmt* block, SpecializeContext& ctx);
+
+static void specializeCalls(Stmt* stmt, SpecializeContext& ctx)
+{
+    if (auto exprStmt = dynamic_cast<ExpressionStmt*>(stmt))
+    {
+        auto call = dynamic_cast<const CallExpr*>(exprStmt->expression.get());
+
+        if (!call || call->arguments.size() != 1)
+            return;
+
+        auto str = dynamic_cast<const StringExpr*>(call->arguments[0].get());
+        if (!str || str->convertedType != INVALID_TYPE)
+            return;
+
+        auto wrapper = ctx.wrappers.find(calleeName(call));
+        if (wrapper == ctx.wrappers.end())
+            return;
+
+        exprStmt->expression = specialize(call, wrapper->second);
+        ctx.stats->callsSpecialized++;
+    }
+    else if (auto ifs = dynamic_cast<IfStmt*>(stmt))
+    {
+        specializeCalls(ifs->thenBranch.get(), ctx);
+        specializeCalls(ifs->elseBranch.get(), ctx);
+    }
+    else if (auto wh = dynamic_cast<WhileStmt*>(stmt))
+        specializeCalls(wh->body.get(), ctx);
+    else if (auto block = dynamic_cast<BlockStmt*>(stmt))
+        specializeCalls(block, ctx);
+}
+
+static void specializeCalls(BlockStmt* block, SpecializeContext& ctx)
+{
+    if (!block) return;
+
+    for (auto& stmt : block->statements)
+        specializeCalls(stmt.get(), ctx);
+}
+
+SpecializeStats specializeLiteralCalls(Program& program)
+{
+    SpecializeStats stats;
+    SpecializeContext ctx;
+    ctx.stats = &stats;
+
+    for (const auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& fn = std::get<FunctionDecl>(decl);
+        Wrapper wrapper;
+
+        if (matchWrapper(fn, wrapper))
+            ctx.wrappers[fn.name] = wrapper;
+    }
+
+    if (ctx.wrappers.empty())
+        return stats;
+
+    for (auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        auto& fn = std::get<FunctionDecl>(decl);
+
+        if (!fn.isExtern)
+            specializeCalls(fn.body.get(), ctx);
+    }
+
+    return stats;
+}
+
+
+// ===== Merging =====
+
+struct LiteralWrite
+{
+    std::string fd;
+    std::string bytes;   // what it writes
+};
+
+static bool matchLiteralWrite(const Stmt* stmt, const std::unordered_set<std::string>& writes,
+                              LiteralWrite& out)
+{
+    auto exprStmt = dynamic_cast<const ExpressionStmt*>(stmt);
+    if (!exprStmt)
+        return false;
+
+    auto call = dynamic_cast<const CallExpr*>(exprStmt->expression.get());
+    if (!call || call->arguments.size() != 3 || !writes.count(calleeName(call)))
+        return false;
+
+    auto fd = dynamic_cast<const LiteralExpr*>(call->arguments[0].get());
+    auto str = dynamic_cast<const StringExpr*>(call->arguments[1].get());
+    auto count = dynamic_cast<const LiteralExpr*>(call->arguments[2].get());
+
+    if (!fd || !str || !count || str->convertedType != INVALID_TYPE)
+        return false;
+
+    if (count->value.empty() || count->value.find_first_not_of("0123456789") != std::string::npos ||
+        count->value.size() > 9)
+        return false;
+
+    std::string bytes;
+    if (!decodeString(str->value, bytes))
+        return false;
+
+    size_t length = std::stoul(count->value);
+    if (length > bytes.size())
+        return false;
+
+    out.fd = fd->value;
+    out.bytes = bytes.substr(0, length);
+    return true;
+}
+
+static void mergeWrites(BlockStmt* block, const std::unordered_set<std::string>& writes,
+                        size_t& merged)
+{
+    if (!block) return;
+
+    auto& statements = block->statements;
+    size_t kept = 0;
+
+    for (size_t i = 0; i < statements.size(); i++)
+    {
+        Stmt* stmt = statements[i].get();
+
+        if (auto ifs = dynamic_cast<IfStmt*>(stmt))
+        {
+            mergeWrites(ifs->thenBranch.get(), writes, merged);
+            mergeWrites(ifs->elseBranch.get(), writes, merged);
+        }
+        else if (auto wh = dynamic_cast<WhileStmt*>(stmt))
+            mergeWrites(wh->body.get(), writes, merged);
+        else if (auto inner = dynamic_cast<BlockStmt*>(stmt))
+            mergeWrites(inner, writes, merged);
+
+        LiteralWrite current;
+        LiteralWrite previous;
+
+        if (kept > 0 &&
+            matchLiteralWrite(stmt, writes, current) &&
+            matchLiteralWrite(statements[kept - 1].get(), writes, previous) &&
+            current.fd == previous.fd)
+        {
+            auto target = static_cast<ExpressionStmt*>(statements[kept - 1].get());
+            auto call = static_cast<CallExpr*>(target->expression.get());
+
+            std::string bytes = previous.bytes + current.bytes;
+
+            static_cast<StringExpr*>(call->arguments[1].get())->value = encodeString(bytes);
+
+            auto count = static_cast<LiteralExpr*>(call->arguments[2].get());
+            count->value = std::to_string(bytes.size());
+            count->range = ValueRange();
+
+            merged++;
+            continue;
+        }
+
+        statements[kept++] = std::move(statements[i]);
+    }
+
+    statements.resize(kept);
+}
+
+size_t mergeLiteralWrites(Program& program)
+{
+    size_t merged = 0;
+
+    // C names of the extern write functions
+    std::unordered_set<std::string> writes;
+
+    for (const auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        const auto& fn = std::get<FunctionDecl>(decl);
+
+        if (fn.isExtern && fn.name == "write" && fn.params.size() == 3)
+            writes.insert(fn.name);
+    }
+
+    if (writes.empty())
+        return 0;
+
+    for (auto& decl : program.decls)
+    {
+        if (!std::holds_alternative<FunctionDecl>(decl))
+            continue;
+
+        auto& fn = std::get<FunctionDecl>(decl);
+
+        if (!fn.isExtern)
+            mergeWrites(fn.body.get(), writes, merged);
+    }
+
+    return merged;
+}
+
+}
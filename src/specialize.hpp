@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstddef>
+
+namespace azin
+{
+
+struct SpecializeStats
+{
+    size_t callsSpecialized = 0;   // calls on a string literal replaced by the callee's body
+    size_t writesMerged = 0;       // write calls folded into the one before them
+};
+
+// Replaces calls on a string literal to functions shaped like std's out,
+//
+//     nore out(char* msg) { int len = strlen(msg); write(1, msg, len); }
+//
+// by the call they make, write(1, "...", strlen("...")), so that
+// evaluatePureCalls can turn the length into a constant. Run it before
+// evaluatePureCalls. Needs the types SemanticAnalyzer stores on the AST.
+SpecializeStats specializeLiteralCalls(Program& program);
+
+// Joins consecutive statements write(fd, "a", N) write(fd, "b", M) in
+// the same block, with N and M constants no longer than their strings,
+// into one write(fd, "ab", N + M). Only extern functions named write are
+// merged. Run it after evaluatePureCalls. Returns the number of calls
+// merged away.
+size_t mergeLiteralWrites(Program& program);
+
+}
@@ -1,13 +1,25 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <random>
 #include <sstream>
 #include <string>
 #include <filesystem>
 
+#include "azin.hpp"
+#include "json.hpp"
 #include "lexer.hpp"
+#include "lsp.hpp"
 #include "parser.hpp"
+#include "process.hpp"
 #include "semantic.hpp"
 
+#if defined(__x86_64__) && defined(__linux__)
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 using namespace azin;
 
 static std::string readFile(const std::filesystem::path& p)
@@ -21,6 +33,98 @@ static std::string readFile(const std::filesystem::path& p)
     return buf.str();
 }
 
+// One JSON-RPC message with its Content-Length header
+static std::string frame(const Json& message)
+{
+    std::string body = message.dump();
+    return "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static Json notification(const std::string& method, Json params)
+{
+    Json message = Json::object();
+    message.set("jsonrpc", "2.0");
+    message.set("method", method);
+    message.set("params", std::move(params));
+    return message;
+}
+
+// A contentChanges entry replacing [start, end) of one line
+static Json lineEdit(int line, int start, int end, const std::string& text)
+{
+    auto position = [line](int character)
+    {
+        Json pos = Json::object();
+        pos.set("line", line);
+        pos.set("character", character);
+        return pos;
+    };
+
+    Json range = Json::object();
+    range.set("start", position(start));
+    range.set("end", position(end));
+
+    Json change = Json::object();
+    change.set("range", std::move(range));
+    change.set("text", text);
+    return change;
+}
+
+// The diagnostics of every publishDiagnostics in the server's output
+static std::vector<Json> publishedDiagnostics(const std::string& output)
+{
+    std::vector<Json> result;
+    size_t at = 0;
+
+    while ((at = output.find("Content-Length:", at)) != std::string::npos)
+    {
+        size_t length = std::stoul(output.substr(at + 15));
+        size_t body = output.find("\r\n\r\n", at) + 4;
+
+        Json message = Json::parse(output.substr(body, length));
+        if (message["method"].asString() == "textDocument/publishDiagnostics")
+            result.push_back(message["params"]["diagnostics"]);
+
+        at = body + length;
+    }
+
+    return result;
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+// Runs a program in the VM with stdout sent to a file, returning what it
+// printed and the exit code a process would have had
+static ProcessResult runInVM(const std::string& path, const std::filesystem::path& outFile,
+                             const CompileOptions& options = {})
+{
+    DiskFileProvider files;
+    Compiler compiler(files, options);
+
+    std::cout.flush();
+    int saved = dup(1);
+    int fd = open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, 1);
+    close(fd);
+
+    ProcessResult result;
+    try {
+        result.exitCode = static_cast<int>(compiler.run(path) & 0xff);
+    }
+    catch (...)
+    {
+        dup2(saved, 1);
+        close(saved);
+        throw;
+    }
+
+    dup2(saved, 1);
+    close(saved);
+
+    result.output = readFile(outFile);
+    return result;
+}
+#endif
+
 int main()
 {
     std::filesystem::path testsDir = std::filesystem::path("tests") / "syntax";
@@ -48,7 +152,7 @@ int main()
             Lexer lexer(src);
             auto tokens = lexer.tokenize();
 
-            Parser parser(tokens);
+            Parser parser(tokens, entry.path().string());
             Program program = parser.parse();
 
             SemanticAnalyzer sem;
@@ -63,6 +167,368 @@ int main()
         }
     }
 
+    // Language server: a rename, then one didChange that renames back and
+    // edits the body. The caller must be checked again after each rename
+    ++total;
+    std::cout << "Running: language server, several changes in one didChange ... ";
+
+    try {
+        const std::string uri = "file:///azin_lsp_test/main.az";
+
+        Json document = Json::object();
+        document.set("uri", uri);
+        document.set("languageId", "azin");
+        document.set("version", 1);
+        document.set("text", "int foo(int x)\n{\n    return x + 1;\n}\n\nint main()\n{\n    return foo(1);\n}\n");
+
+        Json open = Json::object();
+        open.set("textDocument", std::move(document));
+
+        auto edit = [&](int version, Json changes)
+        {
+            Json identifier = Json::object();
+            identifier.set("uri", uri);
+            identifier.set("version", version);
+
+            Json params = Json::object();
+            params.set("textDocument", std::move(identifier));
+            params.set("contentChanges", std::move(changes));
+            return frame(notification("textDocument/didChange", std::move(params)));
+        };
+
+        Json rename = Json::array();
+        rename.push(lineEdit(0, 4, 7, "bar"));
+
+        Json renameBackAndEdit = Json::array();
+        renameBackAndEdit.push(lineEdit(0, 4, 7, "foo"));
+        renameBackAndEdit.push(lineEdit(2, 15, 16, "2"));
+
+        std::stringstream in(frame(notification("textDocument/didOpen", std::move(open)))
+                             + edit(2, std::move(rename))
+                             + edit(3, std::move(renameBackAndEdit)));
+        std::stringstream out;
+        runLanguageServer(in, out);
+
+        std::vector<Json> diagnostics = publishedDiagnostics(out.str());
+
+        if (diagnostics.size() != 3)
+            throw std::runtime_error(std::to_string(diagnostics.size()) + " diagnostics published, expected 3");
+
+        if (diagnostics[0].size() != 0 || diagnostics[1].size() != 1 || diagnostics[2].size() != 0)
+            throw std::runtime_error("diagnostics after each edit: " + std::to_string(diagnostics[0].size()) + ", "
+                                     + std::to_string(diagnostics[1].size()) + ", "
+                                     + std::to_string(diagnostics[2].size()) + "; expected 0, 1, 0");
+
+        std::cout << "OK\n";
+        ++passed;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAIL - " << e.what() << "\n";
+    }
+
+    // Language server: after random edits the diagnostics must be the ones
+    // a fresh open of the same text gets, whatever the edit history was
+    ++total;
+    std::cout << "Running: language server, random edits vs a fresh open ... ";
+
+    try {
+        const std::string uri = "file:///azin_lsp_test/random.az";
+        const std::vector<std::string> pieces = {
+            "{", "}", "\n", ";", " ", "(", ")", "x", "foo", "return x;", "int f(int x)\n",
+            "int g()\n{\n    return 1;\n}\n", "extern int w(int a);\n", "// {\n", "\"s{\"", ""
+        };
+
+        auto opened = [&](const std::string& text)
+        {
+            Json document = Json::object();
+            document.set("uri", uri);
+            document.set("languageId", "azin");
+            document.set("version", 1);
+            document.set("text", text);
+
+            Json params = Json::object();
+            params.set("textDocument", std::move(document));
+            return frame(notification("textDocument/didOpen", std::move(params)));
+        };
+
+        auto position = [](const std::string& text, size_t offset)
+        {
+            size_t newline = offset == 0 ? std::string::npos : text.rfind('\n', offset - 1);
+            size_t lineStart = newline == std::string::npos ? 0 : newline + 1;
+
+            Json pos = Json::object();
+            pos.set("line", static_cast<int>(std::count(text.begin(), text.begin() + offset, '\n')));
+            pos.set("character", static_cast<int>(offset - lineStart));
+            return pos;
+        };
+
+        auto lastDiagnostics = [](const std::string& input)
+        {
+            std::stringstream in(input);
+            std::stringstream out;
+            runLanguageServer(in, out);
+
+            std::vector<Json> diagnostics = publishedDiagnostics(out.str());
+            if (diagnostics.empty())
+                throw std::runtime_error("no diagnostics published");
+
+            return diagnostics.back().dump();
+        };
+
+        std::mt19937 random(2024);
+
+        for (int trial = 0; trial < 500; trial++)
+        {
+            std::string text = trial % 2 ? "int main()\n{\n    return 0;\n}\nint f(int x)\n"
+                                         : "int main()\n{\n    return 0;\n}\n\n";
+            std::string input = opened(text);
+            int edits = 1 + static_cast<int>(random() % 10);
+
+            for (int version = 2; version < 2 + edits; version++)
+            {
+                size_t start = random() % (text.size() + 1);
+                size_t end = std::min(text.size(), start + random() % 8);
+                const std::string& replacement = pieces[random() % pieces.size()];
+
+                Json range = Json::object();
+                range.set("start", position(text, start));
+                range.set("end", position(text, end));
+
+                Json change = Json::object();
+                change.set("range", std::move(range));
+                change.set("text", replacement);
+
+                Json changes = Json::array();
+                changes.push(std::move(change));
+
+                Json identifier = Json::object();
+                identifier.set("uri", uri);
+                identifier.set("version", version);
+
+                Json params = Json::object();
+                params.set("textDocument", std::move(identifier));
+                params.set("contentChanges", std::move(changes));
+                input += frame(notification("textDocument/didChange", std::move(params)));
+
+                text.replace(start, end - start, replacement);
+            }
+
+            std::string edited = lastDiagnostics(input);
+            std::string fresh = lastDiagnostics(opened(text));
+
+            if (edited != fresh)
+                throw std::runtime_error("trial " + std::to_string(trial) + ": " + edited + " after edits, "
+                                         + fresh + " after a fresh open");
+        }
+
+        std::cout << "OK\n";
+        ++passed;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAIL - " << e.what() << "\n";
+    }
+
+#if defined(__x86_64__) && defined(__linux__)
+    // Differential tests: each program is built through the C backend and
+    // the native one and run in the VM, and all three must print and exit
+    // like a reference build in which nothing was folded, evaluated at
+    // compile time, specialized or run through the IR passes
+    std::filesystem::path backendDir = std::filesystem::path("tests") / "backend";
+    std::filesystem::path outDir = std::filesystem::temp_directory_path() / "azin_backend_tests";
+    std::filesystem::create_directories(outDir);
+
+    for (auto &entry : std::filesystem::directory_iterator(backendDir))
+    {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().extension() != ".az") continue;
+
+        ++total;
+        std::cout << "Running: " << entry.path().string() << " (C vs native vs VM) ... ";
+
+        try {
+            std::string base = (outDir / entry.path().stem()).string();
+
+            DiskFileProvider files;
+
+            CompileOptions reference;
+            reference.rewriteAST = false;
+            Compiler referenceCompiler(files, reference);
+            std::string referenceExe = referenceCompiler.compileToExecutable(entry.path().string(), base + "_reference");
+
+            CompileOptions viaC;
+            Compiler cCompiler(files, viaC);
+            std::string cExe = cCompiler.compileToExecutable(entry.path().string(), base + "_c");
+
+            CompileOptions native;
+            native.native = true;
+            Compiler nativeCompiler(files, native);
+            std::string nativeExe = nativeCompiler.compileToExecutable(entry.path().string(), base + "_native");
+
+            ProcessResult expected = runProcess({ referenceExe });
+
+            for (const ProcessResult& actual : { runProcess({ cExe }), runProcess({ nativeExe }),
+                                                 runInVM(entry.path().string(), base + "_vm.out") })
+            {
+                if (actual.output != expected.output)
+                    throw std::runtime_error("output differs:\n" + expected.output + "---\n" + actual.output);
+
+                if (actual.exitCode != expected.exitCode)
+                    throw std::runtime_error("exit code " + std::to_string(actual.exitCode) + ", expected "
+                                             + std::to_string(expected.exitCode));
+            }
+
+            std::cout << "OK\n";
+            ++passed;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "FAIL - " << e.what() << "\n";
+        }
+    }
+
+    // Bounds checks: every program in tests/checked is built with
+    // --checked. A trap_*.az program must stop on its out-of-bounds index
+    // in all three backends; any other must print and exit like its
+    // unchecked build, and an inbounds_*.az one must have every check
+    // proven away
+    std::filesystem::path checkedDir = std::filesystem::path("tests") / "checked";
+
+    for (auto &entry : std::filesystem::directory_iterator(checkedDir))
+    {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().extension() != ".az") continue;
+
+        ++total;
+        std::cout << "Running: " << entry.path().string() << " (--checked) ... ";
+
+        try {
+            std::string path = entry.path().string();
+            std::string stem = entry.path().stem().string();
+            std::string base = (outDir / entry.path().stem()).string();
+
+            DiskFileProvider files;
+
+            CompileOptions checkedC;
+            checkedC.checked = true;
+            Compiler cCompiler(files, checkedC);
+            std::string cExe = cCompiler.compileToExecutable(path, base + "_checked_c");
+
+            CompileOptions checkedNative = checkedC;
+            checkedNative.native = true;
+            Compiler nativeCompiler(files, checkedNative);
+            std::string nativeExe = nativeCompiler.compileToExecutable(path, base + "_checked_native");
+
+            if (stem.rfind("trap_", 0) == 0)
+            {
+                for (const std::string& exe : { cExe, nativeExe })
+                {
+                    ProcessResult result = runProcess({ exe });
+
+                    if (result.exitCode != 128 + SIGILL)
+                        throw std::runtime_error(exe + " exited with " + std::to_string(result.exitCode)
+                                                 + " instead of trapping");
+                }
+
+                bool trapped = false;
+                try {
+                    runInVM(path, base + "_checked_vm.out", checkedC);
+                }
+                catch (const std::exception& e)
+                {
+                    trapped = std::string(e.what()).find("out of bounds") != std::string::npos;
+                }
+
+                if (!trapped)
+                    throw std::runtime_error("the VM did not trap");
+            }
+            else
+            {
+                Compiler uncheckedCompiler(files);
+                ProcessResult expected = runProcess({ uncheckedCompiler.compileToExecutable(path, base + "_unchecked") });
+
+                for (const ProcessResult& actual : { runProcess({ cExe }), runProcess({ nativeExe }),
+                                                     runInVM(path, base + "_checked_vm.out", checkedC) })
+                {
+                    if (actual.output != expected.output)
+                        throw std::runtime_error("output differs:\n" + expected.output + "---\n" + actual.output);
+
+                    if (actual.exitCode != expected.exitCode)
+                        throw std::runtime_error("exit code " + std::to_string(actual.exitCode) + ", expected "
+                                                 + std::to_string(expected.exitCode));
+                }
+            }
+
+            if (stem.rfind("inbounds_", 0) == 0)
+            {
+                const FoldStats& folding = cCompiler.folding();
+
+                if (folding.accessesInBounds != folding.arrayAccesses)
+                    throw std::runtime_error(std::to_string(folding.arrayAccesses - folding.accessesInBounds)
+                                             + " accesses still checked");
+
+                // Only the definition of the check may remain
+                std::string c = Compiler(files, checkedC).compileToC(path);
+                size_t checks = 0;
+                for (size_t at = c.find("azin_index("); at != std::string::npos; at = c.find("azin_index(", at + 1))
+                    checks++;
+
+                if (checks != 1)
+                    throw std::runtime_error("the C calls azin_index " + std::to_string(checks - 1) + " times");
+            }
+
+            std::cout << "OK\n";
+            ++passed;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "FAIL - " << e.what() << "\n";
+        }
+    }
+
+    // A C compiler that cannot be started fails the build with an error
+    // and leaves no objects behind, also when units compile in parallel
+    ++total;
+    std::cout << "Running: build with a missing C compiler (-j 2) ... ";
+
+    try {
+        DiskFileProvider files;
+
+        CompileOptions options;
+        options.codegenUnits = 2;
+        options.cc.command = (outDir / "missing-cc").string();
+        Compiler compiler(files, options);
+
+        std::string error;
+        try {
+            compiler.compileToExecutable((backendDir / "arith.az").string(), (outDir / "missing_cc").string());
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+
+        if (error.find("Cannot run") == std::string::npos)
+            throw std::runtime_error(error.empty() ? "the build succeeded" : "unexpected error: " + error);
+
+        for (auto &file : std::filesystem::directory_iterator(outDir))
+        {
+            if (file.path().extension() == ".o")
+                throw std::runtime_error("left behind " + file.path().string());
+        }
+
+        std::cout << "OK\n";
+        ++passed;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAIL - " << e.what() << "\n";
+    }
+
+    std::filesystem::remove_all(outDir);
+#endif
+
     std::cout << "\nPassed " << passed << " / " << total << " tests.\n";
     return (passed == total) ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace azin
+{
+
+// Runs fn(i) for every i in [0, count) on up to `threads` worker threads.
+// Work is handed out one index at a time, so uneven items still balance.
+//
+// fn may throw. Once an item has thrown no new items start, and when the
+// workers are done the exception of the lowest failing index is rethrown
+// on the calling thread: the one a serial loop would have stopped at.
+template <typename Fn>
+void parallelFor(size_t count, unsigned threads, Fn fn)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic<bool> failed{ false };
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    size_t errorIndex = count;
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]()
+        {
+            // Indices are taken in order and a taken one always runs, so
+            // every index below a failing one has run too
+            while (!failed)
+            {
+                size_t i = next++;
+                if (i >= count)
+                    break;
+
+                try
+                {
+                    fn(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+
+                    if (i < errorIndex)
+                    {
+                        errorIndex = i;
+                        error = std::current_exception();
+                    }
+
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+}
@@ -0,0 +1,106 @@
+#include "trace.hpp"
+
+#include <stdexcept>
+
+namespace azin
+{
+
+static const char* const CATEGORY_NAMES[] = {
+    "lexer", "modules", "parse", "sema", "codegen", "build",
+};
+
+static_assert(sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]) == static_cast<size_t>(TraceCategory::Count),
+              "every trace category needs a name");
+
+const char* traceCategoryName(TraceCategory category)
+{
+    return CATEGORY_NAMES[static_cast<size_t>(category)];
+}
+
+void Tracer::enable(TraceCategory category, TraceLevel level)
+{
+    levels[static_cast<size_t>(category)] = level;
+}
+
+static TraceLevel parseLevel(const std::string& name)
+{
+    if (name == "off")
+        return TraceLevel::Off;
+
+    if (name == "info")
+        return TraceLevel::Info;
+
+    if (name == "debug")
+        return TraceLevel::Debug;
+
+    throw std::runtime_error("Unknown trace level '" + name + "' (expected off, info or debug)");
+}
+
+void Tracer::configure(const std::string& spec)
+{
+    size_t start = 0;
+
+    while (start <= spec.size())
+    {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos)
+            end = spec.size();
+
+        std::string item = spec.substr(start, end - start);
+        start = end + 1;
+
+        if (item.empty())
+            continue;
+
+        TraceLevel level = TraceLevel::Info;
+        size_t equals = item.find('=');
+
+        if (equals != std::string::npos)
+        {
+            level = parseLevel(item.substr(equals + 1));
+            item.resize(equals);
+        }
+
+        if (item == "all")
+        {
+            for (size_t i = 0; i < static_cast<size_t>(TraceCategory::Count); i++)
+                levels[i] = level;
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < static_cast<size_t>(TraceCategory::Count) && item != CATEGORY_NAMES[i])
+            i++;
+
+        if (i == static_cast<size_t>(TraceCategory::Count))
+            throw std::runtime_error("Unknown trace category '" + item
+                                     + "' (expected lexer, modules, parse, sema, codegen, build or all)");
+
+        levels[i] = level;
+    }
+}
+
+void Tracer::write(TraceCategory category, const std::string& message) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Multi-line messages (tool output) keep the prefix on every line
+    size_t start = 0;
+
+    while (start < message.size())
+    {
+        size_t end = message.find('\n', start);
+        if (end == std::string::npos)
+            end = message.size();
+
+        out << "[" << traceCategoryName(category) << "] ";
+        out.write(message.data() + start, static_cast<std::streamsize>(end - start));
+        out << "\n";
+
+        start = end + 1;
+    }
+
+    out.flush();
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace azin
+{
+
+enum class TraceCategory : uint8_t
+{
+    Lexer,
+    Modules,
+    Parse,
+    Sema,       // analysis and the passes on the analyzed AST
+    Codegen,    // C, IR and assembly generation
+    Build,      // C compiler, assembler and linker runs
+    Count
+};
+
+enum class TraceLevel : uint8_t
+{
+    Off,
+    Info,       // one line per stage or file
+    Debug       // one line per item: declaration, tool output
+};
+
+const char* traceCategoryName(TraceCategory category);
+
+// Compiler progress messages, switched on per category and level.
+//
+// A Tracer belongs to whoever configures it and is handed to a compilation
+// through CompileOptions, so there is no process-wide switch. Messages
+// are callbacks that only run when their category is enabled: a disabled
+// message costs one comparison and formats nothing. Each message becomes
+// one "[category] ..." line, written whole even from several threads.
+class Tracer
+{
+public:
+    explicit Tracer(std::ostream& out) : out(out) {}
+
+    void enable(TraceCategory category, TraceLevel level);
+
+    // Comma-separated `category[=level]`: category is lexer, modules,
+    // parse, sema, codegen, build or all, level is info (the default),
+    // debug or off. Throws std::runtime_error on anything else.
+    void configure(const std::string& spec);
+
+    bool enabled(TraceCategory category, TraceLevel level = TraceLevel::Info) const
+    {
+        return level != TraceLevel::Off && levels[static_cast<size_t>(category)] >= level;
+    }
+
+    // fn(std::ostream&) writes the message
+    template <typename Fn>
+    void operator()(TraceCategory category, TraceLevel level, Fn fn) const
+    {
+        if (!enabled(category, level))
+            return;
+
+        std::ostringstream message;
+        fn(message);
+        write(category, message.str());
+    }
+
+    template <typename Fn>
+    void operator()(TraceCategory category, Fn fn) const
+    {
+        (*this)(category, TraceLevel::Info, fn);
+    }
+
+private:
+    std::ostream& out;
+    TraceLevel levels[static_cast<size_t>(TraceCategory::Count)] = {};
+    mutable std::mutex mutex;
+
+    void write(TraceCategory category, const std::string& message) const;
+};
+
+}
@@ -0,0 +1,203 @@
+#include "types.hpp"
+#include <mutex>
+#include <stdexcept>
+
+namespace azin
+{
+
+// ===== Builtin bases =====
+
+struct BaseKindDesc
+{
+    const char* name;
+    const char* cName;
+    bool isInteger;
+    int bits;
+    bool isSigned;
+};
+
+static const BaseKindDesc BASE_KINDS[] = {
+    { "nore", "void",     false,  0, false },
+    { "bool", "bool",     false,  8, false },
+    { "char", "char",     true,   8, true  },
+    { "int",  "int",      true,  32, true  },
+    { "i8",   "int8_t",   true,   8, true  },
+    { "i16",  "int16_t",  true,  16, true  },
+    { "i32",  "int32_t",  true,  32, true  },
+    { "i64",  "int64_t",  true,  64, true  },
+    { "u8",   "uint8_t",  true,   8, false },
+    { "u16",  "uint16_t", true,  16, false },
+    { "u32",  "uint32_t", true,  32, false },
+    { "u64",  "uint64_t", true,  64, false },
+};
+
+static_assert(sizeof(BASE_KINDS) / sizeof(BASE_KINDS[0]) == static_cast<size_t>(BaseKind::Count),
+              "BASE_KINDS must list every BaseKind");
+
+BaseKind baseKindFromName(const std::string& name)
+{
+    static const std::unordered_map<std::string, BaseKind> kinds = [] {
+        std::unordered_map<std::string, BaseKind> m;
+        for (size_t i = 0; i < static_cast<size_t>(BaseKind::Count); i++)
+            m[BASE_KINDS[i].name] = static_cast<BaseKind>(i);
+        return m;
+    }();
+
+    auto it = kinds.find(name);
+    if (it == kinds.end())
+        throw std::runtime_error("Unknown type: " + name);
+
+    return it->second;
+}
+
+const char* baseKindName(BaseKind kind)
+{
+    return BASE_KINDS[static_cast<size_t>(kind)].name;
+}
+
+const char* baseKindCName(BaseKind kind)
+{
+    return BASE_KINDS[static_cast<size_t>(kind)].cName;
+}
+
+
+// ===== TypeTable =====
+
+static uint64_t typeKey(BaseKind base, int pointerDepth, bool isArray)
+{
+    return (static_cast<uint64_t>(pointerDepth) << 16) |
+           (static_cast<uint64_t>(isArray) << 8) |
+           static_cast<uint64_t>(base);
+}
+
+TypeTable::TypeTable()
+    : chunks(std::make_unique<std::unique_ptr<TypeInfo[]>[]>(MAX_CHUNKS)),
+      lock(std::make_unique<std::shared_mutex>())
+{
+    for (size_t i = 0; i < static_cast<size_t>(BaseKind::Count); i++)
+        intern(static_cast<BaseKind>(i));
+}
+
+size_t TypeTable::size() const
+{
+    std::shared_lock<std::shared_mutex> guard(*lock);
+    return count;
+}
+
+TypeId TypeTable::intern(const Type& type)
+{
+    return intern(baseKindFromName(type.base), type.pointerDepth, type.isArray);
+}
+
+TypeId TypeTable::intern(BaseKind base, int pointerDepth, bool isArray)
+{
+    uint64_t key = typeKey(base, pointerDepth, isArray);
+
+    {
+        std::shared_lock<std::shared_mutex> guard(*lock);
+
+        auto it = ids.find(key);
+        if (it != ids.end())
+            return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> guard(*lock);
+
+    // Another thread may have interned it while we waited
+    auto it = ids.find(key);
+    if (it != ids.end())
+        return it->second;
+
+    if (count == CHUNK_SIZE * MAX_CHUNKS)
+        throw std::runtime_error("Too many distinct types");
+
+    const BaseKindDesc& desc = BASE_KINDS[static_cast<size_t>(base)];
+
+    TypeId id = static_cast<TypeId>(count);
+
+    if (!chunks[id / CHUNK_SIZE])
+        chunks[id / CHUNK_SIZE] = std::make_unique<TypeInfo[]>(CHUNK_SIZE);
+
+    TypeInfo& info = chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+    info.base = base;
+    info.pointerDepth = pointerDepth;
+    info.isArray = isArray;
+    info.hasIntegerBase = desc.isInteger;
+    info.isPointer = pointerDepth > 0;
+    info.bits = desc.bits;
+    info.isSigned = desc.isSigned;
+
+    info.name = desc.name;
+    info.cName = desc.cName;
+
+    for (int i = 0; i < pointerDepth; i++)
+    {
+        info.name += "*";
+        info.cName += "*";
+    }
+
+    if (isArray)
+        info.name += "[]";
+
+    info.convertsTo.resize(id + 1);
+    info.convertsFrom.resize(id + 1);
+
+    for (TypeId other = 0; other < id; other++)
+    {
+        info.convertsTo[other] = computeCompatible(info, this->info(other));
+        info.convertsFrom[other] = computeCompatible(this->info(other), info);
+    }
+
+    info.convertsTo[id] = info.convertsFrom[id] = computeCompatible(info, info);
+
+    count++;
+    ids[key] = id;
+
+    return id;
+}
+
+TypeId TypeTable::pointerTo(TypeId id)
+{
+    const TypeInfo& t = info(id);
+    return intern(t.base, t.pointerDepth + 1, false);
+}
+
+TypeId TypeTable::pointee(TypeId id)
+{
+    const TypeInfo& t = info(id);
+    return intern(t.base, t.pointerDepth > 0 ? t.pointerDepth - 1 : 0, false);
+}
+
+TypeId TypeTable::withoutArray(TypeId id)
+{
+    const TypeInfo& t = info(id);
+    return intern(t.base, t.pointerDepth, false);
+}
+
+bool TypeTable::computeCompatible(const TypeInfo& from, const TypeInfo& to)
+{
+    // exact match
+    if (from.base == to.base &&
+        from.pointerDepth == to.pointerDepth &&
+        from.isArray == to.isArray)
+        return true;
+
+    // array -> pointer decay (char[] -> char*)
+    if (from.isArray &&
+        to.pointerDepth > 0 &&
+        from.base == to.base)
+        return true;
+
+    // integer conversions
+    if (from.pointerDepth == 0 && to.pointerDepth == 0 &&
+        from.hasIntegerBase && to.hasIntegerBase)
+        return true;
+
+    // pointer -> integer (like uintptr_t)
+    if (from.pointerDepth > 0 && to.hasIntegerBase)
+        return true;
+
+    return false;
+}
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace azin
+{
+    // Type as spelled in the source ("int", "char*", "char[]")
+    struct Type
+    {
+        std::string base;   // "int", "char", etc
+        int pointerDepth = 0;
+        bool isArray = false;
+
+        bool operator==(const Type& other) const
+        {
+            return base == other.base &&
+                pointerDepth == other.pointerDepth &&
+                isArray == other.isArray;
+        }
+
+        bool operator!=(const Type& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const Type& t)
+    {
+        os << t.base;
+
+    for (int i = 0; i < t.pointerDepth; i++)
+        os << "*";
+
+        if (t.isArray)
+            os << "[]";
+
+        return os;
+    }
+
+    // ===== Interned types =====
+
+    enum class BaseKind : uint8_t
+    {
+        Nore, Bool, Char, Int,
+        I8, I16, I32, I64,
+        U8, U16, U32, U64,
+        Count
+    };
+
+    // Small integer handle for a distinct type. Two TypeIds from the same
+    // table are equal exactly when the types are.
+    using TypeId = uint32_t;
+
+    // Not yet resolved by semantic analysis
+    constexpr TypeId INVALID_TYPE = UINT32_MAX;
+
+    // The unadorned builtins are interned first, so their ids are fixed
+    constexpr TypeId builtinType(BaseKind kind)
+    {
+        return static_cast<TypeId>(kind);
+    }
+
+    struct TypeInfo
+    {
+        BaseKind base;
+        int pointerDepth = 0;
+        bool isArray = false;
+
+        bool hasIntegerBase = false;  // char, int, iN, uN at any pointer depth
+        bool isPointer = false;       // pointerDepth > 0
+        int bits = 0;                 // width of the base type
+        bool isSigned = false;
+
+        std::string name;             // "char*", for diagnostics
+        std::string cName;            // "char*", for codegen
+
+        // Implicit conversions against every type interned before this one
+        // (and itself), filled in once at intern time and never changed
+        std::vector<bool> convertsTo;     // this -> other
+        std::vector<bool> convertsFrom;   // other -> this
+    };
+
+    // Inclusive range of values an integer or bool expression can take.
+    // Filled in by the constant folder; unknown for everything else and
+    // for ranges that do not fit in int64_t.
+    struct ValueRange
+    {
+        bool known = false;
+        int64_t min = 0;
+        int64_t max = 0;
+
+        bool isConstant() const { return known && min == max; }
+    };
+
+    // Interns types for one compilation.
+    //
+    // Safe to use from several threads: interning takes a lock, and a
+    // TypeInfo never moves or changes once its id has been handed out, so
+    // info() and compatible() read without locking.
+    class TypeTable
+    {
+    public:
+        TypeTable();
+
+        TypeId intern(const Type& type);
+        TypeId intern(BaseKind base, int pointerDepth = 0, bool isArray = false);
+
+        const TypeInfo& info(TypeId id) const
+        {
+            return chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+        }
+
+        TypeId pointerTo(TypeId id);
+        TypeId pointee(TypeId id);     // one level less; arrays decay to their element
+        TypeId withoutArray(TypeId id);
+
+        // Implicit conversion from -> to, precomputed when types are interned
+        bool compatible(TypeId from, TypeId to) const
+        {
+            return from >= to ? info(from).convertsTo[to] : info(to).convertsFrom[from];
+        }
+
+        size_t size() const;
+
+    private:
+        static constexpr size_t CHUNK_SIZE = 64;
+        static constexpr size_t MAX_CHUNKS = 1024;
+
+        // Fixed directory of fixed-size chunks, so ids never relocate
+        std::unique_ptr<std::unique_ptr<TypeInfo[]>[]> chunks;
+        size_t count = 0;
+
+        std::unordered_map<uint64_t, TypeId> ids;
+        std::unique_ptr<std::shared_mutex> lock;
+
+        static bool computeCompatible(const TypeInfo& from, const TypeInfo& to);
+    };
+
+    // "int" -> BaseKind::Int; throws on unknown names
+    BaseKind baseKindFromName(const std::string& name);
+    const char* baseKindName(BaseKind kind);
+    const char* baseKindCName(BaseKind kind);
+}
@@ -0,0 +1,355 @@
+#include "vm.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+    #include <io.h>
+    #define AZIN_WRITE _write
+    #define AZIN_READ _read
+#else
+    #include <unistd.h>
+    #define AZIN_WRITE ::write
+    #define AZIN_READ ::read
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define AZIN_COMPUTED_GOTO 1
+#else
+    #define AZIN_COMPUTED_GOTO 0
+#endif
+
+namespace azin
+{
+
+// ===== Native Bindings =====
+
+struct NativeBinding
+{
+    const char* name;
+    size_t arity;
+    int64_t (*call)(const int64_t* args);
+};
+
+static int64_t nativeWrite(const int64_t* args)
+{
+    return AZIN_WRITE(static_cast<int>(args[0]), reinterpret_cast<const void*>(args[1]),
+                      static_cast<unsigned>(args[2]));
+}
+
+static int64_t nativeRead(const int64_t* args)
+{
+    return AZIN_READ(static_cast<int>(args[0]), reinterpret_cast<void*>(args[1]),
+                     static_cast<unsigned>(args[2]));
+}
+
+static int64_t nativePutchar(const int64_t* args)
+{
+    char c = static_cast<char>(args[0]);
+    return AZIN_WRITE(1, &c, 1) == 1 ? static_cast<unsigned char>(c) : -1;
+}
+
+static int64_t nativeGetchar(const int64_t*)
+{
+    unsigned char c;
+    return AZIN_READ(0, &c, 1) == 1 ? c : -1;
+}
+
+static int64_t nativeRand(const int64_t*)
+{
+    return std::rand();
+}
+
+static int64_t nativeSrand(const int64_t* args)
+{
+    std::srand(static_cast<unsigned>(args[0]));
+    return 0;
+}
+
+static int64_t nativeExit(const int64_t* args)
+{
+    std::exit(static_cast<int>(args[0]));
+}
+
+static const NativeBinding NATIVES[] = {
+    { "write",   3, nativeWrite },
+    { "read",    3, nativeRead },
+    { "putchar", 1, nativePutchar },
+    { "getchar", 0, nativeGetchar },
+    { "rand",    0, nativeRand },
+    { "srand",   1, nativeSrand },
+    { "exit",    1, nativeExit },
+};
+
+static const NativeBinding& bindNative(const std::string& name)
+{
+    for (const auto& native : NATIVES)
+    {
+        if (name == native.name)
+            return native;
+    }
+
+    throw std::runtime_error("No native binding for extern function '" + name + "'");
+}
+
+
+// ===== Memory =====
+
+template <typename T>
+static int64_t loadAs(int64_t address)
+{
+    T value;
+    std::memcpy(&value, reinterpret_cast<const void*>(address), sizeof(T));
+    return static_cast<int64_t>(value);
+}
+
+template <typename T>
+static void storeAs(int64_t address, int64_t value)
+{
+    T narrow = static_cast<T>(value);
+    std::memcpy(reinterpret_cast<void*>(address), &narrow, sizeof(T));
+}
+
+
+// ===== Interpreter =====
+
+namespace
+{
+
+struct Frame
+{
+    const BytecodeFunction* fn;
+    const Instruction* pc;      // the call to return to
+    int64_t* registers;
+    uint8_t* memory;
+};
+
+[[noreturn]] void fail(const BytecodeFunction* fn, const std::string& what)
+{
+    throw std::runtime_error("Runtime error in " + fn->name + ": " + what);
+}
+
+}
+
+int64_t runBytecode(const BytecodeModule& module, const VMOptions& options)
+{
+    std::vector<const NativeBinding*> natives;
+
+    for (const auto& name : module.natives)
+        natives.push_back(&bindNative(name));
+
+    std::unique_ptr<int64_t[]> registerStack(new int64_t[options.registers]);
+    std::unique_ptr<uint8_t[]> memoryStack(new uint8_t[options.stackBytes]);
+
+    int64_t* const registersEnd = registerStack.get() + options.registers;
+    uint8_t* const memoryEnd = memoryStack.get() + options.stackBytes;
+
+    std::vector<Frame> frames;
+
+    const BytecodeFunction* fn = &module.functions[module.entry];
+    int64_t* r = registerStack.get();
+    uint8_t* memory = memoryStack.get();
+
+    if (fn->initial.size() > options.registers || fn->frameBytes > options.stackBytes)
+        fail(fn, "stack overflow");
+
+    std::copy(fn->initial.begin(), fn->initial.end(), r);
+
+    const Instruction* pc = fn->code.data();
+
+#if AZIN_COMPUTED_GOTO
+    static void* const LABELS[] = {
+    #define AZIN_OPCODE_LABEL(name) &&op_##name,
+        AZIN_OPCODES(AZIN_OPCODE_LABEL)
+    #undef AZIN_OPCODE_LABEL
+    };
+
+    #define CASE(name) op_##name:
+    #define DISPATCH() goto *LABELS[static_cast<int>(pc->op)]
+
+    DISPATCH();
+#else
+    #define CASE(name) case Opcode::name:
+    #define DISPATCH() continue
+
+    for (;;)
+    switch (pc->op)
+    {
+#endif
+
+    #define NEXT() do { pc++; DISPATCH(); } while (0)
+    #define JUMP_IF(condition) do { pc = (condition) ? fn->code.data() + pc->imm : pc + 1; DISPATCH(); } while (0)
+
+    #define U(x) static_cast<uint64_t>(x)
+    #define S(x) static_cast<int64_t>(x)
+
+    CASE(Move)    r[pc->a] = r[pc->b]; NEXT();
+    CASE(Alloca)  r[pc->a] = reinterpret_cast<int64_t>(memory + pc->imm); NEXT();
+
+    // Unsigned arithmetic wraps where signed would overflow
+    CASE(Add)     r[pc->a] = S(U(r[pc->b]) + U(r[pc->c])); NEXT();
+    CASE(Sub)     r[pc->a] = S(U(r[pc->b]) - U(r[pc->c])); NEXT();
+    CASE(Mul)     r[pc->a] = S(U(r[pc->b]) * U(r[pc->c])); NEXT();
+    CASE(And)     r[pc->a] = r[pc->b] & r[pc->c]; NEXT();
+    CASE(Shl)     r[pc->a] = S(U(r[pc->b]) << (r[pc->c] & 63)); NEXT();
+    CASE(Sar)     r[pc->a] = r[pc->b] >> (r[pc->c] & 63); NEXT();
+    CASE(Shr)     r[pc->a] = S(U(r[pc->b]) >> (r[pc->c] & 63)); NEXT();
+
+    CASE(Add32)   r[pc->a] = static_cast<int32_t>(static_cast<uint32_t>(r[pc->b]) + static_cast<uint32_t>(r[pc->c])); NEXT();
+    CASE(Sub32)   r[pc->a] = static_cast<int32_t>(static_cast<uint32_t>(r[pc->b]) - static_cast<uint32_t>(r[pc->c])); NEXT();
+    CASE(Mul32)   r[pc->a] = static_cast<int32_t>(static_cast<uint32_t>(r[pc->b]) * static_cast<uint32_t>(r[pc->c])); NEXT();
+
+    CASE(Neg)     r[pc->a] = S(U(0) - U(r[pc->b])); NEXT();
+
+    CASE(DivS)
+        if (r[pc->c] == 0) fail(fn, "division by zero");
+        r[pc->a] = r[pc->c] == -1 ? S(U(0) - U(r[pc->b])) : r[pc->b] / r[pc->c];
+        NEXT();
+    CASE(RemS)
+        if (r[pc->c] == 0) fail(fn, "division by zero");
+        r[pc->a] = r[pc->c] == -1 ? 0 : r[pc->b] % r[pc->c];
+        NEXT();
+    CASE(DivU)
+        if (r[pc->c] == 0) fail(fn, "division by zero");
+        r[pc->a] = S(U(r[pc->b]) / U(r[pc->c]));
+        NEXT();
+    CASE(RemU)
+        if (r[pc->c] == 0) fail(fn, "division by zero");
+        r[pc->a] = S(U(r[pc->b]) % U(r[pc->c]));
+        NEXT();
+
+    CASE(Sext8)   r[pc->a] = static_cast<int8_t>(r[pc->b]); NEXT();
+    CASE(Zext8)   r[pc->a] = static_cast<uint8_t>(r[pc->b]); NEXT();
+    CASE(Sext16)  r[pc->a] = static_cast<int16_t>(r[pc->b]); NEXT();
+    CASE(Zext16)  r[pc->a] = static_cast<uint16_t>(r[pc->b]); NEXT();
+    CASE(Sext32)  r[pc->a] = static_cast<int32_t>(r[pc->b]); NEXT();
+    CASE(Zext32)  r[pc->a] = static_cast<uint32_t>(r[pc->b]); NEXT();
+    CASE(ToBool)  r[pc->a] = r[pc->b] != 0; NEXT();
+
+    CASE(Eq)      r[pc->a] = r[pc->b] == r[pc->c]; NEXT();
+    CASE(Ne)      r[pc->a] = r[pc->b] != r[pc->c]; NEXT();
+    CASE(LtS)     r[pc->a] = r[pc->b] < r[pc->c]; NEXT();
+    CASE(LeS)     r[pc->a] = r[pc->b] <= r[pc->c]; NEXT();
+    CASE(GtS)     r[pc->a] = r[pc->b] > r[pc->c]; NEXT();
+    CASE(GeS)     r[pc->a] = r[pc->b] >= r[pc->c]; NEXT();
+    CASE(LtU)     r[pc->a] = U(r[pc->b]) < U(r[pc->c]); NEXT();
+    CASE(LeU)     r[pc->a] = U(r[pc->b]) <= U(r[pc->c]); NEXT();
+    CASE(GtU)     r[pc->a] = U(r[pc->b]) > U(r[pc->c]); NEXT();
+    CASE(GeU)     r[pc->a] = U(r[pc->b]) >= U(r[pc->c]); NEXT();
+
+    CASE(Load8S)  r[pc->a] = loadAs<int8_t>(r[pc->b]); NEXT();
+    CASE(Load8U)  r[pc->a] = loadAs<uint8_t>(r[pc->b]); NEXT();
+    CASE(Load16S) r[pc->a] = loadAs<int16_t>(r[pc->b]); NEXT();
+    CASE(Load16U) r[pc->a] = loadAs<uint16_t>(r[pc->b]); NEXT();
+    CASE(Load32S) r[pc->a] = loadAs<int32_t>(r[pc->b]); NEXT();
+    CASE(Load32U) r[pc->a] = loadAs<uint32_t>(r[pc->b]); NEXT();
+    CASE(Load64)  r[pc->a] = loadAs<int64_t>(r[pc->b]); NEXT();
+
+    CASE(Store8)  storeAs<uint8_t>(r[pc->a], r[pc->b]); NEXT();
+    CASE(Store16) storeAs<uint16_t>(r[pc->a], r[pc->b]); NEXT();
+    CASE(Store32) storeAs<uint32_t>(r[pc->a], r[pc->b]); NEXT();
+    CASE(Store64) storeAs<uint64_t>(r[pc->a], r[pc->b]); NEXT();
+
+    CASE(PtrAdd)  r[pc->a] = S(U(r[pc->b]) + U(r[pc->c]) * U(pc->imm)); NEXT();
+    CASE(PtrDiff) r[pc->a] = S(U(r[pc->b]) - U(r[pc->c])) / pc->imm; NEXT();
+
+    CASE(CheckIndex)
+        if (U(r[pc->b]) >= U(pc->imm))
+            fail(fn, "index " + std::to_string(r[pc->b]) + " out of bounds [0, "
+                     + std::to_string(pc->imm) + ")");
+        r[pc->a] = r[pc->b];
+        NEXT();
+
+    CASE(Call)
+    {
+        const BytecodeFunction* callee = &module.functions[static_cast<size_t>(pc->imm)];
+        int64_t* next = r + fn->initial.size();
+        uint8_t* nextMemory = memory + fn->frameBytes;
+
+        if (registersEnd - next < static_cast<std::ptrdiff_t>(callee->initial.size()) ||
+            memoryEnd - nextMemory < static_cast<std::ptrdiff_t>(callee->frameBytes))
+            fail(callee, "stack overflow");
+
+        std::copy(callee->initial.begin(), callee->initial.end(), next);
+
+        const uint32_t* args = fn->args.data() + pc->b;
+        for (uint32_t i = 0; i < pc->c; i++)
+            next[callee->params[i]] = r[args[i]];
+
+        frames.push_back({ fn, pc, r, memory });
+
+        fn = callee;
+        r = next;
+        memory = nextMemory;
+        pc = fn->code.data();
+        DISPATCH();
+    }
+
+    CASE(CallNative)
+    {
+        const NativeBinding* native = natives[static_cast<size_t>(pc->imm)];
+        int64_t args[8] = {};
+
+        if (pc->c != native->arity)
+            fail(fn, std::string("wrong number of arguments to ") + native->name);
+
+        const uint32_t* argRegisters = fn->args.data() + pc->b;
+        for (uint32_t i = 0; i < pc->c; i++)
+            args[i] = r[argRegisters[i]];
+
+        r[pc->a] = native->call(args);
+        NEXT();
+    }
+
+    CASE(Jump)      pc = fn->code.data() + pc->imm; DISPATCH();
+    CASE(JumpIf)    JUMP_IF(r[pc->b] != 0);
+    CASE(JumpIfNot) JUMP_IF(r[pc->b] == 0);
+    CASE(JumpEq)    JUMP_IF(r[pc->b] == r[pc->c]);
+    CASE(JumpNe)    JUMP_IF(r[pc->b] != r[pc->c]);
+    CASE(JumpLtS)   JUMP_IF(r[pc->b] < r[pc->c]);
+    CASE(JumpLeS)   JUMP_IF(r[pc->b] <= r[pc->c]);
+    CASE(JumpGtS)   JUMP_IF(r[pc->b] > r[pc->c]);
+    CASE(JumpGeS)   JUMP_IF(r[pc->b] >= r[pc->c]);
+    CASE(JumpLtU)   JUMP_IF(U(r[pc->b]) < U(r[pc->c]));
+    CASE(JumpLeU)   JUMP_IF(U(r[pc->b]) <= U(r[pc->c]));
+    CASE(JumpGtU)   JUMP_IF(U(r[pc->b]) > U(r[pc->c]));
+    CASE(JumpGeU)   JUMP_IF(U(r[pc->b]) >= U(r[pc->c]));
+
+    CASE(Return)
+    CASE(ReturnVoid)
+    {
+        int64_t value = pc->op == Opcode::Return ? r[pc->a] : 0;
+
+        if (frames.empty())
+            return value;
+
+        const Frame& caller = frames.back();
+        fn = caller.fn;
+        pc = caller.pc;
+        r = caller.registers;
+        memory = caller.memory;
+        frames.pop_back();
+
+        r[pc->a] = value;
+        NEXT();
+    }
+
+#if !AZIN_COMPUTED_GOTO
+    default:
+        fail(fn, "bad opcode");
+    }
+#endif
+
+    #undef CASE
+    #undef DISPATCH
+    #undef NEXT
+    #undef JUMP_IF
+    #undef U
+    #undef S
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace azin
+{
+
+struct VMOptions
+{
+    size_t registers = size_t(1) << 20;     // 64-bit registers for all live frames
+    size_t stackBytes = size_t(8) << 20;    // memory for the allocas of all live frames
+};
+
+// Runs main and returns what it returns.
+//
+// Dispatch is a computed goto per instruction where the compiler
+// supports it, a switch elsewhere. Extern functions are bound by name to
+// native implementations (write, read, putchar, getchar, rand, srand,
+// exit); a module calling any other extern is rejected before it starts.
+// Traps, division by zero and stack overflow throw std::runtime_error
+// naming the function they happened in.
+int64_t runBytecode(const BytecodeModule& module, const VMOptions& options = {});
+
+}